@@ -0,0 +1,107 @@
+
+/******************************************************************************
+ * Qiti — C++ Profiling Library
+ *
+ * @file     bench_qiti_FunctionRegistry.cpp
+ *
+ * @author   Adam Shield
+ * @date     2026-10-16
+ *
+ * @copyright (c) 2025 Adam Shield
+ * SPDX-License-Identifier: MIT
+ *
+ * See LICENSE.txt for license terms.
+ ******************************************************************************/
+
+// Measures the cost of the address -> function lookup performed by the
+// instrumentation hooks on every function entry/exit, with 100k registered functions.
+//
+// Build with -DQITI_BUILD_BENCHMARKS=ON (ideally with CMAKE_BUILD_TYPE=Release)
+// and run ./qiti_bench_FunctionRegistry
+
+// Qiti Private API - not included in qiti_include.hpp
+#include "qiti_FunctionRegistry.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+//--------------------------------------------------------------------------
+
+static constexpr uint32_t numFunctions = 100'000;
+static constexpr uint32_t numLookups   = 10'000'000;
+
+/** Prevents the compiler from optimizing the lookups away */
+static volatile uintptr_t g_sink = 0;
+
+/**
+ Times numLookups lookups of the given addresses (cycling through them).
+
+ Kept free of any template/inline calls, as this file is itself compiled with
+ -finstrument-functions and any instrumented call would pollute the measurement.
+ */
+QITI_API_INTERNAL static double timeLookups_ns(const void* const* addresses, uint32_t numAddresses) noexcept
+{
+    uintptr_t sink = 0;
+
+    const auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0, j = 0; i < numLookups; ++i)
+    {
+        sink += reinterpret_cast<uintptr_t>(qiti::FunctionRegistry::find(addresses[j]));
+        if (++j == numAddresses)
+            j = 0;
+    }
+    const auto end = std::chrono::steady_clock::now();
+
+    g_sink = sink;
+
+    const auto elapsed_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+    return static_cast<double>(elapsed_ns) / numLookups;
+}
+
+/** Fake, function-like addresses (16-byte aligned, densely packed like a .text section). */
+QITI_API_INTERNAL static std::vector<const void*> makeAddresses(uintptr_t base, uint32_t count) noexcept
+{
+    std::vector<const void*> addresses;
+    addresses.reserve(count);
+    for (uint32_t i = 0; i < count; ++i)
+        addresses.push_back(reinterpret_cast<const void*>(base + uintptr_t{i} * 16));
+    return addresses;
+}
+
+int main()
+{
+    auto registered = makeAddresses(0x10000000, numFunctions);
+    auto unregistered = makeAddresses(0x20000000, numFunctions);
+
+    const auto insertStart = std::chrono::steady_clock::now();
+    for (const auto* address : registered)
+        (void)qiti::FunctionRegistry::findOrInsert(address);
+    const auto insertEnd = std::chrono::steady_clock::now();
+
+    std::mt19937 rng(42);
+    std::shuffle(registered.begin(), registered.end(), rng);
+    std::shuffle(unregistered.begin(), unregistered.end(), rng);
+
+    // Same address over and over (hot loop calling one function)
+    const double sameAddress_ns = timeLookups_ns(registered.data(), 1);
+    // Random registered addresses (worst case for caches)
+    const double hit_ns = timeLookups_ns(registered.data(), numFunctions);
+    // Random unregistered addresses (functions not being profiled)
+    const double miss_ns = timeLookups_ns(unregistered.data(), numFunctions);
+
+    const auto insert_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(insertEnd - insertStart).count();
+
+    std::printf("FunctionRegistry with %u registered functions\n", qiti::FunctionRegistry::size());
+    std::printf("  insert (incl. growth):  %8.2f ns/function\n", static_cast<double>(insert_ns) / numFunctions);
+    std::printf("  lookup, same address:   %8.2f ns\n", sameAddress_ns);
+    std::printf("  lookup, random hit:     %8.2f ns\n", hit_ns);
+    std::printf("  lookup, random miss:    %8.2f ns\n", miss_ns);
+
+    qiti::FunctionRegistry::clear();
+
+    return 0;
+}
@@ -0,0 +1,101 @@
+/******************************************************************************
+ * Qiti — C++ Profiling Library
+ *
+ * @file     bench_qiti_InstrumentHooks.cpp
+ *
+ * @author   Adam Shield
+ * @date     2026-10-16
+ *
+ * @copyright (c) 2025 Adam Shield
+ * SPDX-License-Identifier: MIT
+ *
+ * See LICENSE.txt for license terms.
+ ******************************************************************************/
+
+// Measures what every call of an instrumented function pays for the instrumentation
+// hooks (entry + exit), compared to the same function without instrumentation:
+// - idle: no ScopedQitiTest, nothing profiled
+// - other function profiled: the hooks are active, but skip this function
+// - profiled: the function itself is profiled
+//
+// Build with -DQITI_BUILD_BENCHMARKS=ON (ideally with CMAKE_BUILD_TYPE=Release)
+// and run ./qiti_bench_InstrumentHooks
+
+// Qiti Public API
+#include "qiti_include.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+
+//--------------------------------------------------------------------------
+
+static constexpr uint32_t numCalls = 20'000'000;
+
+using FunctionPointer = void (*)() noexcept;
+
+/** Instrumented, does nothing itself */
+__attribute__((noinline))
+void instrumentedFunction() noexcept
+{
+    asm volatile("");
+}
+
+/** Instrumented, only profiled to activate the hooks */
+__attribute__((noinline))
+void otherFunction() noexcept
+{
+    asm volatile("");
+}
+
+/** Same as instrumentedFunction(), without instrumentation (baseline) */
+QITI_API_INTERNAL __attribute__((noinline)) static void uninstrumentedFunction() noexcept
+{
+    asm volatile("");
+}
+
+/**
+ Times numCalls calls through a function pointer (so they are never inlined).
+ Not instrumented itself, so only the calls of function are measured.
+ */
+QITI_API_INTERNAL static double timeCalls_ns(FunctionPointer function) noexcept
+{
+    const auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < numCalls; ++i)
+        function();
+    const auto end = std::chrono::steady_clock::now();
+
+    const auto elapsed_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+    return static_cast<double>(elapsed_ns) / numCalls;
+}
+
+QITI_API_INTERNAL static void printOverhead(const char* label, double call_ns, double baseline_ns) noexcept
+{
+    std::printf("  %-26s %8.2f ns/call (+%.2f ns)\n", label, call_ns, call_ns - baseline_ns);
+}
+
+int main()
+{
+    const double baseline_ns = timeCalls_ns(&uninstrumentedFunction);
+    const double idle_ns = timeCalls_ns(&instrumentedFunction);
+
+    double otherProfiled_ns = 0.0;
+    double profiled_ns = 0.0;
+    {
+        qiti::ScopedQitiTest test;
+
+        (void)qiti::FunctionData::getFunctionData<&otherFunction>();
+        otherProfiled_ns = timeCalls_ns(&instrumentedFunction);
+
+        (void)qiti::FunctionData::getFunctionData<&instrumentedFunction>();
+        profiled_ns = timeCalls_ns(&instrumentedFunction);
+    }
+
+    std::printf("Instrumented call of an empty function (%u calls)\n", numCalls);
+    std::printf("  %-26s %8.2f ns/call\n", "not instrumented:", baseline_ns);
+    printOverhead("idle:", idle_ns, baseline_ns);
+    printOverhead("other function profiled:", otherProfiled_ns, baseline_ns);
+    printOverhead("profiled:", profiled_ns, baseline_ns);
+
+    return 0;
+}
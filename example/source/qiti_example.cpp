@@ -70,6 +70,11 @@ double slowWork() noexcept
     }
     return result;
 }
+
+double callsSlowWork() noexcept
+{
+    return slowWork() + 1.0;
+}
 } // namespace FunctionCallData
 
 //--------------------------------------------------------------------------
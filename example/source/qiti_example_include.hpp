@@ -31,6 +31,7 @@ int testHeapAllocation() noexcept;
 int testNoHeapAllocation() noexcept;
 double fastWork() noexcept;
 double slowWork() noexcept;
+double callsSlowWork() noexcept;
 } // namespace FunctionCallData
 
 //--------------------------------------------------------------------------
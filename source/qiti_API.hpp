@@ -22,8 +22,8 @@
  Marks functions to be excluded from instrumentation.
  
  When applied, this attribute tells the compiler (e.g., GCC or Clang)
- not to insert profiling or instrumentation hooks into the annotated
- functions. It is important that we do not instrument our own
+ not to insert profiling or instrumentation hooks (or XRay sleds) into
+ the annotated functions. It is important that we do not instrument our own
  instrumentation code.
  
  Usage:
@@ -34,7 +34,11 @@
  Not intended for use in client code.
  */
 #ifndef QITI_API_INTERNAL
-  #define QITI_API_INTERNAL __attribute__((no_instrument_function))
+  #if defined(__clang__)
+    #define QITI_API_INTERNAL __attribute__((no_instrument_function, xray_never_instrument))
+  #else
+    #define QITI_API_INTERNAL __attribute__((no_instrument_function))
+  #endif
 #endif
 
 /**
@@ -51,7 +55,11 @@
  Not intended for use in client code.
  */
 #ifndef QITI_API_INLINE
-  #define QITI_API_INLINE __attribute__((no_instrument_function))
+  #if defined(__clang__)
+    #define QITI_API_INLINE __attribute__((no_instrument_function, xray_never_instrument))
+  #else
+    #define QITI_API_INLINE __attribute__((no_instrument_function))
+  #endif
 #endif
 
 /**
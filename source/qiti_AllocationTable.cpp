@@ -0,0 +1,349 @@
+
+/******************************************************************************
+ * Qiti — C++ Profiling Library
+ *
+ * @file     qiti_AllocationTable.cpp
+ *
+ * @author   Adam Shield
+ * @date     2026-10-16
+ *
+ * @copyright (c) 2025 Adam Shield
+ * SPDX-License-Identifier: MIT
+ *
+ * See LICENSE.txt for license terms.
+ ******************************************************************************/
+
+#include "qiti_AllocationTable.hpp"
+
+#include "qiti_MallocHooks.hpp"
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <thread>
+
+//--------------------------------------------------------------------------
+
+namespace
+{
+struct Slot
+{
+    uintptr_t address = 0; // 0 = empty
+    uint64_t size = 0;
+    qiti::AllocationTable::ThreadCounters* owner = nullptr;
+};
+
+struct alignas(64) Stripe
+{
+    std::atomic<bool> isLocked{false};
+    Slot* slots = nullptr; // allocated on first insert
+    size_t capacity = 0;   // power of 2
+    size_t numUsed = 0;
+};
+
+constexpr size_t numStripes = 64;
+constexpr size_t initialCapacityPerStripe = 1024;
+static_assert(std::has_single_bit(numStripes) && std::has_single_bit(initialCapacityPerStripe));
+
+/** Trivially destructible, so frees during static destruction can still use it. */
+constinit std::array<Stripe, numStripes> g_stripes{};
+
+/** Set by the first insert, frees never need to look for an allocation before. */
+constinit std::atomic<bool> g_hasInserted{false};
+
+/** All threads' counters, only ever pushed to (the counters of exited threads are reused instead). */
+constinit std::atomic<qiti::AllocationTable::ThreadCounters*> g_allThreadCounters{nullptr};
+
+/** Counters of exited threads, until a new thread reuses them. Guarded by g_threadCountersLock. */
+constinit qiti::AllocationTable::ThreadCounters* g_exitedThreadCounters = nullptr;
+
+/**
+ What reused counters had counted, and the allocations threads make while they exit.
+ Shared by several threads, so always updated with atomic read-modify-writes.
+ */
+constinit qiti::AllocationTable::ThreadCounters g_retiredCounters{};
+
+/** Guards g_exitedThreadCounters and g_retiredCounters against reading them while counters are reused. */
+constinit std::atomic<bool> g_threadCountersLock{false};
+
+constinit thread_local qiti::AllocationTable::ThreadCounters* g_threadCounters = nullptr;
+constinit thread_local bool g_hasThreadExited = false;
+
+/** Mixes all bits of the address (malloc aligns them, so the low bits alone are useless). */
+[[nodiscard]] constexpr uint64_t hashAddress(uintptr_t address) noexcept
+{
+    // MurmurHash3 fmix64
+    auto hash = static_cast<uint64_t>(address);
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdull;
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53ull;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+[[nodiscard]] constexpr size_t getStripeIndex(uint64_t hash) noexcept
+{
+    return static_cast<size_t>(hash) & (numStripes - 1);
+}
+
+/** Index of the first slot to probe, the stripe index uses the low bits of the hash. */
+[[nodiscard]] constexpr size_t getHomeSlot(uint64_t hash, size_t capacity) noexcept
+{
+    return static_cast<size_t>(hash >> std::countr_zero(numStripes)) & (capacity - 1);
+}
+
+/** Critical sections are a few loads and stores, so spinning beats a mutex (which LockHooks may intercept). */
+struct ScopedSpinLock final
+{
+    explicit ScopedSpinLock(std::atomic<bool>& isLockedToUse) noexcept
+    : isLocked(isLockedToUse)
+    {
+        while (isLocked.exchange(true, std::memory_order_acquire))
+            while (isLocked.load(std::memory_order_relaxed))
+                std::this_thread::yield();
+    }
+
+    ~ScopedSpinLock() noexcept { isLocked.store(false, std::memory_order_release); }
+
+private:
+    std::atomic<bool>& isLocked;
+};
+
+/** Linear probing. @returns the slot of address, or the empty slot ending its probe sequence. */
+[[nodiscard]] size_t findSlot(const Stripe& stripe, uintptr_t address, uint64_t hash) noexcept
+{
+    const auto mask = stripe.capacity - 1;
+    auto index = getHomeSlot(hash, stripe.capacity);
+    while (stripe.slots[index].address != 0 && stripe.slots[index].address != address)
+        index = (index + 1) & mask;
+    return index;
+}
+
+/**
+ Allocates the slots of the stripe, or doubles them once more than half are used.
+ @returns false if out of memory.
+ */
+[[nodiscard]] bool reserveSlot(Stripe& stripe) noexcept
+{
+    if (stripe.slots != nullptr && (stripe.numUsed + 1) * 2 <= stripe.capacity) [[likely]]
+        return true;
+
+    qiti::MallocHooks::ScopedBypassMallocHooks bypassMallocHooks;
+
+    const auto newCapacity = (stripe.slots == nullptr) ? initialCapacityPerStripe : stripe.capacity * 2;
+    auto* newSlots = static_cast<Slot*>(std::calloc(newCapacity, sizeof(Slot))); // all empty
+    if (newSlots == nullptr)
+        return false;
+
+    Stripe grown;
+    grown.slots = newSlots;
+    grown.capacity = newCapacity;
+    for (size_t i = 0; i < stripe.capacity; ++i)
+    {
+        const auto& slot = stripe.slots[i];
+        if (slot.address != 0)
+            newSlots[findSlot(grown, slot.address, hashAddress(slot.address))] = slot;
+    }
+
+    std::free(stripe.slots);
+    stripe.slots = newSlots;
+    stripe.capacity = newCapacity;
+    return true;
+}
+
+/** Empties the slot, moving back later slots of its probe sequence so lookups never stop early (no tombstones). */
+void eraseSlot(Stripe& stripe, size_t index) noexcept
+{
+    const auto mask = stripe.capacity - 1;
+    auto next = index;
+    while (true)
+    {
+        next = (next + 1) & mask;
+        const auto& slot = stripe.slots[next];
+        if (slot.address == 0)
+            break;
+
+        // The slot can stay if its home slot is cyclically within (index, next]
+        const auto home = getHomeSlot(hashAddress(slot.address), stripe.capacity);
+        const bool canStay = (index <= next) ? (index < home && home <= next)
+                                             : (index < home || home <= next);
+        if (canStay)
+            continue;
+
+        stripe.slots[index] = slot;
+        index = next;
+    }
+
+    stripe.slots[index] = {};
+    --stripe.numUsed;
+}
+
+/** Subtracts a forgotten allocation from the thread that made it. */
+void addFreed(const Slot& slot) noexcept
+{
+    slot.owner->amountFreed.fetch_add(slot.size, std::memory_order_release);
+}
+
+/**
+ @returns the counters of an exited thread whose allocations were all freed (so no slot refers to
+          them any more), emptied into g_retiredCounters. nullptr if there are none.
+ */
+[[nodiscard]] qiti::AllocationTable::ThreadCounters* reuseExitedThreadCounters() noexcept
+{
+    ScopedSpinLock lock(g_threadCountersLock);
+
+    for (auto** link = &g_exitedThreadCounters; *link != nullptr; link = &(*link)->nextExited)
+    {
+        auto* counters = *link;
+        if (counters->getCurrentAmount() != 0)
+            continue; // still has allocations that may be freed into it
+
+        *link = counters->nextExited;
+        counters->nextExited = nullptr;
+
+        g_retiredCounters.amountAllocated.fetch_add(counters->amountAllocated.exchange(0, std::memory_order_relaxed),
+                                                    std::memory_order_relaxed);
+        g_retiredCounters.amountFreed.fetch_add(counters->amountFreed.exchange(0, std::memory_order_relaxed),
+                                                std::memory_order_relaxed);
+        return counters;
+    }
+    return nullptr;
+}
+
+/** Hands the counters of this thread over to the next threads when it exits. */
+struct ThreadCountersReleaser
+{
+    ~ThreadCountersReleaser() noexcept
+    {
+        ScopedSpinLock lock(g_threadCountersLock);
+
+        g_threadCounters->nextExited = g_exitedThreadCounters;
+        g_exitedThreadCounters = g_threadCounters;
+
+        // Later thread_local destructors may still allocate, they are counted as retired
+        g_threadCounters = nullptr;
+        g_hasThreadExited = true;
+    }
+};
+} // namespace
+
+//--------------------------------------------------------------------------
+
+namespace qiti
+{
+
+uint64_t AllocationTable::ThreadCounters::getCurrentAmount() const noexcept
+{
+    // Frees of an allocation happen after it was counted, so reading them first never underflows
+    const auto freed = amountFreed.load(std::memory_order_acquire);
+    return amountAllocated.load(std::memory_order_relaxed) - freed;
+}
+
+AllocationTable::ThreadCounters& AllocationTable::getCountersOfCurrentThread() noexcept
+{
+    if (g_threadCounters == nullptr) [[unlikely]]
+    {
+        if (g_hasThreadExited)
+            return g_retiredCounters;
+
+        MallocHooks::ScopedBypassMallocHooks bypassMallocHooks;
+
+        auto* counters = reuseExitedThreadCounters();
+        if (counters == nullptr)
+        {
+            counters = new ThreadCounters;
+            counters->next = g_allThreadCounters.load(std::memory_order_relaxed);
+            while (! g_allThreadCounters.compare_exchange_weak(counters->next, counters,
+                                                               std::memory_order_release,
+                                                               std::memory_order_relaxed))
+            {}
+        }
+        g_threadCounters = counters;
+
+        // Registers its destructor for this thread
+        static thread_local ThreadCountersReleaser releaser;
+        (void)releaser;
+    }
+    return *g_threadCounters;
+}
+
+void AllocationTable::insert(void* ptr, std::size_t size) noexcept
+{
+    auto& counters = getCountersOfCurrentThread();
+
+    const auto address = reinterpret_cast<uintptr_t>(ptr);
+    const auto hash = hashAddress(address);
+    auto& stripe = g_stripes[getStripeIndex(hash)];
+
+    if (! g_hasInserted.load(std::memory_order_relaxed)) [[unlikely]]
+        g_hasInserted.store(true, std::memory_order_relaxed);
+
+    ScopedSpinLock lock(stripe.isLocked);
+
+    if (! reserveSlot(stripe))
+        return; // untracked, like an allocation made before the test started
+
+    // An existing slot is stale: its free was not tracked (e.g. freed with the hooks bypassed)
+    auto& slot = stripe.slots[findSlot(stripe, address, hash)];
+    if (slot.address == address)
+        addFreed(slot);
+    else
+        ++stripe.numUsed;
+
+    // Only this thread writes amountAllocated, and it happens before the allocation can be freed (under the lock)
+    if (&counters == &g_retiredCounters) [[unlikely]]
+        counters.amountAllocated.fetch_add(size, std::memory_order_relaxed);
+    else
+        counters.amountAllocated.store(counters.amountAllocated.load(std::memory_order_relaxed) + size,
+                                       std::memory_order_relaxed);
+    slot = { address, size, &counters };
+}
+
+bool AllocationTable::erase(void* ptr) noexcept
+{
+    const auto address = reinterpret_cast<uintptr_t>(ptr);
+    const auto hash = hashAddress(address);
+    auto& stripe = g_stripes[getStripeIndex(hash)];
+
+    if (! g_hasInserted.load(std::memory_order_relaxed))
+        return false;
+
+    ScopedSpinLock lock(stripe.isLocked);
+
+    if (stripe.slots == nullptr)
+        return false;
+
+    const auto index = findSlot(stripe, address, hash);
+    if (stripe.slots[index].address != address)
+        return false;
+
+    addFreed(stripe.slots[index]);
+    eraseSlot(stripe, index);
+    return true;
+}
+
+uint64_t AllocationTable::getCurrentAmountInProcess() noexcept
+{
+    ScopedSpinLock lock(g_threadCountersLock); // counters being reused are counted either here or as retired
+
+    uint64_t amount = g_retiredCounters.getCurrentAmount();
+    for (auto* counters = g_allThreadCounters.load(std::memory_order_acquire); counters != nullptr; counters = counters->next)
+        amount += counters->getCurrentAmount();
+    return amount;
+}
+
+uint64_t AllocationTable::getTotalAmountInProcess() noexcept
+{
+    ScopedSpinLock lock(g_threadCountersLock);
+
+    uint64_t amount = g_retiredCounters.amountAllocated.load(std::memory_order_relaxed);
+    for (auto* counters = g_allThreadCounters.load(std::memory_order_acquire); counters != nullptr; counters = counters->next)
+        amount += counters->amountAllocated.load(std::memory_order_relaxed);
+    return amount;
+}
+
+} // namespace qiti
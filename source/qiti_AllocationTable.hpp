@@ -0,0 +1,92 @@
+/******************************************************************************
+ * Qiti — C++ Profiling Library
+ *
+ * @file     qiti_AllocationTable.hpp
+ *
+ * @author   Adam Shield
+ * @date     2026-10-16
+ *
+ * @copyright (c) 2025 Adam Shield
+ * SPDX-License-Identifier: MIT
+ *
+ * See LICENSE.txt for license terms.
+ ******************************************************************************/
+
+#pragma once
+
+#include "qiti_API.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+//--------------------------------------------------------------------------
+// Doxygen - Begin Internal Documentation
+/** \cond INTERNAL */
+//--------------------------------------------------------------------------
+
+namespace qiti
+{
+//--------------------------------------------------------------------------
+/**
+ Process-wide table of live tracked heap allocations (pointer -> size, allocating thread),
+ used for leak detection and current heap usage.
+
+ Any thread can free an allocation made by another one: the freed bytes are subtracted
+ from the allocating thread's counters, so producer/consumer code doesn't look like it leaks.
+
+ The table is split into independently locked stripes (selected by hashing the pointer), each
+ an open-addressed hash table with linear probing. Every stripe preallocates its slots on first
+ use and only reallocates them when more than half full, so inserting and erasing never
+ allocate in the common case.
+
+ @note This class is designed for internal use by the Qiti profiling system.
+ */
+class AllocationTable
+{
+public:
+    /**
+     Heap memory allocated by a thread, readable and freed into from any thread.
+     Never destroyed, as allocations (and frees into them) can outlive the thread. Once the
+     thread exited and all its allocations were freed, a new thread reuses them (their
+     amounts are kept as retired, so the totals of the process stay the same).
+     */
+    struct alignas(64) ThreadCounters
+    {
+        std::atomic<uint64_t> amountAllocated{0}; // only written by the allocating thread
+        std::atomic<uint64_t> amountFreed{0};     // by whichever thread frees
+        ThreadCounters* next = nullptr;           // in the list of all threads' counters
+        ThreadCounters* nextExited = nullptr;     // in the list of exited threads' counters
+
+        /** @returns bytes allocated by the thread that were not freed yet (by any thread). */
+        [[nodiscard]] QITI_API_INTERNAL uint64_t getCurrentAmount() const noexcept;
+    };
+
+    /** @returns the counters of the calling thread, created (or reused) on first use. */
+    [[nodiscard]] QITI_API_INTERNAL static ThreadCounters& getCountersOfCurrentThread() noexcept;
+
+    /** Hot path: records an allocation made by the calling thread. */
+    QITI_API_INTERNAL static void insert(void* ptr, std::size_t size) noexcept;
+
+    /**
+     Hot path: forgets an allocation, from any thread, and subtracts it from its allocating thread.
+     @returns false if the allocation was not tracked (e.g. made before the test started).
+     */
+    QITI_API_INTERNAL static bool erase(void* ptr) noexcept;
+
+    /** @returns bytes allocated by all threads that were not freed yet. */
+    [[nodiscard]] QITI_API_INTERNAL static uint64_t getCurrentAmountInProcess() noexcept;
+
+    /** @returns bytes ever allocated by all threads. */
+    [[nodiscard]] QITI_API_INTERNAL static uint64_t getTotalAmountInProcess() noexcept;
+
+    // Deleted constructors/destructors
+    AllocationTable() = delete;
+    ~AllocationTable() = delete;
+}; // class AllocationTable
+} // namespace qiti
+
+//--------------------------------------------------------------------------
+/** \endcond */
+// Doxygen - End Internal Documentation
+//--------------------------------------------------------------------------
@@ -0,0 +1,121 @@
+
+/******************************************************************************
+ * Qiti — C++ Profiling Library
+ *
+ * @file     qiti_CallHistory.cpp
+ *
+ * @author   Adam Shield
+ * @date     2026-10-16
+ *
+ * @copyright (c) 2025 Adam Shield
+ * SPDX-License-Identifier: MIT
+ *
+ * See LICENSE.txt for license terms.
+ ******************************************************************************/
+
+#include "qiti_CallHistory.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+//--------------------------------------------------------------------------
+
+namespace qiti
+{
+
+std::atomic<uint32_t> CallHistory::capacityPerFunction{0};
+
+CallHistory::CallHistory(uint32_t capacityToRetain) noexcept
+: capacity(std::max(capacityToRetain, 1u))
+, startTicksWallClock(std::make_unique<std::atomic<uint64_t>[]>(capacity))
+, timeSpentTicksWallClock(std::make_unique<std::atomic<uint64_t>[]>(capacity))
+, timeSpentNanosecondsCpu(std::make_unique<std::atomic<uint64_t>[]>(capacity))
+, selfTimeTicksWallClock(std::make_unique<std::atomic<uint64_t>[]>(capacity))
+, selfTimeNanosecondsCpu(std::make_unique<std::atomic<uint64_t>[]>(capacity))
+, amountHeapAllocated(std::make_unique<std::atomic<uint64_t>[]>(capacity))
+, callers(std::make_unique<std::atomic<const FunctionData*>[]>(capacity))
+, callingThreads(std::make_unique<std::atomic<std::thread::id>[]>(capacity))
+, numHeapAllocations(std::make_unique<std::atomic<uint32_t>[]>(capacity))
+, numExceptionsThrown(std::make_unique<std::atomic<uint32_t>[]>(capacity))
+{
+}
+
+void CallHistory::record(const FunctionCallData::Impl& call) noexcept
+{
+    const auto n = numRecorded.load(std::memory_order_relaxed);
+    const auto i = static_cast<size_t>(n % capacity);
+
+    startTicksWallClock[i].store(call.startTicksWallClock, std::memory_order_relaxed);
+    timeSpentTicksWallClock[i].store(call.timeSpentInFunctionTicksWallClock, std::memory_order_relaxed);
+    timeSpentNanosecondsCpu[i].store(call.timeSpentInFunctionNanosecondsCpu, std::memory_order_relaxed);
+    selfTimeTicksWallClock[i].store(call.selfTimeTicksWallClock, std::memory_order_relaxed);
+    selfTimeNanosecondsCpu[i].store(call.selfTimeNanosecondsCpu, std::memory_order_relaxed);
+    amountHeapAllocated[i].store(call.amountHeapAllocatedAfterFunctionCall - call.amountHeapAllocatedBeforeFunctionCall,
+                                 std::memory_order_relaxed);
+    callers[i].store(call.caller, std::memory_order_relaxed);
+    callingThreads[i].store(call.callingThread, std::memory_order_relaxed);
+    numHeapAllocations[i].store(call.numHeapAllocationsAfterFunctionCall - call.numHeapAllocationsBeforeFunctionCall,
+                                std::memory_order_relaxed);
+    numExceptionsThrown[i].store(static_cast<uint32_t>(call.numExceptionsThrown), std::memory_order_relaxed);
+
+    numRecorded.store(n + 1, std::memory_order_release);
+}
+
+void CallHistory::copyCalls(std::vector<FunctionCallData::Impl>& calls) const noexcept
+{
+    const auto n = numRecorded.load(std::memory_order_acquire);
+    for (auto callIndex = getFirstRetained(n); callIndex < n; ++callIndex)
+    {
+        const auto i = static_cast<size_t>(callIndex % capacity);
+
+        // Only differences are retained, so "before" counters start at 0
+        auto& call = calls.emplace_back();
+        call.callingThread = callingThreads[i].load(std::memory_order_relaxed);
+        call.caller = callers[i].load(std::memory_order_relaxed);
+        call.startTicksWallClock = startTicksWallClock[i].load(std::memory_order_relaxed);
+        call.timeSpentInFunctionTicksWallClock = timeSpentTicksWallClock[i].load(std::memory_order_relaxed);
+        call.endTicksWallClock = call.startTicksWallClock + call.timeSpentInFunctionTicksWallClock;
+        call.timeSpentInFunctionNanosecondsCpu = timeSpentNanosecondsCpu[i].load(std::memory_order_relaxed);
+        call.endTimeCpu_ns = call.timeSpentInFunctionNanosecondsCpu;
+        call.selfTimeTicksWallClock = selfTimeTicksWallClock[i].load(std::memory_order_relaxed);
+        call.selfTimeNanosecondsCpu = selfTimeNanosecondsCpu[i].load(std::memory_order_relaxed);
+        call.numHeapAllocationsAfterFunctionCall = numHeapAllocations[i].load(std::memory_order_relaxed);
+        call.amountHeapAllocatedAfterFunctionCall = amountHeapAllocated[i].load(std::memory_order_relaxed);
+        call.numExceptionsThrown = numExceptionsThrown[i].load(std::memory_order_relaxed);
+    }
+}
+
+void CallHistory::copyColumn(Column column, std::vector<uint64_t>& values) const noexcept
+{
+    const std::atomic<uint64_t>* source = nullptr;
+    switch (column)
+    {
+        case Column::timeSpentTicksWallClock: source = timeSpentTicksWallClock.get(); break;
+        case Column::timeSpentNanosecondsCpu: source = timeSpentNanosecondsCpu.get(); break;
+        case Column::amountHeapAllocated:     source = amountHeapAllocated.get();     break;
+    }
+
+    const auto n = numRecorded.load(std::memory_order_acquire);
+    const auto numRetained = static_cast<size_t>(n - getFirstRetained(n));
+    for (size_t i = 0; i < numRetained; ++i) // order doesn't matter, avoid the modulo
+        values.push_back(source[i].load(std::memory_order_relaxed));
+}
+
+uint64_t CallHistory::percentile(std::vector<uint64_t>& values, double percentile) noexcept
+{
+    if (values.empty())
+        return 0;
+
+    // Nearest-rank: smallest value that at least percentile% of the values are less than or equal to
+    const auto rank = static_cast<size_t>(std::ceil(percentile / 100.0 * static_cast<double>(values.size())));
+    const auto index = std::clamp(rank, size_t{1}, values.size()) - 1;
+
+    std::nth_element(values.begin(), values.begin() + static_cast<std::ptrdiff_t>(index), values.end());
+    return values[index];
+}
+
+} // namespace qiti
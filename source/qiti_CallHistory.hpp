@@ -0,0 +1,106 @@
+/******************************************************************************
+ * Qiti — C++ Profiling Library
+ *
+ * @file     qiti_CallHistory.hpp
+ *
+ * @author   Adam Shield
+ * @date     2026-10-16
+ *
+ * @copyright (c) 2025 Adam Shield
+ * SPDX-License-Identifier: MIT
+ *
+ * See LICENSE.txt for license terms.
+ ******************************************************************************/
+
+#pragma once
+
+#include "qiti_API.hpp"
+
+#include "qiti_FunctionCallData_Impl.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+//--------------------------------------------------------------------------
+// Doxygen - Begin Internal Documentation
+/** \cond INTERNAL */
+//--------------------------------------------------------------------------
+
+namespace qiti
+{
+class FunctionData;
+
+//--------------------------------------------------------------------------
+/**
+ Fixed-capacity ring of the most recent calls of one function on one thread shard.
+
+ Stored as a structure of arrays, so percentile queries only touch the column they sort,
+ and one call costs 72 bytes instead of a heap allocated FunctionCallData.
+
+ Single writer (the thread owning the FunctionData::Impl::ThreadShard, which is handed on to
+ another thread when it exits, hence the calling thread of every call). Columns are relaxed
+ atomics, so other threads may read at any time, but a call overwritten while it is being
+ read may mix columns of two calls.
+
+ @note This class is designed for internal use by the Qiti profiling system.
+ */
+class CallHistory
+{
+public:
+    /** Maximum number of calls retained per function and thread, 0 = history disabled (default). */
+    QITI_API_VAR static std::atomic<uint32_t> capacityPerFunction;
+
+    QITI_API_INTERNAL explicit CallHistory(uint32_t capacity) noexcept;
+
+    /** Writer only: adds a completed call, overwriting the oldest one when full. */
+    QITI_API_INTERNAL void record(const FunctionCallData::Impl& call) noexcept;
+
+    /** Appends the retained calls (oldest first) to calls. */
+    QITI_API_INTERNAL void copyCalls(std::vector<FunctionCallData::Impl>& calls) const noexcept;
+
+    /** The value of a call that percentiles can be queried for. */
+    enum class Column
+    {
+        timeSpentTicksWallClock,
+        timeSpentNanosecondsCpu,
+        amountHeapAllocated
+    };
+
+    /** Appends the given column of the retained calls (in no particular order) to values. */
+    QITI_API_INTERNAL void copyColumn(Column column, std::vector<uint64_t>& values) const noexcept;
+
+    /** Nearest-rank percentile (0 < percentile <= 100) of values, which is partially reordered. 0 if empty. */
+    [[nodiscard]] QITI_API_INTERNAL static uint64_t percentile(std::vector<uint64_t>& values, double percentile) noexcept;
+
+private:
+    const uint32_t capacity;
+
+    /** Total calls ever recorded, the oldest retained call is at max(0, numRecorded - capacity). */
+    std::atomic<uint64_t> numRecorded{0};
+
+    std::unique_ptr<std::atomic<uint64_t>[]> startTicksWallClock;
+    std::unique_ptr<std::atomic<uint64_t>[]> timeSpentTicksWallClock;
+    std::unique_ptr<std::atomic<uint64_t>[]> timeSpentNanosecondsCpu;
+    std::unique_ptr<std::atomic<uint64_t>[]> selfTimeTicksWallClock;
+    std::unique_ptr<std::atomic<uint64_t>[]> selfTimeNanosecondsCpu;
+    std::unique_ptr<std::atomic<uint64_t>[]> amountHeapAllocated;
+    std::unique_ptr<std::atomic<const FunctionData*>[]> callers;
+    std::unique_ptr<std::atomic<std::thread::id>[]> callingThreads;
+    std::unique_ptr<std::atomic<uint32_t>[]> numHeapAllocations;
+    std::unique_ptr<std::atomic<uint32_t>[]> numExceptionsThrown;
+
+    [[nodiscard]] uint64_t getFirstRetained(uint64_t numRecordedSoFar) const noexcept
+    {
+        return (numRecordedSoFar > capacity) ? numRecordedSoFar - capacity : 0;
+    }
+}; // class CallHistory
+} // namespace qiti
+
+//--------------------------------------------------------------------------
+/** \endcond */
+// Doxygen - End Internal Documentation
+//--------------------------------------------------------------------------
@@ -0,0 +1,143 @@
+
+/******************************************************************************
+ * Qiti — C++ Profiling Library
+ *
+ * @file     qiti_CallingContextTree.cpp
+ *
+ * @author   Adam Shield
+ * @date     2026-10-16
+ *
+ * @copyright (c) 2025 Adam Shield
+ * SPDX-License-Identifier: MIT
+ *
+ * See LICENSE.txt for license terms.
+ ******************************************************************************/
+
+#include "qiti_CallingContextTree.hpp"
+
+#include "qiti_Clock.hpp"
+#include "qiti_ContextTree.hpp"
+#include "qiti_DeferredEvents.hpp"
+#include "qiti_MallocHooks.hpp"
+#include "qiti_Profile.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <initializer_list>
+#include <vector>
+
+//--------------------------------------------------------------------------
+
+using Node = qiti::CallingContextTree::Node;
+
+/** Adds a thread's node (and all nodes below it) to merged, keeping wall clock times in ticks. */
+QITI_API_INTERNAL static void mergeNode(Node& merged, const qiti::ContextTree::Node& node) noexcept
+{
+    merged.numCalls += node.numCalls.load(std::memory_order_relaxed);
+    merged.inclusiveTimeWallClock_ns += node.inclusiveTicksWallClock.load(std::memory_order_relaxed);
+    merged.selfTimeWallClock_ns += node.selfTicksWallClock.load(std::memory_order_relaxed);
+    merged.inclusiveTimeCpu_ns += node.inclusiveTimeCpu_ns.load(std::memory_order_relaxed);
+    merged.selfTimeCpu_ns += node.selfTimeCpu_ns.load(std::memory_order_relaxed);
+    merged.amountHeapAllocated += node.amountHeapAllocated.load(std::memory_order_relaxed);
+    
+    for (auto* child = node.firstChild.load(std::memory_order_acquire); child != nullptr; child = child->nextSibling)
+    {
+        auto it = std::ranges::find(merged.children, child->function, &Node::function);
+        if (it == merged.children.end())
+        {
+            it = merged.children.insert(merged.children.end(), Node{});
+            it->function = child->function;
+        }
+        mergeNode(*it, *child);
+    }
+}
+
+/** Converts the merged ticks of the node and its descendants to nanoseconds, and sorts every node's children. */
+QITI_API_INTERNAL static void finishNode(Node& node) noexcept
+{
+    node.inclusiveTimeWallClock_ns = qiti::Clock::ticksToNanoseconds(node.inclusiveTimeWallClock_ns);
+    node.selfTimeWallClock_ns = qiti::Clock::ticksToNanoseconds(node.selfTimeWallClock_ns);
+    
+    for (auto& child : node.children)
+        finishNode(child);
+    
+    // Most expensive call paths first
+    std::ranges::sort(node.children, std::ranges::greater{}, &Node::inclusiveTimeWallClock_ns);
+}
+
+QITI_API_INTERNAL static void walkNode(const Node& node,
+                                       size_t depth,
+                                       const std::function<void(const Node&, size_t)>& visitor) noexcept
+{
+    for (const auto& child : node.children)
+    {
+        visitor(child, depth + 1);
+        walkNode(child, depth + 1, visitor);
+    }
+}
+
+//--------------------------------------------------------------------------
+
+namespace qiti
+{
+
+const Node* Node::findChild(const FunctionData* childFunction) const noexcept
+{
+    const auto it = std::ranges::find(children, childFunction, &Node::function);
+    return (it != children.end()) ? &*it : nullptr;
+}
+
+Node CallingContextTree::getMergedTree() noexcept
+{
+    Profile::ScopedDisableProfiling disableProfiling;
+    MallocHooks::ScopedBypassMallocHooks bypassMallocHooks;
+    
+    DeferredEvents::drain(); // fold in calls that were only recorded so far
+    
+    Node root;
+    ContextTree::forEachTree([&root](const ContextTree::Node& threadRoot) { mergeNode(root, threadRoot); });
+    finishNode(root);
+    
+    for (const auto& child : root.children)
+    {
+        root.inclusiveTimeWallClock_ns += child.inclusiveTimeWallClock_ns;
+        root.inclusiveTimeCpu_ns += child.inclusiveTimeCpu_ns;
+        root.amountHeapAllocated += child.amountHeapAllocated;
+    }
+    return root;
+}
+
+const Node* CallingContextTree::findPath(const Node& from, std::initializer_list<const FunctionData*> path) noexcept
+{
+    const Node* node = &from;
+    for (const auto* function : path)
+    {
+        node = node->findChild(function);
+        if (node == nullptr)
+            return nullptr;
+    }
+    return node;
+}
+
+std::vector<const Node*> CallingContextTree::findNodes(const Node& from, const FunctionData* function) noexcept
+{
+    Profile::ScopedDisableProfiling disableProfiling;
+    MallocHooks::ScopedBypassMallocHooks bypassMallocHooks;
+    
+    std::vector<const Node*> result;
+    walkNode(from, 0, [&result, function](const Node& node, size_t)
+    {
+        if (node.function == function)
+            result.push_back(&node);
+    });
+    return result;
+}
+
+void CallingContextTree::walk(const Node& from, const std::function<void(const Node& node, size_t depth)>& visitor) noexcept
+{
+    walkNode(from, 0, visitor);
+}
+
+} // namespace qiti
@@ -0,0 +1,109 @@
+/******************************************************************************
+ * Qiti — C++ Profiling Library
+ *
+ * @file     qiti_CallingContextTree.hpp
+ *
+ * @author   Adam Shield
+ * @date     2026-10-16
+ *
+ * @copyright (c) 2025 Adam Shield
+ * SPDX-License-Identifier: MIT
+ *
+ * See LICENSE.txt for license terms.
+ ******************************************************************************/
+
+#pragma once
+
+#include "qiti_API.hpp"
+#include "qiti_FunctionData.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <vector>
+
+//--------------------------------------------------------------------------
+
+namespace qiti
+{
+//--------------------------------------------------------------------------
+
+/**
+ Profiling data per call path (calling context) rather than per function.
+ 
+ Per-function data loses context: parse() may be cheap when called from load() and
+ costly when called from reload(). The calling-context tree has one node per distinct
+ call path, so both cases are measured separately.
+ 
+ @code
+ TEST_CASE("Reload parses slowly") {
+     qiti::ScopedQitiTest test;
+     test.enableProfilingOnAllFunctions(true);
+     test.enableCallingContextTree(true);
+     
+     load();
+     reload();
+     
+     const auto tree = qiti::CallingContextTree::getMergedTree();
+     const auto* load   = qiti::FunctionData::getFunctionData<&load>();
+     const auto* reload = qiti::FunctionData::getFunctionData<&reload>();
+     const auto* parse  = qiti::FunctionData::getFunctionData<&parse>();
+     
+     const auto* parseFromLoad   = qiti::CallingContextTree::findPath(tree, { load, parse });
+     const auto* parseFromReload = qiti::CallingContextTree::findPath(tree, { reload, parse });
+     CHECK(parseFromReload->inclusiveTimeWallClock_ns > parseFromLoad->inclusiveTimeWallClock_ns);
+ }
+ @endcode
+ */
+class CallingContextTree
+{
+public:
+    /** One call path: the calls of function made through the functions of all its ancestors. */
+    struct Node
+    {
+        const FunctionData* function = nullptr; ///< nullptr for the root
+        uint64_t numCalls = 0;                  ///< sampled calls only
+        uint64_t inclusiveTimeWallClock_ns = 0;
+        uint64_t selfTimeWallClock_ns = 0;      ///< excluding the time spent in the profiled functions it called
+        uint64_t inclusiveTimeCpu_ns = 0;
+        uint64_t selfTimeCpu_ns = 0;
+        uint64_t amountHeapAllocated = 0;       ///< bytes, including the profiled functions it called
+        std::vector<Node> children;
+        
+        /** @returns the child for the given function, nullptr if it never called that function. */
+        [[nodiscard]] QITI_API const Node* findChild(const FunctionData* childFunction) const noexcept;
+        
+        // Explicitly define destructor to prevent instrumentation
+        QITI_API ~Node() noexcept = default;
+    };
+    
+    /**
+     @returns the root of the calling-context trees of all threads merged together.
+     The children of the root are the profiled functions called from unprofiled code (e.g. the test).
+     
+     Empty unless enabled with ScopedQitiTest::enableCallingContextTree().
+     */
+    [[nodiscard]] QITI_API static Node getMergedTree() noexcept;
+    
+    /**
+     @returns the node at the end of path (a list of functions, each called by the previous one)
+     from the given node, nullptr if that path was never called.
+     */
+    [[nodiscard]] QITI_API static const Node* findPath(const Node& from,
+                                                       std::initializer_list<const FunctionData*> path) noexcept;
+    
+    /** @returns every node of function below the given node (all the contexts it was called from), depth first. */
+    [[nodiscard]] QITI_API static std::vector<const Node*> findNodes(const Node& from, const FunctionData* function) noexcept;
+    
+    /** Calls visitor for every node below the given node (depth first), with its depth below from. */
+    QITI_API static void walk(const Node& from, const std::function<void(const Node& node, size_t depth)>& visitor) noexcept;
+    
+    // Deleted constructors/destructors
+    CallingContextTree() = delete;
+    ~CallingContextTree() = delete;
+};
+
+//--------------------------------------------------------------------------
+} // namespace qiti
+//--------------------------------------------------------------------------
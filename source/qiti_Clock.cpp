@@ -0,0 +1,304 @@
+
+/******************************************************************************
+ * Qiti — C++ Profiling Library
+ *
+ * @file     qiti_Clock.cpp
+ *
+ * @author   Adam Shield
+ * @date     2026-10-16
+ *
+ * @copyright (c) 2025 Adam Shield
+ * SPDX-License-Identifier: MIT
+ *
+ * See LICENSE.txt for license terms.
+ ******************************************************************************/
+
+#include "qiti_Clock.hpp"
+
+#include "qiti_MallocHooks.hpp"
+
+#if QITI_CLOCK_HAS_TSC
+#include <cpuid.h>
+#include <linux/perf_event.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+
+//--------------------------------------------------------------------------
+
+/** How long to measure the TSC against steady_clock for. Only paid once per process. */
+static constexpr auto calibrationDuration = std::chrono::milliseconds(10);
+
+/** Nanoseconds per TSC tick, 0 until calibrated (or if the TSC is unavailable). */
+static std::atomic<double> g_tscNanosecondsPerTick{0.0};
+
+#if QITI_CLOCK_HAS_TSC
+QITI_API_INTERNAL static bool cpuHasInvariantTsc() noexcept
+{
+    unsigned int eax = 0, ebx = 0, ecx = 0, edx = 0;
+    if (! __get_cpuid(0x80000000, &eax, &ebx, &ecx, &edx) || eax < 0x80000007)
+        return false;
+    
+    // CPUID.80000007H:EDX[8] = Invariant TSC
+    if (! __get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx))
+        return false;
+    return (edx & (1u << 8)) != 0;
+}
+
+QITI_API_INTERNAL static double calibrateTsc() noexcept
+{
+    using SteadyClock = std::chrono::steady_clock;
+    
+    const auto steadyStart = SteadyClock::now();
+    const auto tscStart = __rdtsc();
+    
+    auto steadyEnd = steadyStart;
+    while (steadyEnd - steadyStart < calibrationDuration)
+        steadyEnd = SteadyClock::now();
+    
+    unsigned int aux;
+    const auto tscEnd = __rdtscp(&aux);
+    
+    const auto elapsed_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(steadyEnd - steadyStart).count();
+    if (tscEnd <= tscStart)
+        return 0.0;
+    return static_cast<double>(elapsed_ns) / static_cast<double>(tscEnd - tscStart);
+}
+
+/** A perf_event_open() task-clock counter of one thread, mmapped so it can be read without a syscall. */
+struct PerfTaskClock
+{
+    int fd = -1;
+    const volatile perf_event_mmap_page* page = nullptr;
+    bool failedToOpen = false;
+};
+
+QITI_API_INTERNAL static bool openPerfTaskClock(PerfTaskClock& clock) noexcept
+{
+    perf_event_attr attr{};
+    attr.size   = sizeof(attr);
+    attr.type   = PERF_TYPE_SOFTWARE;
+    attr.config = PERF_COUNT_SW_TASK_CLOCK;
+    
+    // pid = 0, cpu = -1: the calling thread, on any CPU
+    const auto fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, PERF_FLAG_FD_CLOEXEC));
+    if (fd < 0)
+        return false;
+    
+    const auto pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    void* page = mmap(nullptr, pageSize, PROT_READ, MAP_SHARED, fd, 0);
+    if (page == MAP_FAILED)
+    {
+        close(fd);
+        return false;
+    }
+    
+    // Without cap_user_time the page is only updated on read(), which is the syscall we want to avoid
+    if (! static_cast<const perf_event_mmap_page*>(page)->cap_user_time)
+    {
+        munmap(page, pageSize);
+        close(fd);
+        return false;
+    }
+    
+    clock.fd = fd;
+    clock.page = static_cast<const volatile perf_event_mmap_page*>(page);
+    return true;
+}
+
+QITI_API_INTERNAL static void closePerfTaskClock(PerfTaskClock& clock) noexcept
+{
+    if (clock.page != nullptr)
+        munmap(const_cast<perf_event_mmap_page*>(clock.page), static_cast<size_t>(sysconf(_SC_PAGESIZE)));
+    if (clock.fd >= 0)
+        close(clock.fd);
+    clock = {};
+}
+
+/**
+ Reads the counter from userspace (see "struct perf_event_mmap_page" in linux/perf_event.h).
+ 
+ The kernel updates time_running when the thread is scheduled in, the time since then is
+ derived from the TSC using the conversion the kernel publishes in the same page.
+ */
+QITI_API_INTERNAL static uint64_t readPerfTaskClock(const volatile perf_event_mmap_page* page) noexcept
+{
+    uint32_t sequence;
+    uint64_t running, cycles, timeOffset;
+    uint32_t timeMult;
+    uint16_t timeShift;
+    do
+    {
+        sequence = page->lock;
+        std::atomic_signal_fence(std::memory_order_acq_rel);
+        running    = page->time_running;
+        timeOffset = page->time_offset;
+        timeMult   = page->time_mult;
+        timeShift  = page->time_shift;
+        cycles     = __rdtsc();
+        std::atomic_signal_fence(std::memory_order_acq_rel);
+    }
+    while (page->lock != sequence);
+    
+    const uint64_t quotient  = cycles >> timeShift;
+    const uint64_t remainder = cycles & ((uint64_t{1} << timeShift) - 1);
+    const uint64_t delta = timeOffset + quotient * timeMult + ((remainder * timeMult) >> timeShift);
+    return running + delta;
+}
+
+/** This thread's counter. Trivially destructible so reading it never registers a TLS destructor. */
+static constinit thread_local PerfTaskClock g_perfTaskClock{};
+
+/**
+ Closes this thread's counter when the thread exits.
+ Only touched when opening the counter, as registering its TLS destructor allocates.
+ */
+static thread_local struct PerfTaskClockCloser final
+{
+    bool isArmed = false;
+    
+    ~PerfTaskClockCloser() noexcept
+    {
+        if (isArmed)
+            closePerfTaskClock(g_perfTaskClock);
+    }
+} g_perfTaskClockCloser;
+
+/** Checks that the counter tracks clock_gettime(), including across the thread being descheduled. */
+QITI_API_INTERNAL static bool verifyPerfTaskClock() noexcept
+{
+    PerfTaskClock clock;
+    if (! openPerfTaskClock(clock))
+        return false;
+    
+    auto cpuTimeNow_ns = []
+    {
+        timespec now{};
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+        return static_cast<uint64_t>(now.tv_sec) * 1'000'000'000ULL + static_cast<uint64_t>(now.tv_nsec);
+    };
+    auto spin = [&](uint64_t duration_ns)
+    {
+        const auto start = cpuTimeNow_ns();
+        while (cpuTimeNow_ns() - start < duration_ns) {}
+    };
+    
+    const auto perfStart = readPerfTaskClock(clock.page);
+    const auto cpuStart = cpuTimeNow_ns();
+    spin(2'000'000);
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    spin(2'000'000);
+    const auto cpuEnd = cpuTimeNow_ns();
+    const auto perfEnd = readPerfTaskClock(clock.page);
+    
+    closePerfTaskClock(clock);
+    
+    if (perfEnd < perfStart)
+        return false;
+    
+    const auto perfElapsed = perfEnd - perfStart;
+    const auto cpuElapsed  = cpuEnd - cpuStart;
+    const auto difference  = (perfElapsed > cpuElapsed) ? perfElapsed - cpuElapsed : cpuElapsed - perfElapsed;
+    return difference <= cpuElapsed / 20 + 100'000; // 5% + 100us
+}
+#endif // QITI_CLOCK_HAS_TSC
+
+//--------------------------------------------------------------------------
+
+namespace qiti
+{
+
+std::atomic<Clock::WallSource> Clock::wallSource{Clock::WallSource::steadyClock};
+std::atomic<Clock::CpuSource>  Clock::cpuSource{Clock::CpuSource::clockGettime};
+
+uint64_t Clock::ticksToNanoseconds(uint64_t ticks) noexcept
+{
+    if (wallSource.load(std::memory_order_relaxed) == WallSource::steadyClock)
+        return ticks;
+    
+    return static_cast<uint64_t>(static_cast<double>(ticks) * g_tscNanosecondsPerTick.load(std::memory_order_relaxed));
+}
+
+void Clock::reset() noexcept
+{
+#if QITI_CLOCK_HAS_TSC
+    // Thread-safe, once per process
+    static const double tscNanosecondsPerTick = cpuHasInvariantTsc() ? calibrateTsc() : 0.0;
+    g_tscNanosecondsPerTick.store(tscNanosecondsPerTick, std::memory_order_relaxed);
+#endif
+    
+    (void)setWallSource(WallSource::tsc);
+    (void)setCpuSource(CpuSource::clockGettime);
+}
+
+bool Clock::setWallSource(WallSource newSource) noexcept
+{
+    const bool isAvailable = (newSource != WallSource::tsc) || isTscAvailable();
+    
+    wallSource.store(isAvailable ? newSource : WallSource::steadyClock, std::memory_order_relaxed);
+    return isAvailable;
+}
+
+Clock::WallSource Clock::getWallSource() noexcept
+{
+    return wallSource.load(std::memory_order_relaxed);
+}
+
+bool Clock::setCpuSource(CpuSource newSource) noexcept
+{
+    const bool isAvailable = (newSource != CpuSource::perfTaskClock) || isPerfTaskClockAvailable();
+    
+    cpuSource.store(isAvailable ? newSource : CpuSource::clockGettime, std::memory_order_relaxed);
+    return isAvailable;
+}
+
+Clock::CpuSource Clock::getCpuSource() noexcept
+{
+    return cpuSource.load(std::memory_order_relaxed);
+}
+
+bool Clock::isTscAvailable() noexcept
+{
+    return g_tscNanosecondsPerTick.load(std::memory_order_relaxed) > 0.0;
+}
+
+bool Clock::isPerfTaskClockAvailable() noexcept
+{
+#if QITI_CLOCK_HAS_TSC
+    static const bool isAvailable = verifyPerfTaskClock(); // thread-safe, once per process
+    return isAvailable;
+#else
+    return false;
+#endif
+}
+
+uint64_t Clock::perfTaskClockNow_ns() noexcept
+{
+#if QITI_CLOCK_HAS_TSC
+    auto& clock = g_perfTaskClock;
+    if (clock.page == nullptr) [[unlikely]]
+    {
+        if (clock.failedToOpen)
+            return clockGettimeNow_ns();
+        
+        MallocHooks::ScopedBypassMallocHooks bypassMallocHooks;
+        if (! openPerfTaskClock(clock))
+        {
+            clock.failedToOpen = true; // e.g. out of file descriptors, don't retry on every call
+            return clockGettimeNow_ns();
+        }
+        g_perfTaskClockCloser.isArmed = true;
+    }
+    return readPerfTaskClock(clock.page);
+#else
+    return clockGettimeNow_ns();
+#endif
+}
+
+} // namespace qiti
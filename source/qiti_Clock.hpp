@@ -0,0 +1,178 @@
+/******************************************************************************
+ * Qiti — C++ Profiling Library
+ *
+ * @file     qiti_Clock.hpp
+ *
+ * @author   Adam Shield
+ * @date     2026-10-16
+ *
+ * @copyright (c) 2025 Adam Shield
+ * SPDX-License-Identifier: MIT
+ *
+ * See LICENSE.txt for license terms.
+ ******************************************************************************/
+
+#pragma once
+
+#include "qiti_API.hpp"
+
+#include <time.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#if defined(__x86_64__) && defined(__linux__)
+#include <x86intrin.h>
+#define QITI_CLOCK_HAS_TSC 1
+#else
+#define QITI_CLOCK_HAS_TSC 0
+#endif
+
+//--------------------------------------------------------------------------
+// Doxygen - Begin Internal Documentation
+/** \cond INTERNAL */
+//--------------------------------------------------------------------------
+
+namespace qiti
+{
+//--------------------------------------------------------------------------
+/**
+ Timestamps taken by the instrumentation hooks.
+
+ Wall clock:
+ The hooks only store raw ticks (and differences of raw ticks), which are converted to
+ nanoseconds lazily by the FunctionCallData/FunctionData getters via ticksToNanoseconds().
+ - steadyClock: std::chrono::steady_clock, 1 tick = 1 nanosecond (default fallback).
+ - tsc: the x86_64 time stamp counter (rdtsc/rdtscp), only available on Linux when the
+   CPU reports an invariant TSC. Calibrated once against steady_clock.
+
+ Thread CPU time (always in nanoseconds):
+ - clockGettime: clock_gettime(CLOCK_THREAD_CPUTIME_ID), a real syscall on Linux (not vDSO).
+ - perfTaskClock: a per-thread perf_event_open() software task-clock counter, read from
+   userspace through its mmap page (time_running + TSC delta since the kernel last updated
+   the page). Only available on x86_64 Linux when the kernel allows perf events and exposes
+   cap_user_time, and verified against clock_gettime once before being used.
+
+ @note This class is designed for internal use by the Qiti profiling system.
+ */
+class Clock
+{
+public:
+    enum class WallSource : uint8_t
+    {
+        steadyClock,
+        tsc
+    };
+
+    enum class CpuSource : uint8_t
+    {
+        clockGettime,
+        perfTaskClock
+    };
+
+    /** Timestamp for the start of a measured interval. Only meaningful relative to another timestamp. */
+    [[nodiscard]] QITI_API_INLINE static inline uint64_t startTimestamp() noexcept
+    {
+#if QITI_CLOCK_HAS_TSC
+        if (wallSource.load(std::memory_order_relaxed) == WallSource::tsc)
+            return __rdtsc();
+#endif
+        return steadyClockNow_ns();
+    }
+
+    /**
+     Timestamp for the end of a measured interval.
+     Waits for all prior instructions to execute first, so the measured work is not cut short.
+     */
+    [[nodiscard]] QITI_API_INLINE static inline uint64_t endTimestamp() noexcept
+    {
+#if QITI_CLOCK_HAS_TSC
+        if (wallSource.load(std::memory_order_relaxed) == WallSource::tsc)
+        {
+            unsigned int aux;
+            return __rdtscp(&aux);
+        }
+#endif
+        return steadyClockNow_ns();
+    }
+
+    /** Converts a number of wall clock ticks of the current source to nanoseconds. */
+    [[nodiscard]] QITI_API static uint64_t ticksToNanoseconds(uint64_t ticks) noexcept;
+
+    /**
+     CPU time consumed by the calling thread, in nanoseconds.
+     Always 0 on Windows (CPU time feature not supported).
+     */
+    [[nodiscard]] QITI_API_INLINE static inline uint64_t threadCpuTime_ns() noexcept
+    {
+        if (cpuSource.load(std::memory_order_relaxed) == CpuSource::perfTaskClock)
+            return perfTaskClockNow_ns();
+        return clockGettimeNow_ns();
+    }
+
+    /**
+     Calibrates the TSC against steady_clock (only the first time this is called) and
+     selects the default sources: tsc if the TSC is invariant (steadyClock otherwise) and clockGettime.
+
+     Called when a ScopedQitiTest starts.
+     */
+    QITI_API static void reset() noexcept;
+
+    /**
+     Selects the source of wall clock timestamps.
+     Ticks recorded with the previous source must not be mixed with ticks of the new source.
+     @returns false (and selects steadyClock) if the source is not available on this machine.
+     */
+    QITI_API static bool setWallSource(WallSource newSource) noexcept;
+
+    [[nodiscard]] QITI_API static WallSource getWallSource() noexcept;
+
+    /**
+     Selects the source of thread CPU time.
+     @returns false (and selects clockGettime) if the source is not available on this machine.
+     */
+    QITI_API static bool setCpuSource(CpuSource newSource) noexcept;
+
+    [[nodiscard]] QITI_API static CpuSource getCpuSource() noexcept;
+
+    /** @returns true if the CPU has an invariant TSC (constant rate, keeps ticking in deep sleep states). */
+    [[nodiscard]] QITI_API static bool isTscAvailable() noexcept;
+
+    /** @returns true if perf task-clock counters can be read from userspace (checked once, slow the first time). */
+    [[nodiscard]] QITI_API static bool isPerfTaskClockAvailable() noexcept;
+
+    // Deleted constructors/destructors
+    Clock() = delete;
+    ~Clock() = delete;
+
+private:
+    [[nodiscard]] QITI_API_INLINE static inline uint64_t steadyClockNow_ns() noexcept
+    {
+        const auto now = std::chrono::steady_clock::now().time_since_epoch();
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(now).count());
+    }
+
+    [[nodiscard]] QITI_API_INLINE static inline uint64_t clockGettimeNow_ns() noexcept
+    {
+#ifdef _WIN32 // CPU Time feature not supported on Windows
+        return 0;
+#else
+        timespec now{};
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+        return static_cast<uint64_t>(now.tv_sec) * 1'000'000'000ULL + static_cast<uint64_t>(now.tv_nsec);
+#endif
+    }
+
+    /** Opens the calling thread's counter on first use, falls back to clock_gettime if that fails. */
+    [[nodiscard]] QITI_API static uint64_t perfTaskClockNow_ns() noexcept;
+
+    QITI_API_VAR static std::atomic<WallSource> wallSource;
+    QITI_API_VAR static std::atomic<CpuSource> cpuSource;
+}; // class Clock
+} // namespace qiti
+
+//--------------------------------------------------------------------------
+/** \endcond */
+// Doxygen - End Internal Documentation
+//--------------------------------------------------------------------------
@@ -0,0 +1,135 @@
+
+/******************************************************************************
+ * Qiti — C++ Profiling Library
+ *
+ * @file     qiti_ContextTree.cpp
+ *
+ * @author   Adam Shield
+ * @date     2026-10-16
+ *
+ * @copyright (c) 2025 Adam Shield
+ * SPDX-License-Identifier: MIT
+ *
+ * See LICENSE.txt for license terms.
+ ******************************************************************************/
+
+#include "qiti_ContextTree.hpp"
+
+#include "qiti_MallocHooks.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+//--------------------------------------------------------------------------
+
+namespace qiti
+{
+
+std::atomic<bool> ContextTree::enabled{false};
+std::atomic<uint32_t> ContextTree::maxDepth{ContextTree::defaultMaxDepth};
+std::atomic<ContextTree*> ContextTree::trees{nullptr};
+std::atomic<uint64_t> ContextTree::generation{0};
+
+/** Single-writer increment, only to be called from the thread owning the counter. */
+QITI_API_INTERNAL static void addToNodeCounter(std::atomic<uint64_t>& counter, uint64_t value) noexcept
+{
+    counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
+ContextTree& ContextTree::getTree(ContextTree*& cachedTree, uint64_t& cachedGeneration) noexcept
+{
+    const auto currentGeneration = generation.load(std::memory_order_acquire);
+    if (cachedTree != nullptr && cachedGeneration == currentGeneration) [[likely]]
+        return *cachedTree;
+    
+    // First call of this thread (since the last reset)
+    MallocHooks::ScopedBypassMallocHooks bypassMallocHooks;
+    
+    auto* tree = new ContextTree();
+    tree->next = trees.load(std::memory_order_relaxed);
+    while (! trees.compare_exchange_weak(tree->next, tree,
+                                         std::memory_order_release,
+                                         std::memory_order_relaxed))
+    {
+    }
+    
+    cachedTree = tree;
+    cachedGeneration = currentGeneration;
+    return *tree;
+}
+
+std::unique_ptr<ContextTree> ContextTree::createUnlistedTree(uint64_t& cachedGeneration) noexcept
+{
+    MallocHooks::ScopedBypassMallocHooks bypassMallocHooks;
+    
+    cachedGeneration = generation.load(std::memory_order_acquire);
+    return std::make_unique<ContextTree>();
+}
+
+ContextTree::Node* ContextTree::getChild(Node& parent, const FunctionData* function) noexcept
+{
+    // Callers only have a handful of callees, a list is faster than hashing
+    auto* child = parent.firstChild.load(std::memory_order_relaxed);
+    while (child != nullptr && child->function != function)
+        child = child->nextSibling;
+    
+    if (child != nullptr)
+        return child;
+    
+    if (parent.depth >= maxDepth.load(std::memory_order_relaxed))
+        return nullptr;
+    
+    if (numNodesUsedInLastChunk == nodesPerChunk)
+    {
+        if (chunks.size() * nodesPerChunk >= maxNodesPerThread)
+            return nullptr; // pool exhausted
+        
+        MallocHooks::ScopedBypassMallocHooks bypassMallocHooks;
+        chunks.push_back(std::make_unique<Node[]>(nodesPerChunk));
+        numNodesUsedInLastChunk = 0;
+    }
+    
+    child = &chunks.back()[numNodesUsedInLastChunk++];
+    child->function = function;
+    child->depth = parent.depth + 1;
+    child->nextSibling = parent.firstChild.load(std::memory_order_relaxed);
+    parent.firstChild.store(child, std::memory_order_release); // publish to readers
+    return child;
+}
+
+void ContextTree::record(Node& node,
+                         uint64_t inclusiveTicksWallClock,
+                         uint64_t selfTicksWallClock,
+                         uint64_t inclusiveTimeCpu_ns,
+                         uint64_t selfTimeCpu_ns,
+                         uint64_t amountHeapAllocated) noexcept
+{
+    addToNodeCounter(node.numCalls, 1);
+    addToNodeCounter(node.inclusiveTicksWallClock, inclusiveTicksWallClock);
+    addToNodeCounter(node.selfTicksWallClock, selfTicksWallClock);
+    addToNodeCounter(node.inclusiveTimeCpu_ns, inclusiveTimeCpu_ns);
+    addToNodeCounter(node.selfTimeCpu_ns, selfTimeCpu_ns);
+    addToNodeCounter(node.amountHeapAllocated, amountHeapAllocated);
+}
+
+void ContextTree::reset() noexcept
+{
+    enabled.store(false, std::memory_order_relaxed);
+    maxDepth.store(defaultMaxDepth, std::memory_order_relaxed);
+    
+    MallocHooks::ScopedBypassMallocHooks bypassMallocHooks;
+    
+    auto* tree = trees.exchange(nullptr, std::memory_order_acq_rel);
+    generation.fetch_add(1, std::memory_order_acq_rel);
+    
+    while (tree != nullptr)
+    {
+        auto* nextTree = tree->next;
+        delete tree;
+        tree = nextTree;
+    }
+}
+
+} // namespace qiti
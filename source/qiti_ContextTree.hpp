@@ -0,0 +1,141 @@
+/******************************************************************************
+ * Qiti — C++ Profiling Library
+ *
+ * @file     qiti_ContextTree.hpp
+ *
+ * @author   Adam Shield
+ * @date     2026-10-16
+ *
+ * @copyright (c) 2025 Adam Shield
+ * SPDX-License-Identifier: MIT
+ *
+ * See LICENSE.txt for license terms.
+ ******************************************************************************/
+
+#pragma once
+
+#include "qiti_API.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+//--------------------------------------------------------------------------
+// Doxygen - Begin Internal Documentation
+/** \cond INTERNAL */
+//--------------------------------------------------------------------------
+
+namespace qiti
+{
+class FunctionData;
+
+//--------------------------------------------------------------------------
+/**
+ Calling-context tree of one thread (or of one DeferredEvents ring being replayed).
+ 
+ Every node is a call path from the thread's entry point: the same function called from
+ two different callers gets two nodes. Built by the hooks from the shadow call stack
+ (FunctionData::Impl::CallStack), which remembers the node of every call in progress.
+ 
+ Nodes are allocated from fixed-size chunks (node pooling) and never freed until reset(),
+ so node pointers stay valid. Memory is bounded by maxDepth and maxNodesPerThread: calls
+ deeper than that (or once the pool is exhausted) get no node, and their time stays in
+ their ancestor's self time.
+ 
+ Single writer. Other threads may read through relaxed atomics at any time, see forEachTree().
+ 
+ @note This class is designed for internal use by the Qiti profiling system.
+ */
+class ContextTree
+{
+public:
+    struct Node
+    {
+        const FunctionData* function = nullptr; // nullptr for the root
+        uint32_t depth = 0;
+        
+        std::atomic<uint64_t> numCalls{0};
+        std::atomic<uint64_t> inclusiveTicksWallClock{0}; // see Clock
+        std::atomic<uint64_t> selfTicksWallClock{0};
+        std::atomic<uint64_t> inclusiveTimeCpu_ns{0};
+        std::atomic<uint64_t> selfTimeCpu_ns{0};
+        std::atomic<uint64_t> amountHeapAllocated{0};
+        
+        std::atomic<Node*> firstChild{nullptr};
+        Node* nextSibling = nullptr;
+    };
+    
+    static constexpr size_t nodesPerChunk = 1024;
+    static constexpr size_t maxNodesPerThread = 16 * nodesPerChunk;
+    
+    /** Whether the hooks build calling-context trees, false by default. */
+    QITI_API_VAR static std::atomic<bool> enabled;
+    
+    /** Deepest call path (number of nested profiled calls) that gets its own node. */
+    QITI_API_VAR static std::atomic<uint32_t> maxDepth;
+    
+    static constexpr uint32_t defaultMaxDepth = 64;
+    
+    /**
+     Writer only: the tree cached by a call stack, created (and cached) on first use or
+     when the cached one was freed by reset().
+     */
+    [[nodiscard]] QITI_API_INTERNAL static ContextTree& getTree(ContextTree*& cachedTree, uint64_t& cachedGeneration) noexcept;
+    
+    /**
+     A tree that forEachTree() never visits, e.g. for Profile::calibrateOverhead()'s calls.
+     Cache it like getTree() would, and delete it when done.
+     */
+    [[nodiscard]] QITI_API_INTERNAL static std::unique_ptr<ContextTree> createUnlistedTree(uint64_t& cachedGeneration) noexcept;
+    
+    [[nodiscard]] Node* getRoot() noexcept { return &rootNode; }
+    
+    /** Writer only: the child of parent for function, created on first use. nullptr if beyond the limits. */
+    [[nodiscard]] QITI_API_INTERNAL Node* getChild(Node& parent, const FunctionData* function) noexcept;
+    
+    /** Writer only: adds a completed call to its node. */
+    QITI_API_INTERNAL static void record(Node& node,
+                                         uint64_t inclusiveTicksWallClock,
+                                         uint64_t selfTicksWallClock,
+                                         uint64_t inclusiveTimeCpu_ns,
+                                         uint64_t selfTimeCpu_ns,
+                                         uint64_t amountHeapAllocated) noexcept;
+    
+    /** Calls visitor with the root of every thread's tree. Safe to call while the trees are being written. */
+    template <typename Visitor>
+    static void forEachTree(Visitor&& visitor) noexcept
+    {
+        for (auto* tree = trees.load(std::memory_order_acquire); tree != nullptr; tree = tree->next)
+            visitor(static_cast<const Node&>(tree->rootNode));
+    }
+    
+    /**
+     Frees all trees and disables building them.
+     
+     Must not be called while other threads may still be inside an instrumentation hook.
+     */
+    QITI_API_INTERNAL static void reset() noexcept;
+    
+private:
+    Node rootNode{};
+    
+    /** Pool of nodes, writer only. */
+    std::vector<std::unique_ptr<Node[]>> chunks;
+    size_t numNodesUsedInLastChunk = nodesPerChunk;
+    
+    /** Next tree (intrusive, push-front list of all trees). */
+    ContextTree* next = nullptr;
+    
+    QITI_API_VAR static std::atomic<ContextTree*> trees;
+    
+    /** Incremented whenever the trees are freed, so call stacks know their cached tree is gone. */
+    QITI_API_VAR static std::atomic<uint64_t> generation;
+}; // class ContextTree
+} // namespace qiti
+
+//--------------------------------------------------------------------------
+/** \endcond */
+// Doxygen - End Internal Documentation
+//--------------------------------------------------------------------------
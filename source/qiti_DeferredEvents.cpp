@@ -0,0 +1,362 @@
+
+/******************************************************************************
+ * Qiti — C++ Profiling Library
+ *
+ * @file     qiti_DeferredEvents.cpp
+ *
+ * @author   Adam Shield
+ * @date     2026-10-16
+ *
+ * @copyright (c) 2025 Adam Shield
+ * SPDX-License-Identifier: MIT
+ *
+ * See LICENSE.txt for license terms.
+ ******************************************************************************/
+
+#include "qiti_DeferredEvents.hpp"
+
+#include "qiti_Clock.hpp"
+#include "qiti_FunctionCallData_Impl.hpp"
+#include "qiti_FunctionData_Impl.hpp"
+#include "qiti_FunctionDataUtils.hpp"
+#include "qiti_LockHooks.hpp"
+#include "qiti_MallocHooks.hpp"
+#include "qiti_Profile.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+//--------------------------------------------------------------------------
+
+using MutexType = std::mutex;
+using LockType = std::scoped_lock<MutexType>;
+
+using Record = qiti::DeferredEvents::Record;
+using ThreadShard = qiti::FunctionData::Impl::ThreadShard;
+
+namespace
+{
+/**
+ Records of one profiled thread.
+
+ Single producer (the owning thread) and single consumer (whichever thread holds
+ g_drainLock), so head and tail each only ever have one writer.
+ */
+struct Ring
+{
+    static constexpr size_t capacity = 4096; // must be a power of 2
+    static constexpr size_t mask = capacity - 1;
+
+    explicit Ring(std::thread::id owningThread) noexcept
+    : threadId(owningThread)
+    {
+        callStack.isReplayed = true;
+    }
+
+    const std::thread::id threadId;
+
+    alignas(64) std::atomic<size_t> head{0}; // next record to write (producer)
+    alignas(64) std::atomic<size_t> tail{0}; // next record to read (consumer)
+
+    std::array<Record, capacity> records;
+
+    // Consumer-only state, replaying the calls of the owning thread
+    qiti::FunctionData::Impl::CallStack callStack;
+    std::unordered_map<const void*, ThreadShard*> shards;
+
+    /** Next ring (intrusive, push-front list of all rings). */
+    Ring* next = nullptr;
+};
+
+constinit MutexType g_drainLock;
+
+/** All rings, only freed by DeferredEvents::reset(). */
+std::atomic<Ring*> g_rings{nullptr};
+
+/** Incremented whenever the rings are freed, so threads know their cached ring is gone. */
+std::atomic<uint64_t> g_ringsGeneration{0};
+
+/** Trivially destructible, so the hot path never registers a TLS destructor. */
+struct ThreadRingCache
+{
+    uint64_t generation = 0;
+    Ring* ring = nullptr;
+};
+constinit thread_local ThreadRingCache g_threadRing{};
+} // namespace
+
+//--------------------------------------------------------------------------
+
+[[nodiscard]] QITI_API_INTERNAL static Ring& getThreadRing() noexcept
+{
+    auto& cache = g_threadRing;
+    const auto generation = g_ringsGeneration.load(std::memory_order_acquire);
+    if (cache.ring != nullptr && cache.generation == generation) [[likely]]
+        return *cache.ring;
+
+    // First record of this thread (since the last reset)
+    qiti::MallocHooks::ScopedBypassMallocHooks bypassMallocHooks;
+
+    auto* ring = new Ring(std::this_thread::get_id());
+    ring->next = g_rings.load(std::memory_order_relaxed);
+    while (! g_rings.compare_exchange_weak(ring->next, ring,
+                                           std::memory_order_release,
+                                           std::memory_order_relaxed))
+    {
+    }
+
+    cache.generation = generation;
+    cache.ring = ring;
+    return *ring;
+}
+
+/** Consumer side, the caller must hold g_drainLock. */
+[[nodiscard]] QITI_API_INTERNAL static ThreadShard* getReplayShard(Ring& ring, const void* functionAddress) noexcept
+{
+    auto& shard = ring.shards[functionAddress];
+    if (shard == nullptr)
+    {
+        auto& functionData = qiti::DeferredEvents::getFunctionData(functionAddress);
+        shard = functionData.getImpl()->addThreadShard(&functionData, ring.threadId);
+    }
+    return shard;
+}
+
+/** Consumer side, the caller must hold g_drainLock. */
+QITI_API_INTERNAL static void replay(Ring& ring, const Record& record) noexcept
+{
+    switch (record.type)
+    {
+        case Record::Type::functionEnter:
+        {
+            auto* frame = getReplayShard(ring, record.address)->beginCall(ring.callStack);
+            if (frame == nullptr)
+                break; // not sampled
+
+            frame->numHeapAllocationsBeforeFunctionCall = record.numHeapAllocations;
+            frame->amountHeapAllocatedBeforeFunctionCall = record.amountHeapAllocated;
+            frame->startTicksWallClock = record.ticksWallClock;
+            frame->startTimeCpu_ns = record.timeCpu_ns;
+            break;
+        }
+        case Record::Type::functionExit:
+        {
+            auto* shard = getReplayShard(ring, record.address);
+
+            // Ignore calls that were entered before deferred aggregation was enabled
+            const auto* frame = ring.callStack.top();
+            if (ring.callStack.empty() || (frame != nullptr && frame->shard != shard))
+                break;
+
+            if (frame == nullptr || ! frame->isSampled)
+            {
+                shard->endUnsampledCall(ring.callStack);
+                break;
+            }
+
+            shard->endCall(ring.callStack,
+                           record.ticksWallClock,
+                           record.timeCpu_ns,
+                           record.numHeapAllocations,
+                           record.amountHeapAllocated,
+                           nullptr, // records don't carry PerfCounters
+                           nullptr); // nor ResourceUsageCounters
+            break;
+        }
+        case Record::Type::exceptionThrown:
+        {
+            ThreadShard::exceptionThrown(ring.callStack);
+            break;
+        }
+    }
+}
+
+/** Consumer side, the caller must hold g_drainLock. */
+QITI_API_INTERNAL static void drainRing(Ring& ring) noexcept
+{
+    const auto head = ring.head.load(std::memory_order_acquire);
+    auto tail = ring.tail.load(std::memory_order_relaxed);
+
+    for (; tail != head; ++tail)
+        replay(ring, ring.records[tail & Ring::mask]);
+
+    ring.tail.store(tail, std::memory_order_release);
+}
+
+/** Producer side: @returns the next free record of the calling thread's ring, to be published with publishRecord(). */
+[[nodiscard]] QITI_API_INTERNAL static Record& reserveRecord(Ring& ring) noexcept
+{
+    const auto head = ring.head.load(std::memory_order_relaxed);
+    if (head - ring.tail.load(std::memory_order_acquire) == Ring::capacity) [[unlikely]]
+    {
+        // Full: become the consumer of our own ring rather than dropping records
+        qiti::MallocHooks::ScopedBypassMallocHooks bypassMallocHooks;
+        qiti::LockHooks::LockBypassingHook<LockType, MutexType> lock(g_drainLock);
+        drainRing(ring);
+    }
+    return ring.records[head & Ring::mask];
+}
+
+QITI_API_INTERNAL static void publishRecord(Ring& ring) noexcept
+{
+    ring.head.store(ring.head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+//--------------------------------------------------------------------------
+
+namespace qiti
+{
+
+std::atomic<bool> DeferredEvents::enabled{false};
+
+void DeferredEvents::setEnabled(bool shouldEnable) noexcept
+{
+    if (! shouldEnable)
+        drain();
+
+    enabled.store(shouldEnable, std::memory_order_relaxed);
+}
+
+void DeferredEvents::pushFunctionEnter(const void* functionAddress) noexcept
+{
+    auto& ring = getThreadRing();
+    auto& record = reserveRecord(ring);
+
+    record.address = functionAddress;
+    record.type = Record::Type::functionEnter;
+    record.numHeapAllocations = MallocHooks::getNumHeapAllocationsOnCurrentThread();
+    record.amountHeapAllocated = MallocHooks::getTotalAmountHeapAllocatedOnCurrentThread();
+
+    // Grab starting times last without doing additional work after (publishing is a single store)
+    record.ticksWallClock = Clock::startTimestamp();
+    record.timeCpu_ns = Clock::threadCpuTime_ns();
+
+    publishRecord(ring);
+}
+
+void DeferredEvents::pushFunctionExit(const void* functionAddress) noexcept
+{
+    // Get end times immediately before doing any other work
+    const auto cpuEndTime_ns = Clock::threadCpuTime_ns();
+    const auto clockEndTicks = Clock::endTimestamp();
+
+    auto& ring = getThreadRing();
+    auto& record = reserveRecord(ring);
+
+    record.address = functionAddress;
+    record.type = Record::Type::functionExit;
+    record.ticksWallClock = clockEndTicks;
+    record.timeCpu_ns = cpuEndTime_ns;
+    record.numHeapAllocations = MallocHooks::getNumHeapAllocationsOnCurrentThread();
+    record.amountHeapAllocated = MallocHooks::getTotalAmountHeapAllocatedOnCurrentThread();
+
+    publishRecord(ring);
+}
+
+void DeferredEvents::pushExceptionThrown() noexcept
+{
+    auto& ring = getThreadRing();
+    auto& record = reserveRecord(ring);
+
+    record = {};
+    record.type = Record::Type::exceptionThrown;
+
+    publishRecord(ring);
+}
+
+DeferredEvents::Overhead DeferredEvents::measureOverhead(uint32_t numNestedCalls) noexcept
+{
+    assert(numNestedCalls > 0 && numNestedCalls * 2 <= Ring::capacity);
+    
+    // Stand-in for the nested function, its records never get replayed
+    static const char innerFunction = 0;
+    
+    // Replay what is pending first, so discarding the calibration records loses nothing
+    drain();
+    
+    MallocHooks::ScopedBypassMallocHooks bypassMallocHooks;
+    LockHooks::LockBypassingHook<LockType, MutexType> lock(g_drainLock); // no other thread may replay them
+    
+    auto& ring = getThreadRing();
+    const auto firstRecord = ring.head.load(std::memory_order_relaxed);
+    
+    // Timestamps taken where the hooks of a replayed outer call take theirs
+    const auto outerStartTicks = Clock::startTimestamp();
+    const auto outerStartTimeCpu_ns = Clock::threadCpuTime_ns();
+    for (uint32_t i = 0; i < numNestedCalls; ++i)
+    {
+        pushFunctionEnter(&innerFunction);
+        pushFunctionExit(&innerFunction);
+    }
+    const auto outerEndTimeCpu_ns = Clock::threadCpuTime_ns();
+    const auto outerEndTicks = Clock::endTimestamp();
+    
+    // What replaying the nested calls would measure
+    uint64_t innerTicks = 0;
+    uint64_t innerCpu = 0;
+    const auto lastRecord = ring.head.load(std::memory_order_relaxed);
+    for (auto index = firstRecord; index != lastRecord; index += 2)
+    {
+        const auto& enter = ring.records[index & Ring::mask];
+        const auto& exit = ring.records[(index + 1) & Ring::mask];
+        innerTicks += exit.ticksWallClock - enter.ticksWallClock;
+        innerCpu += exit.timeCpu_ns - enter.timeCpu_ns;
+    }
+    ring.tail.store(lastRecord, std::memory_order_release);
+    
+    // What the outer call measured beyond its nested calls is the overhead of their pushes
+    const auto outerTicks = outerEndTicks - outerStartTicks;
+    const auto outerCpu = outerEndTimeCpu_ns - outerStartTimeCpu_ns;
+    
+    Overhead overhead;
+    overhead.ticksWallClockPerNestedCall = (outerTicks - std::min(innerTicks, outerTicks)) / numNestedCalls;
+    overhead.nanosecondsCpuPerNestedCall = (outerCpu - std::min(innerCpu, outerCpu)) / numNestedCalls;
+    overhead.emptyCallTicksWallClock = innerTicks / numNestedCalls;
+    overhead.emptyCallNanosecondsCpu = innerCpu / numNestedCalls;
+    return overhead;
+}
+
+FunctionData& DeferredEvents::getFunctionData(const void* functionAddress) noexcept
+{
+    return FunctionDataUtils::getFunctionDataFromAddress(functionAddress);
+}
+
+void DeferredEvents::drain() noexcept
+{
+    if (g_rings.load(std::memory_order_acquire) == nullptr)
+        return; // nothing was ever deferred
+
+    Profile::ScopedDisableProfiling disableProfiling;
+    MallocHooks::ScopedBypassMallocHooks bypassMallocHooks;
+    LockHooks::LockBypassingHook<LockType, MutexType> lock(g_drainLock);
+
+    for (auto* ring = g_rings.load(std::memory_order_acquire); ring != nullptr; ring = ring->next)
+        drainRing(*ring);
+}
+
+void DeferredEvents::reset() noexcept
+{
+    enabled.store(false, std::memory_order_relaxed);
+
+    MallocHooks::ScopedBypassMallocHooks bypassMallocHooks;
+    LockHooks::LockBypassingHook<LockType, MutexType> lock(g_drainLock);
+
+    auto* ring = g_rings.exchange(nullptr, std::memory_order_acq_rel);
+    g_ringsGeneration.fetch_add(1, std::memory_order_acq_rel);
+
+    while (ring != nullptr)
+    {
+        auto* next = ring->next;
+        delete ring;
+        ring = next;
+    }
+}
+
+} // namespace qiti
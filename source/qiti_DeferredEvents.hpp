@@ -0,0 +1,130 @@
+/******************************************************************************
+ * Qiti — C++ Profiling Library
+ *
+ * @file     qiti_DeferredEvents.hpp
+ *
+ * @author   Adam Shield
+ * @date     2026-10-16
+ *
+ * @copyright (c) 2025 Adam Shield
+ * SPDX-License-Identifier: MIT
+ *
+ * See LICENSE.txt for license terms.
+ ******************************************************************************/
+
+#pragma once
+
+#include "qiti_API.hpp"
+
+#include <atomic>
+#include <cstdint>
+
+//--------------------------------------------------------------------------
+// Doxygen - Begin Internal Documentation
+/** \cond INTERNAL */
+//--------------------------------------------------------------------------
+
+namespace qiti
+{
+class FunctionData;
+
+//--------------------------------------------------------------------------
+/**
+ Deferred aggregation of profiled function calls.
+
+ By default the instrumentation hooks aggregate every call inline (see
+ FunctionData::Impl::ThreadShard). While deferred aggregation is enabled, the hooks
+ instead only append a compact Record (address, timestamps, heap allocation counters)
+ to a per-thread single-producer/single-consumer ring buffer, which is a handful of
+ stores on the profiled thread.
+
+ The records are folded into FunctionData later, by whichever thread calls drain():
+ - the FunctionData/FunctionDataUtils getters, before reading any data (lazy drain)
+ - a profiled thread whose ring is full (drains its own ring, so no record is lost)
+
+ Draining is serialized by a single lock, the rings themselves are lock-free.
+
+ @note This class is designed for internal use by the Qiti profiling system.
+ */
+class DeferredEvents
+{
+public:
+    /** One enter/exit/throw event of a profiled function, as sampled by the hooks. */
+    struct Record
+    {
+        enum class Type : uint8_t
+        {
+            functionEnter,
+            functionExit,
+            exceptionThrown
+        };
+
+        const void* address;
+        uint64_t ticksWallClock;       // see Clock
+        uint64_t timeCpu_ns;
+        uint64_t amountHeapAllocated;  // counters of the profiled thread
+        uint32_t numHeapAllocations;
+        Type type;
+    };
+
+    [[nodiscard]] QITI_API_INLINE static inline bool isEnabled() noexcept
+    {
+        return enabled.load(std::memory_order_relaxed);
+    }
+
+    /**
+     Enables/disables deferred aggregation.
+     Disabling drains all pending records first, so no data is lost.
+     */
+    QITI_API static void setEnabled(bool shouldEnable) noexcept;
+
+    /** Hot path: samples the function entry and appends it to the calling thread's ring. */
+    QITI_API_INTERNAL static void pushFunctionEnter(const void* functionAddress) noexcept;
+
+    /** Hot path: samples the function exit and appends it to the calling thread's ring. */
+    QITI_API_INTERNAL static void pushFunctionExit(const void* functionAddress) noexcept;
+
+    /** Attributes a thrown exception to the innermost profiled call on the calling thread. */
+    QITI_API_INTERNAL static void pushExceptionThrown() noexcept;
+
+    /** Time the hooks add while deferred aggregation is enabled, see Profile::calibrateOverhead(). */
+    struct Overhead
+    {
+        uint64_t ticksWallClockPerNestedCall = 0;
+        uint64_t nanosecondsCpuPerNestedCall = 0;
+        uint64_t emptyCallTicksWallClock = 0;
+        uint64_t emptyCallNanosecondsCpu = 0;
+    };
+
+    /**
+     Times numNestedCalls empty calls recorded on the calling thread's ring, nested in one outer call.
+     Their records are discarded rather than replayed, so no FunctionData sees them.
+     */
+    [[nodiscard]] QITI_API_INTERNAL static Overhead measureOverhead(uint32_t numNestedCalls) noexcept;
+
+    /** Folds all pending records of all threads into their FunctionData. Safe to call from any thread. */
+    QITI_API static void drain() noexcept;
+
+    /**
+     Discards all pending records, frees all rings and disables deferred aggregation.
+
+     Must not be called while other threads may still be inside an instrumentation hook.
+     */
+    QITI_API_INTERNAL static void reset() noexcept;
+
+    /** Consumer side: the FunctionData of a recorded function address, created on first use. */
+    [[nodiscard]] QITI_API_INTERNAL static FunctionData& getFunctionData(const void* functionAddress) noexcept;
+
+    // Deleted constructors/destructors
+    DeferredEvents() = delete;
+    ~DeferredEvents() = delete;
+
+private:
+    QITI_API_VAR static std::atomic<bool> enabled;
+}; // class DeferredEvents
+} // namespace qiti
+
+//--------------------------------------------------------------------------
+/** \endcond */
+// Doxygen - End Internal Documentation
+//--------------------------------------------------------------------------
@@ -12,10 +12,12 @@
  * See LICENSE.txt for license terms.
  ******************************************************************************/
 
+#include "qiti_DeferredEvents.hpp"
 #include "qiti_FunctionCallData.hpp"
 #include "qiti_FunctionCallData_Impl.hpp"
 #include "qiti_FunctionData.hpp"
 #include "qiti_FunctionData_Impl.hpp"
+#include "qiti_MallocHooks.hpp"
 #include "qiti_Profile.hpp"
 #include "qiti_ScopedNoHeapAllocations.hpp"
 
@@ -97,18 +99,14 @@ QITI_API void __cxa_throw(void* thrown_object,
     initializeExceptionHooks();
     
     // Record that the current function threw an exception
-    if (! qiti::g_callStack.empty())
+    if (qiti::DeferredEvents::isEnabled())
     {
-        auto* currentFunc = qiti::g_callStack.top();
-        if (currentFunc)
-        {
-            auto* impl = currentFunc->getImpl();
-            impl->numExceptionsThrown++;
-            
-            // Also mark the current call as having thrown an exception
-            auto* callImpl = impl->lastCallData.getImpl();
-            callImpl->numExceptionsThrown++;
-        }
+        qiti::MallocHooks::ScopedBypassMallocHooks bypassMallocHooks; // first record of a thread allocates its ring
+        qiti::DeferredEvents::pushExceptionThrown();
+    }
+    else if (auto* callStack = qiti::g_callStack) // nullptr until this thread profiled a call
+    {
+        qiti::FunctionData::Impl::ThreadShard::exceptionThrown(*callStack);
     }
     
     // Call the original __cxa_throw to maintain normal exception behavior
@@ -0,0 +1,246 @@
+
+/******************************************************************************
+ * Qiti — C++ Profiling Library
+ *
+ * @file     qiti_Export.cpp
+ *
+ * @author   Adam Shield
+ * @date     2026-10-16
+ *
+ * @copyright (c) 2025 Adam Shield
+ * SPDX-License-Identifier: MIT
+ *
+ * See LICENSE.txt for license terms.
+ ******************************************************************************/
+
+#include "qiti_Export.hpp"
+
+#include "qiti_CallingContextTree.hpp"
+#include "qiti_Clock.hpp"
+#include "qiti_DeferredEvents.hpp"
+#include "qiti_FunctionData.hpp"
+#include "qiti_MallocHooks.hpp"
+#include "qiti_Profile.hpp"
+#include "qiti_Timeline.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <ostream>
+#include <vector>
+
+//--------------------------------------------------------------------------
+
+using Metric = qiti::Export::Metric;
+using Node = qiti::CallingContextTree::Node;
+
+[[nodiscard]] QITI_API_INTERNAL static uint64_t getFoldedValue(const Node& node, Metric metric) noexcept
+{
+    switch (metric)
+    {
+        case Metric::selfTimeWallClock_ns: return node.selfTimeWallClock_ns;
+        case Metric::selfTimeCpu_ns:       return node.selfTimeCpu_ns;
+        case Metric::numCalls:             return node.numCalls;
+        case Metric::amountHeapAllocated:
+        {
+            // Nodes count the bytes of their callees as well, flame graphs add them up again
+            uint64_t amountHeapAllocatedByChildren = 0;
+            for (const auto& child : node.children)
+                amountHeapAllocatedByChildren += child.amountHeapAllocated;
+            return (node.amountHeapAllocated > amountHeapAllocatedByChildren)
+                   ? node.amountHeapAllocated - amountHeapAllocatedByChildren
+                   : 0;
+        }
+    }
+    return 0;
+}
+
+/** ';' separates frames, so it must not appear in a name (e.g. from a demangled template argument). */
+QITI_API_INTERNAL static void writeFrameName(std::ostream& stream, const char* name) noexcept
+{
+    for (const char* c = name; *c != '\0'; ++c)
+        stream.put((*c == ';') ? ':' : *c);
+}
+
+QITI_API_INTERNAL static void writeFoldedNode(std::ostream& stream,
+                                              const Node& node,
+                                              std::vector<const char*>& path,
+                                              Metric metric) noexcept
+{
+    path.push_back(node.function->getFunctionName());
+    
+    if (const auto value = getFoldedValue(node, metric); value > 0)
+    {
+        for (size_t i = 0; i < path.size(); ++i)
+        {
+            if (i > 0)
+                stream.put(';');
+            writeFrameName(stream, path[i]);
+        }
+        stream << ' ' << value << '\n';
+    }
+    
+    for (const auto& child : node.children)
+        writeFoldedNode(stream, child, path, metric);
+    
+    path.pop_back();
+}
+
+/** Writes a JSON string (with quotes), escaping what JSON requires. */
+QITI_API_INTERNAL static void writeJsonString(std::ostream& stream, const char* text) noexcept
+{
+    static constexpr char hexDigits[] = "0123456789abcdef";
+    
+    stream.put('"');
+    for (const char* c = text; *c != '\0'; ++c)
+    {
+        const auto byte = static_cast<unsigned char>(*c);
+        if (byte == '"' || byte == '\\')
+        {
+            stream.put('\\');
+            stream.put(*c);
+        }
+        else if (byte < 0x20)
+        {
+            stream << "\\u00" << hexDigits[byte >> 4] << hexDigits[byte & 0xF];
+        }
+        else
+        {
+            stream.put(*c);
+        }
+    }
+    stream.put('"');
+}
+
+/** Trace Event timestamps are in microseconds, written with nanosecond precision. */
+QITI_API_INTERNAL static void writeMicroseconds(std::ostream& stream, uint64_t nanoseconds) noexcept
+{
+    const auto fraction = nanoseconds % 1000;
+    stream << (nanoseconds / 1000) << '.'
+           << static_cast<char>('0' + fraction / 100)
+           << static_cast<char>('0' + (fraction / 10) % 10)
+           << static_cast<char>('0' + fraction % 10);
+}
+
+/** Writes the metadata, call and heap counter events of one thread. */
+QITI_API_INTERNAL static void writeTimelineBuffer(std::ostream& stream,
+                                                  const qiti::Timeline::Buffer& buffer,
+                                                  uint64_t originTicks,
+                                                  bool& isFirstEvent) noexcept
+{
+    const auto tid = buffer.threadIndex;
+    const auto separator = [&stream, &isFirstEvent]
+    {
+        stream << (isFirstEvent ? "\n" : ",\n");
+        isFirstEvent = false;
+    };
+    
+    separator();
+    stream << R"({"name":"thread_name","ph":"M","pid":1,"tid":)" << tid
+           << R"(,"args":{"name":"Thread )" << tid << R"("}})";
+    
+    uint64_t lastAmountHeapAllocated = 0;
+    buffer.forEachEvent([&](const qiti::Timeline::Event& event)
+    {
+        // Calls that started before the timeline was enabled are clipped to its start
+        const auto start_ns = qiti::Clock::ticksToNanoseconds(event.startTicksWallClock - std::min(event.startTicksWallClock, originTicks));
+        const auto end_ns = qiti::Clock::ticksToNanoseconds(event.endTicksWallClock - std::min(event.endTicksWallClock, originTicks));
+        
+        separator();
+        stream << "{\"name\":";
+        writeJsonString(stream, event.function->getFunctionName());
+        stream << R"(,"cat":"qiti","ph":"X","pid":1,"tid":)" << tid << R"(,"ts":)";
+        writeMicroseconds(stream, start_ns);
+        stream << R"(,"dur":)";
+        writeMicroseconds(stream, end_ns - std::min(start_ns, end_ns));
+        stream << '}';
+        
+        if (event.amountHeapAllocated != lastAmountHeapAllocated)
+        {
+            lastAmountHeapAllocated = event.amountHeapAllocated;
+            
+            separator();
+            stream << R"({"name":"Heap allocated (Thread )" << tid << ")\",\"ph\":\"C\",\"pid\":1,\"tid\":" << tid << R"(,"ts":)";
+            writeMicroseconds(stream, end_ns);
+            stream << R"(,"args":{"bytes":)" << event.amountHeapAllocated << "}}";
+        }
+    });
+}
+
+//--------------------------------------------------------------------------
+
+namespace qiti
+{
+
+bool Export::writeFoldedStacks(const char* path, Metric metric) noexcept
+{
+    Profile::ScopedDisableProfiling disableProfiling;
+    MallocHooks::ScopedBypassMallocHooks bypassMallocHooks;
+    
+    if (path == nullptr)
+        return false;
+    
+    std::ofstream file(path);
+    if (! file)
+        return false;
+    
+    writeFoldedStacks(file, metric);
+    file.flush();
+    return file.good();
+}
+
+void Export::writeFoldedStacks(std::ostream& stream, Metric metric) noexcept
+{
+    Profile::ScopedDisableProfiling disableProfiling;
+    MallocHooks::ScopedBypassMallocHooks bypassMallocHooks;
+    
+    const auto root = CallingContextTree::getMergedTree();
+    
+    std::vector<const char*> path;
+    for (const auto& child : root.children)
+        writeFoldedNode(stream, child, path, metric);
+}
+
+bool Export::writeChromeTrace(const char* path) noexcept
+{
+    Profile::ScopedDisableProfiling disableProfiling;
+    MallocHooks::ScopedBypassMallocHooks bypassMallocHooks;
+    
+    if (path == nullptr)
+        return false;
+    
+    std::ofstream file(path);
+    if (! file)
+        return false;
+    
+    writeChromeTrace(file);
+    file.flush();
+    return file.good();
+}
+
+void Export::writeChromeTrace(std::ostream& stream) noexcept
+{
+    Profile::ScopedDisableProfiling disableProfiling;
+    MallocHooks::ScopedBypassMallocHooks bypassMallocHooks;
+    
+    DeferredEvents::drain(); // fold in calls that were only recorded so far
+    
+    // Threads in the order they first called a profiled function
+    std::vector<const Timeline::Buffer*> buffers;
+    Timeline::forEachBuffer([&buffers](const Timeline::Buffer& buffer) { buffers.push_back(&buffer); });
+    std::ranges::sort(buffers, {}, &Timeline::Buffer::threadIndex);
+    
+    const auto originTicks = Timeline::getOriginTicks();
+    uint64_t numEventsDropped = 0;
+    bool isFirstEvent = true;
+    
+    stream << R"({"displayTimeUnit":"ns","traceEvents":[)";
+    for (const auto* buffer : buffers)
+    {
+        writeTimelineBuffer(stream, *buffer, originTicks, isFirstEvent);
+        numEventsDropped += buffer->getNumEventsDropped();
+    }
+    stream << "\n],\"otherData\":{\"qitiEventsDropped\":\"" << numEventsDropped << "\"}}\n";
+}
+
+} // namespace qiti
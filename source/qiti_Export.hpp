@@ -0,0 +1,97 @@
+/******************************************************************************
+ * Qiti — C++ Profiling Library
+ *
+ * @file     qiti_Export.hpp
+ *
+ * @author   Adam Shield
+ * @date     2026-10-16
+ *
+ * @copyright (c) 2025 Adam Shield
+ * SPDX-License-Identifier: MIT
+ *
+ * See LICENSE.txt for license terms.
+ ******************************************************************************/
+
+#pragma once
+
+#include "qiti_API.hpp"
+
+#include <iosfwd>
+
+//--------------------------------------------------------------------------
+
+namespace qiti
+{
+//--------------------------------------------------------------------------
+
+/**
+ Writes profiling data in formats understood by external visualization tools.
+ 
+ @code
+ TEST_CASE("Flame graph of a frame") {
+     qiti::ScopedQitiTest test;
+     test.enableProfilingOnAllFunctions(true);
+     test.enableCallingContextTree(true);
+     
+     renderFrame();
+     
+     qiti::Export::writeFoldedStacks("frame.folded", qiti::Export::Metric::selfTimeWallClock_ns);
+     // then: flamegraph.pl frame.folded > frame.svg
+ }
+ @endcode
+ */
+class Export
+{
+public:
+    /** The value attributed to each call path. */
+    enum class Metric
+    {
+        selfTimeWallClock_ns, ///< wall-clock time spent in the function itself
+        selfTimeCpu_ns,       ///< CPU time spent in the function itself
+        numCalls,             ///< number of (sampled) calls
+        amountHeapAllocated   ///< bytes allocated by the function itself
+    };
+    
+    /**
+     Writes the calling-context tree (see CallingContextTree) as folded stacks, the input format
+     of Brendan Gregg's flamegraph.pl and compatible tools (speedscope, inferno, ...).
+     
+     One line per call path: the function names from the outermost profiled call, separated by
+     ';', then a space and the value of metric. Call paths with a value of 0 are omitted.
+     Lines are streamed as the tree is walked.
+     
+     Requires ScopedQitiTest::enableCallingContextTree() before calling the profiled functions.
+     
+     @returns false if the file could not be written.
+     */
+    QITI_API static bool writeFoldedStacks(const char* path, Metric metric) noexcept;
+    
+    /** Writes folded stacks to a stream. @see writeFoldedStacks(const char*, Metric) */
+    QITI_API static void writeFoldedStacks(std::ostream& stream, Metric metric) noexcept;
+    
+    /**
+     Writes the timeline of profiled calls as Chrome Trace Event JSON, which loads in
+     chrome://tracing and the Perfetto UI (ui.perfetto.dev).
+     
+     Every completed call is a complete ("X") event on the track of the thread that made it,
+     so the ordering and overlap of calls across threads is visible. The bytes heap allocated
+     by each thread so far are added as a counter track per thread. Events are streamed, so
+     traces of millions of calls never need to fit in memory as text.
+     
+     Requires ScopedQitiTest::enableTimeline() before calling the profiled functions.
+     
+     @returns false if the file could not be written.
+     */
+    QITI_API static bool writeChromeTrace(const char* path) noexcept;
+    
+    /** Writes Chrome Trace Event JSON to a stream. @see writeChromeTrace(const char*) */
+    QITI_API static void writeChromeTrace(std::ostream& stream) noexcept;
+    
+    // Deleted constructors/destructors
+    Export() = delete;
+    ~Export() = delete;
+};
+
+//--------------------------------------------------------------------------
+} // namespace qiti
+//--------------------------------------------------------------------------
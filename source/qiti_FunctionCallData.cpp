@@ -15,6 +15,7 @@
 
 #include "qiti_FunctionCallData.hpp"
 
+#include "qiti_Clock.hpp"
 #include "qiti_FunctionCallData_Impl.hpp"
 #include "qiti_Profile.hpp"
 #include "qiti_ScopedNoHeapAllocations.hpp"
@@ -121,9 +122,7 @@ uint64_t QITI_API FunctionCallData::getTimeSpentInFunctionWallClock_ms() const n
     qiti::Profile::ScopedDisableProfiling disableProfiling;
     qiti::ScopedNoHeapAllocations noAlloc;
     
-    if (getImpl()->timeSpentInFunctionNanosecondsWallClock == 0)
-        return 0; // prevent dividing by 0
-    return getImpl()->timeSpentInFunctionNanosecondsWallClock / 1000000;
+    return Clock::ticksToNanoseconds(getImpl()->timeSpentInFunctionTicksWallClock) / 1000000;
 }
 
 uint64_t QITI_API FunctionCallData::getTimeSpentInFunctionWallClock_ns() const noexcept
@@ -131,7 +130,23 @@ uint64_t QITI_API FunctionCallData::getTimeSpentInFunctionWallClock_ns() const n
     qiti::Profile::ScopedDisableProfiling disableProfiling;
     qiti::ScopedNoHeapAllocations noAlloc;
     
-    return getImpl()->timeSpentInFunctionNanosecondsWallClock;
+    return Clock::ticksToNanoseconds(getImpl()->timeSpentInFunctionTicksWallClock);
+}
+
+uint64_t QITI_API FunctionCallData::getSelfTimeSpentInFunctionCpu_ns() const noexcept
+{
+    qiti::Profile::ScopedDisableProfiling disableProfiling;
+    qiti::ScopedNoHeapAllocations noAlloc;
+    
+    return getImpl()->selfTimeNanosecondsCpu;
+}
+
+uint64_t QITI_API FunctionCallData::getSelfTimeSpentInFunctionWallClock_ns() const noexcept
+{
+    qiti::Profile::ScopedDisableProfiling disableProfiling;
+    qiti::ScopedNoHeapAllocations noAlloc;
+    
+    return Clock::ticksToNanoseconds(getImpl()->selfTimeTicksWallClock);
 }
 
 std::thread::id QITI_API FunctionCallData::getThreadThatCalledFunction() const noexcept
@@ -166,4 +181,20 @@ uint64_t FunctionCallData::getNumExceptionsThrown() const noexcept
     return getImpl()->numExceptionsThrown;
 }
 
+uint64_t FunctionCallData::getPerfCounter(PerfCounter counter) const noexcept
+{
+    qiti::Profile::ScopedDisableProfiling disableProfiling;
+    qiti::ScopedNoHeapAllocations noAlloc;
+    
+    return getImpl()->perfCounters[static_cast<size_t>(counter)];
+}
+
+uint64_t FunctionCallData::getResourceUsage(ResourceUsage usage) const noexcept
+{
+    qiti::Profile::ScopedDisableProfiling disableProfiling;
+    qiti::ScopedNoHeapAllocations noAlloc;
+    
+    return getImpl()->resourceUsage[static_cast<size_t>(usage)];
+}
+
 } // namespace qiti
@@ -17,6 +17,7 @@
 
 #include "qiti_FunctionDataUtils.hpp"
 
+#include <cstdint>
 #include <memory>
 #include <thread>
 
@@ -24,6 +25,42 @@
 
 namespace qiti
 {
+//--------------------------------------------------------------------------
+/**
+ Performance counters that can be read for every profiled call,
+ see ScopedQitiTest::enablePerfCounters().
+ 
+ Instruction counts are far less noisy than times, and the ratio of instructions to cycles
+ (IPC) or the cache miss rate tell why a function is slow.
+ */
+enum class PerfCounter : uint8_t
+{
+    instructions,    ///< Instructions retired (hardware)
+    cycles,          ///< CPU cycles (hardware)
+    cacheMisses,     ///< Last level cache misses (hardware)
+    branchMisses,    ///< Mispredicted branches (hardware)
+    pageFaults,      ///< Page faults (software)
+    contextSwitches  ///< Context switches (software)
+};
+
+//--------------------------------------------------------------------------
+/**
+ Resource usage of the calling thread that can be read for every profiled call (getrusage()),
+ see ScopedQitiTest::enableResourceUsage().
+ 
+ Page faults of first-touched memory and involuntary context switches are common causes of
+ latency spikes that the time spent in a function alone cannot explain.
+ */
+enum class ResourceUsage : uint8_t
+{
+    minorPageFaults,            ///< Page faults served without I/O (e.g. first touch of memory)
+    majorPageFaults,            ///< Page faults that required I/O
+    voluntaryContextSwitches,   ///< The thread blocked (waited for a resource, slept...)
+    involuntaryContextSwitches, ///< The thread was preempted
+    blockInputOperations,       ///< Reads from the file system
+    blockOutputOperations       ///< Writes to the file system
+};
+
 //--------------------------------------------------------------------------
 /**
  Abtracts a specific call of a specific function
@@ -33,8 +70,9 @@ namespace qiti
  To obtain a FunctionCallData object, call FunctionData::getLastFunctionCall()
  on the FunctionData instance for the function you want to analyze.
  
- Note: Qiti currently only stores data for the most recent function call,
- not historical data for all previous calls.
+ Note: Qiti only stores data for the most recent function call by default.
+ Enable ScopedQitiTest::setCallHistoryCapacity() to retain recent calls,
+ see FunctionData::getCallHistory().
  */
 class FunctionCallData
 {
@@ -87,6 +125,40 @@ public:
      */
     [[nodiscard]] QITI_API uint64_t getTimeSpentInFunctionWallClock_ns() const noexcept;
     
+    /**
+     Returns the CPU time spent in this function call itself, in nanoseconds: getTimeSpentInFunctionCpu_ns()
+     minus the time spent in the profiled functions it called (exclusive or "self" time).
+     
+     Feature is not supported on Windows.
+     */
+#ifdef _WIN32
+    [[deprecated("Feature is not supported on Windows")]]
+#endif
+    [[nodiscard]] QITI_API uint64_t getSelfTimeSpentInFunctionCpu_ns() const noexcept;
+    
+    /**
+     Returns the wall-clock time spent in this function call itself, in nanoseconds: getTimeSpentInFunctionWallClock_ns()
+     minus the time spent in the profiled functions it called (exclusive or "self" time).
+     */
+    [[nodiscard]] QITI_API uint64_t getSelfTimeSpentInFunctionWallClock_ns() const noexcept;
+    
+    /**
+     Returns how much the given performance counter increased during this function call.
+     
+     Only counted while ScopedQitiTest::enablePerfCounters() is enabled, and only on Linux.
+     0 if the counter is not available (see ScopedQitiTest::isPerfCounterAvailable()),
+     and for the calls of FunctionData::getCallHistory(), which does not retain counters.
+     */
+    [[nodiscard]] QITI_API uint64_t getPerfCounter(PerfCounter counter) const noexcept;
+    
+    /**
+     Returns how much the given resource usage of the calling thread increased during this function call.
+     
+     Only counted while ScopedQitiTest::enableResourceUsage() is enabled, and only on Linux.
+     0 for the calls of FunctionData::getCallHistory(), which does not retain resource usage.
+     */
+    [[nodiscard]] QITI_API uint64_t getResourceUsage(ResourceUsage usage) const noexcept;
+    
     /** Get thread that was responsible for this function call. */
     [[nodiscard]] QITI_API std::thread::id getThreadThatCalledFunction() const noexcept;
     
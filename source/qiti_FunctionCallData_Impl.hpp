@@ -16,7 +16,9 @@
 
 #include "qiti_FunctionCallData.hpp"
 
-#include <time.h>
+#include "qiti_PerfCounters.hpp"
+#include "qiti_ResourceUsageCounters.hpp"
+
 #include <stdint.h>
 
 #include <chrono>
@@ -32,17 +34,21 @@ namespace qiti
 {
 struct FunctionCallData::Impl
 {
-    std::chrono::steady_clock::time_point startTimeWallClock;
-    std::chrono::steady_clock::time_point endTimeWallClock;
-    timespec                              startTimeCpu;
-    timespec                              endTimeCpu;
+    uint64_t startTicksWallClock = 0; // see Clock
+    uint64_t endTicksWallClock   = 0;
+    uint64_t startTimeCpu_ns = 0;
+    uint64_t endTimeCpu_ns   = 0;
     
     std::thread::id callingThread;
     const FunctionData* caller = nullptr;
     
-    uint64_t timeSpentInFunctionNanosecondsWallClock = 0;
+    uint64_t timeSpentInFunctionTicksWallClock = 0; // converted to nanoseconds by the getters
     uint64_t timeSpentInFunctionNanosecondsCpu = 0;
     
+    // Exclusive time: time spent in the function minus the time spent in the profiled functions it called
+    uint64_t selfTimeTicksWallClock = 0;
+    uint64_t selfTimeNanosecondsCpu = 0;
+    
     uint32_t numHeapAllocationsBeforeFunctionCall = 0;
     uint32_t numHeapAllocationsAfterFunctionCall  = 0;
     
@@ -50,6 +56,12 @@ struct FunctionCallData::Impl
     uint64_t amountHeapAllocatedAfterFunctionCall  = 0;
     
     uint64_t numExceptionsThrown = 0;
+    
+    // Increase of every PerfCounter during the call, 0 unless PerfCounters::enabled
+    PerfCounters::Values perfCounters{};
+    
+    // Increase of every ResourceUsage during the call, 0 unless ResourceUsageCounters::enabled
+    ResourceUsageCounters::Values resourceUsage{};
 };
 } // namespace qiti
 
@@ -15,6 +15,9 @@
 
 #include "qiti_FunctionData.hpp"
 
+#include "qiti_Clock.hpp"
+#include "qiti_DeferredEvents.hpp"
+#include "qiti_FunctionCallData_Impl.hpp"
 #include "qiti_FunctionData_Impl.hpp"
 #include "qiti_MallocHooks.hpp"
 #include "qiti_Profile.hpp"
@@ -27,54 +30,693 @@
 #include <dlfcn.h>
 #endif
 
+#include <algorithm>
 #include <array>
+#include <atomic>
 #include <cassert>
+#include <cmath>
 #include <cstdint>
 #include <cstring>
+#include <limits>
+#include <memory>
 #include <mutex>
 #include <utility>
 #include <thread>
+#include <type_traits>
+#include <unordered_set>
 #include <vector>
 
 //--------------------------------------------------------------------------
 
-static constexpr size_t MAX_THREADS = qiti::FunctionData::Impl::MAX_THREADS;
-static constexpr size_t THREAD_ID_NOT_FOUND   = MAX_THREADS;
+/** Per-thread xorshift64 state for random sampling, seeded on first use. */
+static constinit thread_local uint64_t g_samplingRandomState = 0;
 
-// global array + counter for id→small-index mapping
-static std::atomic<size_t>                  g_nextThreadIndex{0};
-static std::array<std::thread::id, MAX_THREADS> g_threadIds;
+[[nodiscard]] QITI_API_INTERNAL static uint32_t nextSamplingRandom() noexcept
+{
+    auto state = g_samplingRandomState;
+    if (state == 0) [[unlikely]]
+        state = reinterpret_cast<uintptr_t>(&g_samplingRandomState) ^ 0x9E3779B97F4A7C15ull; // differs per thread
+    
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    g_samplingRandomState = state;
+    return static_cast<uint32_t>(state >> 32);
+}
+
+//--------------------------------------------------------------------------
+
+namespace qiti
+{
+
+std::atomic<FunctionData::Impl::SamplingRate> FunctionData::Impl::defaultSamplingRate{SamplingRate::everyNthCall(1)};
+std::atomic<uint64_t> FunctionData::Impl::overheadTicksWallClockPerNestedCall{0};
+std::atomic<uint64_t> FunctionData::Impl::overheadNanosecondsCpuPerNestedCall{0};
+std::atomic<uint64_t> FunctionData::Impl::overheadTicksWallClockPerUnsampledNestedCall{0};
+std::atomic<uint64_t> FunctionData::Impl::overheadNanosecondsCpuPerUnsampledNestedCall{0};
+std::atomic<uint64_t> FunctionData::Impl::emptyCallTicksWallClock{0};
+std::atomic<uint64_t> FunctionData::Impl::emptyCallNanosecondsCpu{0};
+std::atomic<bool> FunctionData::Impl::compensateOverhead{true};
+
+FunctionData::Impl::SamplingRate FunctionData::Impl::SamplingRate::withProbability(double probability) noexcept
+{
+    if (! (probability < 1.0)) // also catches NaN
+        return everyNthCall(1);
+    
+    // Never 0, which would mean "every call"
+    const auto threshold = static_cast<uint32_t>(std::max(probability, 0.0) * 4294967296.0);
+    return { 0, std::max(threshold, 1u) };
+}
+
+uint64_t FunctionData::Impl::MergedShards::estimateTotal(uint64_t sampledTotal) const noexcept
+{
+    if (numCallsSampled == 0 || numCallsSampled == numTimesCalled)
+        return sampledTotal;
+    
+    return static_cast<uint64_t>(static_cast<double>(sampledTotal)
+                                 * static_cast<double>(numTimesCalled)
+                                 / static_cast<double>(numCallsSampled));
+}
+
+void FunctionData::Impl::RunningStatistics::merge(const RunningStatistics& other) noexcept
+{
+    if (other.count == 0)
+        return;
+    
+    const auto n = static_cast<double>(count);
+    const auto otherN = static_cast<double>(other.count);
+    const auto totalN = n + otherN;
+    const auto delta = other.mean - mean;
+    
+    mean += delta * otherN / totalN;
+    sumOfSquaredDeviations += other.sumOfSquaredDeviations + delta * delta * n * otherN / totalN;
+    count += other.count;
+}
 
-// lookup only (returns NOT_FOUND if we've never seen this id)
-QITI_API_INTERNAL inline static size_t threadIdToIndex(const std::thread::id& tid) noexcept
+double FunctionData::Impl::RunningStatistics::getVariance() const noexcept
 {
-    size_t used = g_nextThreadIndex.load(std::memory_order_acquire);
-    for (size_t i = 0; i < used; ++i)
-        if (g_threadIds[i] == tid)
-            return i;
-    return THREAD_ID_NOT_FOUND;
+    return (count > 1) ? sumOfSquaredDeviations / static_cast<double>(count - 1) : 0.0;
 }
 
-// record & lookup: if unseen, atomically grab a new slot
-QITI_API_INTERNAL inline static size_t threadIdToIndexOrRegister(const std::thread::id& tid) noexcept
+void FunctionData::Impl::ShardStatistics::add(double sample) noexcept
 {
-    // check existing
-    size_t used = g_nextThreadIndex.load(std::memory_order_acquire);
-    for (size_t i = 0; i < used; ++i) {
-        if (g_threadIds[i] == tid)
-            return i;
+    const auto n = count.load(std::memory_order_relaxed) + 1;
+    const auto oldMean = mean.load(std::memory_order_relaxed);
+    const auto newMean = oldMean + (sample - oldMean) / static_cast<double>(n);
+    
+    sumOfSquaredDeviations.store(sumOfSquaredDeviations.load(std::memory_order_relaxed) + (sample - oldMean) * (sample - newMean),
+                                 std::memory_order_relaxed);
+    mean.store(newMean, std::memory_order_relaxed);
+    count.store(n, std::memory_order_relaxed);
+}
+
+FunctionData::Impl::RunningStatistics FunctionData::Impl::ShardStatistics::load() const noexcept
+{
+    return { count.load(std::memory_order_relaxed),
+             mean.load(std::memory_order_relaxed),
+             sumOfSquaredDeviations.load(std::memory_order_relaxed) };
+}
+
+FunctionData::Impl::~Impl() noexcept
+{
+    auto* shard = threadShards.load(std::memory_order_acquire);
+    while (shard != nullptr)
+    {
+        auto* next = shard->next;
+        delete shard;
+        shard = next;
     }
-    // new thread -> register it
-    size_t idx = g_nextThreadIndex.fetch_add(1, std::memory_order_acq_rel);
-    assert(idx < MAX_THREADS && "Exceeded MAX_THREADS threads!");
-    g_threadIds[idx] = tid;
-    return idx;
 }
 
-//--------------------------------------------------------------------------
+FunctionData::Impl::ThreadShard* FunctionData::Impl::addThreadShard(FunctionData* owner,
+                                                                    std::thread::id threadId) noexcept
+{
+    auto* shard = new ThreadShard(owner, threadId);
+    
+    // Publish (lock-free push-front, readers only ever traverse forwards)
+    shard->next = threadShards.load(std::memory_order_relaxed);
+    while (! threadShards.compare_exchange_weak(shard->next, shard,
+                                                std::memory_order_release,
+                                                std::memory_order_relaxed))
+    {
+    }
+    
+    return shard;
+}
 
-namespace qiti
+FunctionData::Impl::ThreadShard* FunctionData::Impl::acquireThreadShard(FunctionData* owner) noexcept
+{
+    const auto threadId = std::this_thread::get_id();
+    for (auto* shard = threadShards.load(std::memory_order_acquire); shard != nullptr; shard = shard->next)
+    {
+        // Until its id is reused, the exited thread still reports its calls
+        if (shard->isOwned.load(std::memory_order_relaxed) || shard->threadId.load(std::memory_order_relaxed) != std::thread::id{})
+            continue;
+        
+        // Its last call may be of an exited thread with the same id, which must not be reported as ours
+        FunctionCallData::Impl call;
+        if (shard->lastCall.read(call) && call.callingThread == threadId)
+            continue;
+        
+        // Acquire: the exited thread's last writes happen before ours
+        bool isOwned = false;
+        if (shard->isOwned.compare_exchange_strong(isOwned, true, std::memory_order_acquire, std::memory_order_relaxed))
+        {
+            shard->threadId.store(threadId, std::memory_order_relaxed);
+            return shard;
+        }
+    }
+    
+    return addThreadShard(owner);
+}
+
+static_assert(std::is_trivially_copyable_v<FunctionCallData::Impl>, "published by copying its bytes");
+
+void FunctionData::Impl::PublishedCall::publish(const FunctionCallData::Impl& call) noexcept
+{
+    std::array<uint64_t, numWords> bytes{};
+    std::memcpy(bytes.data(), &call, sizeof(call));
+    
+    const auto seq = sequence.load(std::memory_order_relaxed);
+    sequence.store(seq + 1, std::memory_order_relaxed); // odd: readers will retry
+    std::atomic_thread_fence(std::memory_order_release);
+    
+    for (size_t i = 0; i < numWords; ++i)
+        words[i].store(bytes[i], std::memory_order_relaxed);
+    
+    sequence.store(seq + 2, std::memory_order_release);
+}
+
+bool FunctionData::Impl::PublishedCall::read(FunctionCallData::Impl& call) const noexcept
+{
+    std::array<uint64_t, numWords> bytes{};
+    
+    while (true)
+    {
+        const auto seqBefore = sequence.load(std::memory_order_acquire);
+        if (seqBefore == 0)
+            return false;
+        
+        if ((seqBefore & 1) != 0)
+            continue; // being published
+        
+        for (size_t i = 0; i < numWords; ++i)
+            bytes[i] = words[i].load(std::memory_order_relaxed);
+        
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (sequence.load(std::memory_order_relaxed) == seqBefore)
+            break;
+    }
+    
+    std::memcpy(&call, bytes.data(), sizeof(call));
+    return true;
+}
+
+FunctionData::Impl::ThreadShard::~ThreadShard() noexcept
+{
+    delete history.load(std::memory_order_acquire);
+    delete histograms.load(std::memory_order_acquire);
+    
+    auto* edge = callerEdges.load(std::memory_order_acquire);
+    while (edge != nullptr)
+    {
+        auto* nextEdge = edge->next;
+        delete edge;
+        edge = nextEdge;
+    }
+}
+
+bool FunctionData::Impl::ThreadShard::shouldSampleCall() noexcept
+{
+    auto rate = owner->getImpl()->samplingRate.load(std::memory_order_relaxed);
+    if (! rate.isSet())
+        rate = defaultSamplingRate.load(std::memory_order_relaxed);
+    
+    if (rate.randomThreshold != 0)
+        return nextSamplingRandom() < rate.randomThreshold;
+    
+    if (numCallsUntilNextSample > 0)
+    {
+        --numCallsUntilNextSample;
+        return false;
+    }
+    numCallsUntilNextSample = (rate.interval > 1) ? rate.interval - 1 : 0;
+    return true;
+}
+
+FunctionData::Impl::CallerEdge* FunctionData::Impl::ThreadShard::getCallerEdge(const FunctionData* caller) noexcept
+{
+    if (lastCallerEdge != nullptr && lastCallerEdge->caller == caller) [[likely]]
+        return lastCallerEdge;
+    
+    // Functions only have a handful of callers, a list is faster than hashing
+    auto* edge = callerEdges.load(std::memory_order_relaxed);
+    while (edge != nullptr && edge->caller != caller)
+        edge = edge->next;
+    
+    if (edge == nullptr)
+    {
+        edge = new CallerEdge(caller); // hooks bypass malloc hooks
+        edge->next = callerEdges.load(std::memory_order_relaxed);
+        callerEdges.store(edge, std::memory_order_release); // single writer
+    }
+    
+    lastCallerEdge = edge;
+    return edge;
+}
+
+/** Time spent in the listeners of a call, which can be arbitrarily slow, to subtract it like hook overhead. */
+struct ListenersTime
+{
+    uint64_t ticksWallClock = 0;
+    uint64_t timeCpu_ns = 0;
+};
+
+template <typename Callback>
+[[nodiscard]] QITI_API_INTERNAL static ListenersTime callListeners(FunctionData& functionData,
+                                                                  const FunctionData::Impl::CallStack& callStack,
+                                                                  Callback&& callback) noexcept
+{
+    auto& listeners = functionData.getImpl()->listeners;
+    if (listeners.empty()) [[likely]]
+        return {};
+    
+    // While replaying, the listeners run long after the recorded calls
+    if (callStack.isReplayed)
+    {
+        for (auto* listener : listeners)
+            callback(*listener);
+        return {};
+    }
+    
+    const auto startTimeCpu_ns = Clock::threadCpuTime_ns();
+    const auto startTicksWallClock = Clock::startTimestamp();
+    
+    for (auto* listener : listeners)
+        callback(*listener);
+    
+    return { Clock::endTimestamp() - startTicksWallClock, Clock::threadCpuTime_ns() - startTimeCpu_ns };
+}
+
+PerfCounters::Values& FunctionData::Impl::CallStack::getPerfCountersAtStart(const CallFrame& frame) noexcept
+{
+    if (perfCountersAtStart == nullptr) [[unlikely]]
+        perfCountersAtStart.reset(new std::array<PerfCounters::Values, capacity>()); // hooks bypass malloc hooks
+    return (*perfCountersAtStart)[indexOf(frame)];
+}
+
+ResourceUsageCounters::Values& FunctionData::Impl::CallStack::getResourceUsageAtStart(const CallFrame& frame) noexcept
+{
+    if (resourceUsageAtStart == nullptr) [[unlikely]]
+        resourceUsageAtStart.reset(new std::array<ResourceUsageCounters::Values, capacity>()); // hooks bypass malloc hooks
+    return (*resourceUsageAtStart)[indexOf(frame)];
+}
+
+FunctionData::Impl::CallFrame* FunctionData::Impl::ThreadShard::beginCall(CallStack& callStack) noexcept
 {
+    auto& functionData = *owner;
+    addToShardCounter(numTimesCalled, 1);
+    
+    const auto listenersTime = callListeners(functionData, callStack, [&functionData](FunctionData::Listener& listener)
+    {
+        listener.onFunctionEnter(&functionData);
+    });
+    if (auto* caller = callStack.top(); caller != nullptr && listenersTime.ticksWallClock != 0)
+    {
+        caller->hookOverheadTicksWallClock += listenersTime.ticksWallClock;
+        caller->hookOverheadTimeCpu_ns += listenersTime.timeCpu_ns;
+    }
+    
+    const auto* parent = callStack.top();
+    const bool hasParent = ! callStack.empty(); // parent may still be nullptr if it overflowed callStack
+    const bool isSampled = shouldSampleCall();
+    
+    // Push this function onto the call stack
+    auto* frame = callStack.push();
+    if (frame == nullptr)
+        return nullptr; // too deeply nested, only counted
+    
+    frame->shard = this;
+    frame->isSampled = isSampled;
+    frame->numExceptionsThrown = 0;
+    frame->childTicksWallClock = 0;
+    frame->childTimeCpu_ns = 0;
+    frame->numNestedCalls = 0;
+    frame->numUnsampledNestedCalls = 0;
+    frame->hookOverheadTicksWallClock = 0;
+    frame->hookOverheadTimeCpu_ns = 0;
+    frame->hasPerfCounters = false;
+    frame->hasResourceUsage = false;
+    frame->contextNode = nullptr;
+    if (! isSampled)
+        return nullptr;
+    
+    addToShardCounter(numCallsSampled, 1);
+    
+    if (LatencyHistogram::enabled.load(std::memory_order_relaxed)
+        && histograms.load(std::memory_order_relaxed) == nullptr) [[unlikely]]
+    {
+        histograms.store(new DurationHistograms(), std::memory_order_release); // hooks bypass malloc hooks
+    }
+    
+    // Track caller relationship - check if there's a caller on the stack
+    frame->caller = (parent != nullptr) ? parent->shard->owner : nullptr;
+    frame->callerEdge = (frame->caller != nullptr) ? getCallerEdge(frame->caller) : nullptr;
+    
+    // Extend the call path of the caller (no node if the caller has none, e.g. beyond the depth limit)
+    if (ContextTree::enabled.load(std::memory_order_relaxed)) [[unlikely]]
+    {
+        auto& tree = ContextTree::getTree(callStack.contextTree, callStack.contextTreeGeneration);
+        auto* parentNode = hasParent ? (parent != nullptr ? parent->contextNode : nullptr) : tree.getRoot();
+        if (parentNode != nullptr)
+            frame->contextNode = tree.getChild(*parentNode, owner);
+    }
+    
+    return frame;
+}
+
+void FunctionData::Impl::ThreadShard::endUnsampledCall(CallStack& callStack) noexcept
+{
+    auto& functionData = *owner;
+    const auto listenersTime = callListeners(functionData, callStack, [&functionData](FunctionData::Listener& listener)
+    {
+        listener.onFunctionExit(&functionData);
+    });
+    
+    // Calls (and hook overhead) nested in this one are still nested in its caller
+    const auto* frame = callStack.top();
+    if (frame == nullptr)
+    {
+        callStack.pop();
+        return;
+    }
+    
+    const auto numNestedCalls = frame->numNestedCalls;
+    const auto numUnsampledNestedCalls = frame->numUnsampledNestedCalls;
+    const auto hookOverheadTicksWallClock = frame->hookOverheadTicksWallClock + listenersTime.ticksWallClock;
+    const auto hookOverheadTimeCpu_ns = frame->hookOverheadTimeCpu_ns + listenersTime.timeCpu_ns;
+    callStack.pop();
+    if (auto* parent = callStack.top())
+    {
+        parent->numNestedCalls += numNestedCalls;
+        parent->numUnsampledNestedCalls += numUnsampledNestedCalls + 1;
+        parent->hookOverheadTicksWallClock += hookOverheadTicksWallClock;
+        parent->hookOverheadTimeCpu_ns += hookOverheadTimeCpu_ns;
+    }
+}
+
+void FunctionData::Impl::ThreadShard::exceptionThrown(CallStack& callStack) noexcept
+{
+    auto* frame = callStack.top();
+    if (frame == nullptr || frame->shard == nullptr)
+        return;
+    
+    addToShardCounter(frame->shard->numExceptionsThrown, 1);
+    
+    // Also mark the current call as having thrown an exception
+    frame->numExceptionsThrown++;
+}
+
+void FunctionData::Impl::ThreadShard::endCall(CallStack& callStack,
+                                              uint64_t endTicksWallClock,
+                                              uint64_t endTimeCpu_ns,
+                                              uint32_t numHeapAllocations,
+                                              uint64_t amountHeapAllocated,
+                                              const PerfCounters::Values* perfCountersAtEnd,
+                                              const ResourceUsageCounters::Values* resourceUsageAtEnd) noexcept
+{
+    auto& functionData = *owner;
+    const auto* frame = callStack.top();
+    assert(frame != nullptr && frame->shard == this && frame->isSampled);
+    
+    // Publish FunctionCallData (before updating listeners in case listeners need that information)
+    FunctionCallData::Impl call;
+    call.startTicksWallClock = frame->startTicksWallClock;
+    call.endTicksWallClock = endTicksWallClock;
+    call.startTimeCpu_ns = frame->startTimeCpu_ns;
+    call.endTimeCpu_ns = endTimeCpu_ns;
+    call.callingThread = threadId.load(std::memory_order_relaxed);
+    call.caller = frame->caller;
+    call.timeSpentInFunctionTicksWallClock = endTicksWallClock - frame->startTicksWallClock; // converted lazily by the getters
+    call.timeSpentInFunctionNanosecondsCpu = endTimeCpu_ns - frame->startTimeCpu_ns;
+    
+    // Remove the time the hooks of the profiled calls nested in this one added to it
+    if (compensateOverhead.load(std::memory_order_relaxed))
+    {
+        const auto overheadTicksWallClock = frame->numNestedCalls * overheadTicksWallClockPerNestedCall.load(std::memory_order_relaxed)
+                                          + frame->numUnsampledNestedCalls * overheadTicksWallClockPerUnsampledNestedCall.load(std::memory_order_relaxed)
+                                          + frame->hookOverheadTicksWallClock;
+        const auto overheadNanosecondsCpu = frame->numNestedCalls * overheadNanosecondsCpuPerNestedCall.load(std::memory_order_relaxed)
+                                          + frame->numUnsampledNestedCalls * overheadNanosecondsCpuPerUnsampledNestedCall.load(std::memory_order_relaxed)
+                                          + frame->hookOverheadTimeCpu_ns;
+        call.timeSpentInFunctionTicksWallClock -= std::min(overheadTicksWallClock, call.timeSpentInFunctionTicksWallClock);
+        call.timeSpentInFunctionNanosecondsCpu -= std::min(overheadNanosecondsCpu, call.timeSpentInFunctionNanosecondsCpu);
+    }
+    
+    call.selfTimeTicksWallClock = call.timeSpentInFunctionTicksWallClock - std::min(frame->childTicksWallClock, call.timeSpentInFunctionTicksWallClock);
+    call.selfTimeNanosecondsCpu = call.timeSpentInFunctionNanosecondsCpu - std::min(frame->childTimeCpu_ns, call.timeSpentInFunctionNanosecondsCpu);
+    call.numHeapAllocationsBeforeFunctionCall = frame->numHeapAllocationsBeforeFunctionCall;
+    call.numHeapAllocationsAfterFunctionCall = numHeapAllocations;
+    call.amountHeapAllocatedBeforeFunctionCall = frame->amountHeapAllocatedBeforeFunctionCall;
+    call.amountHeapAllocatedAfterFunctionCall = amountHeapAllocated;
+    call.numExceptionsThrown = frame->numExceptionsThrown;
+    if (perfCountersAtEnd != nullptr && frame->hasPerfCounters)
+    {
+        const auto& perfCountersAtStart = callStack.getPerfCountersAtStart(*frame);
+        for (size_t i = 0; i < PerfCounters::numCounters; ++i)
+            call.perfCounters[i] = (*perfCountersAtEnd)[i] - std::min(perfCountersAtStart[i], (*perfCountersAtEnd)[i]);
+    }
+    if (resourceUsageAtEnd != nullptr && frame->hasResourceUsage)
+    {
+        const auto& resourceUsageAtStart = callStack.getResourceUsageAtStart(*frame);
+        for (size_t i = 0; i < ResourceUsageCounters::numCounters; ++i)
+            call.resourceUsage[i] = (*resourceUsageAtEnd)[i] - std::min(resourceUsageAtStart[i], (*resourceUsageAtEnd)[i]);
+    }
+    lastCall.publish(call);
+    
+    if (const auto historyCapacity = CallHistory::capacityPerFunction.load(std::memory_order_relaxed); historyCapacity > 0)
+    {
+        auto* callHistory = history.load(std::memory_order_relaxed);
+        if (callHistory == nullptr) [[unlikely]]
+        {
+            callHistory = new CallHistory(historyCapacity); // hooks bypass malloc hooks
+            history.store(callHistory, std::memory_order_release);
+        }
+        callHistory->record(call);
+    }
+    
+    if (auto* durationHistograms = histograms.load(std::memory_order_relaxed);
+        durationHistograms != nullptr && LatencyHistogram::enabled.load(std::memory_order_relaxed))
+    {
+        durationHistograms->wallClockTicks.record(call.timeSpentInFunctionTicksWallClock);
+        durationHistograms->cpuNanoseconds.record(call.timeSpentInFunctionNanosecondsCpu);
+    }
+    
+    // Update listeners
+    const auto listenersTime = callListeners(functionData, callStack, [&functionData](FunctionData::Listener& listener)
+    {
+        listener.onFunctionExit(&functionData);
+    });
+    
+    // Update this thread's totals (must be after FunctionCallData is finished)
+    const auto wallClock_ticks = call.timeSpentInFunctionTicksWallClock;
+    const auto cpu_ns          = call.timeSpentInFunctionNanosecondsCpu;
+    addToShardCounter(numCallsCompleted, 1);
+    addToShardCounter(totalTimeSpentInFunctionTicksWallClock, wallClock_ticks);
+    addToShardCounter(totalTimeSpentInFunctionNanosecondsCpu, cpu_ns);
+    addToShardCounter(totalSelfTimeTicksWallClock, call.selfTimeTicksWallClock);
+    addToShardCounter(totalSelfTimeNanosecondsCpu, call.selfTimeNanosecondsCpu);
+    for (size_t i = 0; i < PerfCounters::numCounters; ++i)
+        addToShardCounter(totalPerfCounters[i], call.perfCounters[i]);
+    for (size_t i = 0; i < ResourceUsageCounters::numCounters; ++i)
+        addToShardCounter(totalResourceUsage[i], call.resourceUsage[i]);
+    
+    if (Timeline::enabled.load(std::memory_order_relaxed)) [[unlikely]]
+    {
+        Timeline::getBuffer(callStack.timelineBuffer, callStack.timelineGeneration, call.callingThread)
+            .record({ owner, call.startTicksWallClock, call.endTicksWallClock, amountHeapAllocated });
+    }
+    
+    if (auto* contextNode = frame->contextNode)
+    {
+        ContextTree::record(*contextNode,
+                            wallClock_ticks,
+                            call.selfTimeTicksWallClock,
+                            cpu_ns,
+                            call.selfTimeNanosecondsCpu,
+                            call.amountHeapAllocatedAfterFunctionCall - call.amountHeapAllocatedBeforeFunctionCall);
+    }
+    
+    if (auto* edge = frame->callerEdge)
+    {
+        addToShardCounter(edge->numCalls, 1);
+        addToShardCounter(edge->totalTimeTicksWallClock, wallClock_ticks);
+        addToShardCounter(edge->totalTimeNanosecondsCpu, cpu_ns);
+        addToShardCounter(edge->numHeapAllocations, call.numHeapAllocationsAfterFunctionCall - call.numHeapAllocationsBeforeFunctionCall);
+        addToShardCounter(edge->amountHeapAllocated, call.amountHeapAllocatedAfterFunctionCall - call.amountHeapAllocatedBeforeFunctionCall);
+    }
+    wallClockTicksStatistics.add(static_cast<double>(wallClock_ticks));
+    cpuNanosecondsStatistics.add(static_cast<double>(cpu_ns));
+    
+    // Update min/max time spent in function (wall clock)
+    const auto minWallClock_ticks = minTimeSpentInFunctionTicksWallClock.load(std::memory_order_relaxed);
+    if (wallClock_ticks < minWallClock_ticks)
+        minTimeSpentInFunctionTicksWallClock.store(wallClock_ticks, std::memory_order_relaxed);
+    if (wallClock_ticks > maxTimeSpentInFunctionTicksWallClock.load(std::memory_order_relaxed))
+        maxTimeSpentInFunctionTicksWallClock.store(wallClock_ticks, std::memory_order_relaxed);
+    
+    // Update min/max time spent in function (CPU)
+    const auto minCpu_ns = minTimeSpentInFunctionNanosecondsCpu.load(std::memory_order_relaxed);
+    if (cpu_ns < minCpu_ns)
+        minTimeSpentInFunctionNanosecondsCpu.store(cpu_ns, std::memory_order_relaxed);
+    if (cpu_ns > maxTimeSpentInFunctionNanosecondsCpu.load(std::memory_order_relaxed))
+        maxTimeSpentInFunctionNanosecondsCpu.store(cpu_ns, std::memory_order_relaxed);
+    
+    // Pop this function from the call stack, and charge its time to its caller's children
+    const auto numNestedCalls = frame->numNestedCalls;
+    const auto numUnsampledNestedCalls = frame->numUnsampledNestedCalls;
+    const auto hookOverheadTicksWallClock = frame->hookOverheadTicksWallClock + listenersTime.ticksWallClock;
+    const auto hookOverheadTimeCpu_ns = frame->hookOverheadTimeCpu_ns + listenersTime.timeCpu_ns;
+    callStack.pop();
+    if (auto* parent = callStack.top())
+    {
+        parent->childTicksWallClock += wallClock_ticks;
+        parent->childTimeCpu_ns += cpu_ns;
+        parent->numNestedCalls += numNestedCalls + 1;
+        parent->numUnsampledNestedCalls += numUnsampledNestedCalls;
+        parent->hookOverheadTicksWallClock += hookOverheadTicksWallClock;
+        parent->hookOverheadTimeCpu_ns += hookOverheadTimeCpu_ns;
+    }
+}
+
+void FunctionData::Impl::copyCallHistoryColumn(CallHistory::Column column, std::vector<uint64_t>& values) const noexcept
+{
+    for (auto* shard = threadShards.load(std::memory_order_acquire); shard != nullptr; shard = shard->next)
+    {
+        if (const auto* callHistory = shard->history.load(std::memory_order_acquire))
+            callHistory->copyColumn(column, values);
+    }
+}
+
+void FunctionData::Impl::mergeDurationHistograms(LatencyHistogram DurationHistograms::* histogram,
+                                                 LatencyHistogram& merged) const noexcept
+{
+    for (auto* shard = threadShards.load(std::memory_order_acquire); shard != nullptr; shard = shard->next)
+    {
+        if (const auto* durationHistograms = shard->histograms.load(std::memory_order_acquire))
+            merged.merge(durationHistograms->*histogram);
+    }
+}
+
+std::vector<FunctionData::CallEdge> FunctionData::Impl::mergeCallerEdges(const FunctionData* callee) const noexcept
+{
+    std::vector<CallEdge> merged;
+    for (auto* shard = threadShards.load(std::memory_order_acquire); shard != nullptr; shard = shard->next)
+    {
+        for (auto* edge = shard->callerEdges.load(std::memory_order_acquire); edge != nullptr; edge = edge->next)
+        {
+            auto it = std::ranges::find(merged, edge->caller, &CallEdge::caller);
+            if (it == merged.end())
+            {
+                it = merged.insert(merged.end(), CallEdge{});
+                it->caller = edge->caller;
+                it->callee = callee;
+            }
+            
+            // Wall clock time is summed in ticks and converted below
+            it->numCalls += edge->numCalls.load(std::memory_order_relaxed);
+            it->totalTimeWallClock_ns += edge->totalTimeTicksWallClock.load(std::memory_order_relaxed);
+            it->totalTimeCpu_ns += edge->totalTimeNanosecondsCpu.load(std::memory_order_relaxed);
+            it->numHeapAllocations += edge->numHeapAllocations.load(std::memory_order_relaxed);
+            it->amountHeapAllocated += edge->amountHeapAllocated.load(std::memory_order_relaxed);
+        }
+    }
+    
+    for (auto& edge : merged)
+        edge.totalTimeWallClock_ns = Clock::ticksToNanoseconds(edge.totalTimeWallClock_ns);
+    
+    return merged;
+}
+
+FunctionCallData FunctionData::Impl::getLastCall(const std::thread::id* thread) const noexcept
+{
+    // Most recently started call across all (or the given) threads
+    FunctionCallData::Impl lastCall;
+    bool foundCall = false;
+    for (auto* shard = threadShards.load(std::memory_order_acquire); shard != nullptr; shard = shard->next)
+    {
+        FunctionCallData::Impl call;
+        if (! shard->lastCall.read(call))
+            continue;
+        
+        // The shard may have been adopted since the call, or the thread's id reused
+        if (thread != nullptr && (call.callingThread != *thread || shard->threadId.load(std::memory_order_relaxed) != *thread))
+            continue;
+        
+        if (! foundCall || call.startTicksWallClock > lastCall.startTicksWallClock)
+        {
+            lastCall = call;
+            foundCall = true;
+        }
+    }
+    
+    FunctionCallData result;
+    *result.getImpl() = lastCall;
+    return result;
+}
+
+FunctionData::Impl::MergedShards FunctionData::Impl::mergeThreadShards() const noexcept
+{
+    DeferredEvents::drain(); // fold in calls that were only recorded so far
+    
+    MergedShards merged;
+    
+    // Unset (no completed call) until a shard's minimum is merged, see ThreadShard
+    auto minTimeSpentInFunctionNanosecondsCpu = std::numeric_limits<uint64_t>::max();
+    auto minTimeSpentInFunctionTicksWallClock = std::numeric_limits<uint64_t>::max();
+    
+    for (auto* shard = threadShards.load(std::memory_order_acquire); shard != nullptr; shard = shard->next)
+    {
+        merged.numTimesCalled += shard->numTimesCalled.load(std::memory_order_relaxed);
+        merged.numCallsSampled += shard->numCallsSampled.load(std::memory_order_relaxed);
+        merged.numExceptionsThrown += shard->numExceptionsThrown.load(std::memory_order_relaxed);
+        
+        const auto numCallsCompleted = shard->numCallsCompleted.load(std::memory_order_relaxed);
+        if (numCallsCompleted == 0)
+            continue;
+        
+        merged.numCallsCompleted += numCallsCompleted;
+        merged.totalTimeSpentInFunctionNanosecondsCpu += shard->totalTimeSpentInFunctionNanosecondsCpu.load(std::memory_order_relaxed);
+        merged.totalTimeSpentInFunctionTicksWallClock += shard->totalTimeSpentInFunctionTicksWallClock.load(std::memory_order_relaxed);
+        merged.totalSelfTimeNanosecondsCpu += shard->totalSelfTimeNanosecondsCpu.load(std::memory_order_relaxed);
+        merged.totalSelfTimeTicksWallClock += shard->totalSelfTimeTicksWallClock.load(std::memory_order_relaxed);
+        merged.wallClockTicksStatistics.merge(shard->wallClockTicksStatistics.load());
+        merged.cpuNanosecondsStatistics.merge(shard->cpuNanosecondsStatistics.load());
+        for (size_t i = 0; i < PerfCounters::numCounters; ++i)
+            merged.totalPerfCounters[i] += shard->totalPerfCounters[i].load(std::memory_order_relaxed);
+        for (size_t i = 0; i < ResourceUsageCounters::numCounters; ++i)
+            merged.totalResourceUsage[i] += shard->totalResourceUsage[i].load(std::memory_order_relaxed);
+        
+        minTimeSpentInFunctionNanosecondsCpu = std::min(minTimeSpentInFunctionNanosecondsCpu,
+                                                        shard->minTimeSpentInFunctionNanosecondsCpu.load(std::memory_order_relaxed));
+        minTimeSpentInFunctionTicksWallClock = std::min(minTimeSpentInFunctionTicksWallClock,
+                                                        shard->minTimeSpentInFunctionTicksWallClock.load(std::memory_order_relaxed));
+        
+        merged.maxTimeSpentInFunctionNanosecondsCpu = std::max(merged.maxTimeSpentInFunctionNanosecondsCpu,
+                                                               shard->maxTimeSpentInFunctionNanosecondsCpu.load(std::memory_order_relaxed));
+        merged.maxTimeSpentInFunctionTicksWallClock = std::max(merged.maxTimeSpentInFunctionTicksWallClock,
+                                                                     shard->maxTimeSpentInFunctionTicksWallClock.load(std::memory_order_relaxed));
+    }
+    
+    if (minTimeSpentInFunctionNanosecondsCpu != std::numeric_limits<uint64_t>::max())
+        merged.minTimeSpentInFunctionNanosecondsCpu = minTimeSpentInFunctionNanosecondsCpu;
+    if (minTimeSpentInFunctionTicksWallClock != std::numeric_limits<uint64_t>::max())
+        merged.minTimeSpentInFunctionTicksWallClock = minTimeSpentInFunctionTicksWallClock;
+    
+    return merged;
+}
+
+//--------------------------------------------------------------------------
 
 FunctionData::FunctionData(const void* functionAddress,
                            const char* functionName,
@@ -124,7 +766,15 @@ uint64_t FunctionData::getNumTimesCalled() const noexcept
     qiti::Profile::ScopedDisableProfiling disableProfiling;
     qiti::ScopedNoHeapAllocations noAlloc;
     
-    return getImpl()->numTimesCalled;
+    return getImpl()->mergeThreadShards().numTimesCalled;
+}
+
+uint64_t FunctionData::getNumCallsSampled() const noexcept
+{
+    qiti::Profile::ScopedDisableProfiling disableProfiling;
+    qiti::ScopedNoHeapAllocations noAlloc;
+    
+    return getImpl()->mergeThreadShards().numCallsSampled;
 }
 
 uint64_t FunctionData::getAverageTimeSpentInFunctionCpu_ns() const noexcept
@@ -132,7 +782,10 @@ uint64_t FunctionData::getAverageTimeSpentInFunctionCpu_ns() const noexcept
     qiti::Profile::ScopedDisableProfiling disableProfiling;
     qiti::ScopedNoHeapAllocations noAlloc;
     
-    return getImpl()->averageTimeSpentInFunctionNanosecondsCpu;
+    const auto merged = getImpl()->mergeThreadShards();
+    return (merged.numCallsCompleted > 0) // prevent divide by zero
+           ? merged.totalTimeSpentInFunctionNanosecondsCpu / merged.numCallsCompleted
+           : 0;
 }
 
 uint64_t FunctionData::getAverageTimeSpentInFunctionWallClock_ns() const noexcept
@@ -140,7 +793,64 @@ uint64_t FunctionData::getAverageTimeSpentInFunctionWallClock_ns() const noexcep
     qiti::Profile::ScopedDisableProfiling disableProfiling;
     qiti::ScopedNoHeapAllocations noAlloc;
     
-    return getImpl()->averageTimeSpentInFunctionNanosecondsWallClock;
+    const auto merged = getImpl()->mergeThreadShards();
+    return (merged.numCallsCompleted > 0) // prevent divide by zero
+           ? Clock::ticksToNanoseconds(merged.totalTimeSpentInFunctionTicksWallClock / merged.numCallsCompleted)
+           : 0;
+}
+
+uint64_t FunctionData::getAverageSelfTimeSpentInFunctionCpu_ns() const noexcept
+{
+    qiti::Profile::ScopedDisableProfiling disableProfiling;
+    qiti::ScopedNoHeapAllocations noAlloc;
+    
+    const auto merged = getImpl()->mergeThreadShards();
+    return (merged.numCallsCompleted > 0) // prevent divide by zero
+           ? merged.totalSelfTimeNanosecondsCpu / merged.numCallsCompleted
+           : 0;
+}
+
+uint64_t FunctionData::getAverageSelfTimeSpentInFunctionWallClock_ns() const noexcept
+{
+    qiti::Profile::ScopedDisableProfiling disableProfiling;
+    qiti::ScopedNoHeapAllocations noAlloc;
+    
+    const auto merged = getImpl()->mergeThreadShards();
+    return (merged.numCallsCompleted > 0) // prevent divide by zero
+           ? Clock::ticksToNanoseconds(merged.totalSelfTimeTicksWallClock / merged.numCallsCompleted)
+           : 0;
+}
+
+/** Statistics of durations measured in units of unitInNanoseconds, in nanoseconds. */
+[[nodiscard]] QITI_API_INTERNAL static FunctionData::TimeStatistics toTimeStatistics(const FunctionData::Impl::RunningStatistics& statistics,
+                                                                                     double unitInNanoseconds) noexcept
+{
+    FunctionData::TimeStatistics result;
+    result.mean_ns = statistics.mean * unitInNanoseconds;
+    result.variance_ns2 = statistics.getVariance() * unitInNanoseconds * unitInNanoseconds;
+    result.standardDeviation_ns = std::sqrt(result.variance_ns2);
+    result.coefficientOfVariation = (result.mean_ns > 0.0) ? result.standardDeviation_ns / result.mean_ns : 0.0;
+    return result;
+}
+
+FunctionData::TimeStatistics FunctionData::getWallClockStatistics() const noexcept
+{
+    qiti::Profile::ScopedDisableProfiling disableProfiling;
+    qiti::ScopedNoHeapAllocations noAlloc;
+    
+    // Ticks may be shorter than a nanosecond, so convert a large number of them for precision
+    constexpr uint64_t numTicks = 1'000'000'000;
+    const auto nanosecondsPerTick = static_cast<double>(Clock::ticksToNanoseconds(numTicks)) / static_cast<double>(numTicks);
+    
+    return toTimeStatistics(getImpl()->mergeThreadShards().wallClockTicksStatistics, nanosecondsPerTick);
+}
+
+FunctionData::TimeStatistics FunctionData::getCpuStatistics() const noexcept
+{
+    qiti::Profile::ScopedDisableProfiling disableProfiling;
+    qiti::ScopedNoHeapAllocations noAlloc;
+    
+    return toTimeStatistics(getImpl()->mergeThreadShards().cpuNanosecondsStatistics, 1.0);
 }
 
 uint64_t FunctionData::getMinTimeSpentInFunctionCpu_ns() const noexcept
@@ -148,7 +858,7 @@ uint64_t FunctionData::getMinTimeSpentInFunctionCpu_ns() const noexcept
     qiti::Profile::ScopedDisableProfiling disableProfiling;
     qiti::ScopedNoHeapAllocations noAlloc;
     
-    return getImpl()->minTimeSpentInFunctionNanosecondsCpu;
+    return getImpl()->mergeThreadShards().minTimeSpentInFunctionNanosecondsCpu;
 }
 
 uint64_t FunctionData::getMaxTimeSpentInFunctionCpu_ns() const noexcept
@@ -156,7 +866,7 @@ uint64_t FunctionData::getMaxTimeSpentInFunctionCpu_ns() const noexcept
     qiti::Profile::ScopedDisableProfiling disableProfiling;
     qiti::ScopedNoHeapAllocations noAlloc;
     
-    return getImpl()->maxTimeSpentInFunctionNanosecondsCpu;
+    return getImpl()->mergeThreadShards().maxTimeSpentInFunctionNanosecondsCpu;
 }
 
 uint64_t FunctionData::getMinTimeSpentInFunctionWallClock_ns() const noexcept
@@ -164,7 +874,7 @@ uint64_t FunctionData::getMinTimeSpentInFunctionWallClock_ns() const noexcept
     qiti::Profile::ScopedDisableProfiling disableProfiling;
     qiti::ScopedNoHeapAllocations noAlloc;
     
-    return getImpl()->minTimeSpentInFunctionNanosecondsWallClock;
+    return Clock::ticksToNanoseconds(getImpl()->mergeThreadShards().minTimeSpentInFunctionTicksWallClock);
 }
 
 uint64_t FunctionData::getMaxTimeSpentInFunctionWallClock_ns() const noexcept
@@ -172,7 +882,7 @@ uint64_t FunctionData::getMaxTimeSpentInFunctionWallClock_ns() const noexcept
     qiti::Profile::ScopedDisableProfiling disableProfiling;
     qiti::ScopedNoHeapAllocations noAlloc;
     
-    return getImpl()->maxTimeSpentInFunctionNanosecondsWallClock;
+    return Clock::ticksToNanoseconds(getImpl()->mergeThreadShards().maxTimeSpentInFunctionTicksWallClock);
 }
 
 FunctionCallData FunctionData::getLastFunctionCall() const noexcept
@@ -180,7 +890,149 @@ FunctionCallData FunctionData::getLastFunctionCall() const noexcept
     qiti::Profile::ScopedDisableProfiling disableProfiling;
     MallocHooks::ScopedBypassMallocHooks bypassMallocHooks;
     
-    return getImpl()->lastCallData;
+    DeferredEvents::drain(); // fold in calls that were only recorded so far
+    
+    return getImpl()->getLastCall(nullptr);
+}
+
+FunctionCallData FunctionData::getLastFunctionCall(std::thread::id thread) const noexcept
+{
+    qiti::Profile::ScopedDisableProfiling disableProfiling;
+    MallocHooks::ScopedBypassMallocHooks bypassMallocHooks;
+    
+    DeferredEvents::drain(); // fold in calls that were only recorded so far
+    
+    return getImpl()->getLastCall(&thread);
+}
+
+std::vector<FunctionCallData> FunctionData::getCallHistory() const noexcept
+{
+    qiti::Profile::ScopedDisableProfiling disableProfiling;
+    MallocHooks::ScopedBypassMallocHooks bypassMallocHooks;
+    
+    DeferredEvents::drain(); // fold in calls that were only recorded so far
+    
+    std::vector<FunctionCallData::Impl> calls;
+    for (auto* shard = getImpl()->threadShards.load(std::memory_order_acquire); shard != nullptr; shard = shard->next)
+    {
+        if (const auto* callHistory = shard->history.load(std::memory_order_acquire))
+            callHistory->copyCalls(calls);
+    }
+    
+    // Interleave the threads' calls
+    std::ranges::stable_sort(calls, {}, &FunctionCallData::Impl::startTicksWallClock);
+    
+    std::vector<FunctionCallData> result(calls.size());
+    for (size_t i = 0; i < calls.size(); ++i)
+        *result[i].getImpl() = calls[i];
+    return result;
+}
+
+/** p50/p90/p99/max of a column of the call history, converted with toOutputUnit. */
+template <typename Conversion>
+[[nodiscard]] QITI_API_INTERNAL static FunctionData::Percentiles getCallHistoryPercentiles(const FunctionData::Impl& impl,
+                                                                                         CallHistory::Column column,
+                                                                                         Conversion toOutputUnit) noexcept
+{
+    qiti::Profile::ScopedDisableProfiling disableProfiling;
+    MallocHooks::ScopedBypassMallocHooks bypassMallocHooks;
+    
+    DeferredEvents::drain(); // fold in calls that were only recorded so far
+    
+    std::vector<uint64_t> values;
+    impl.copyCallHistoryColumn(column, values);
+    
+    FunctionData::Percentiles percentiles;
+    percentiles.p50 = toOutputUnit(CallHistory::percentile(values, 50.0));
+    percentiles.p90 = toOutputUnit(CallHistory::percentile(values, 90.0));
+    percentiles.p99 = toOutputUnit(CallHistory::percentile(values, 99.0));
+    percentiles.max = toOutputUnit(CallHistory::percentile(values, 100.0));
+    return percentiles;
+}
+
+FunctionData::Percentiles FunctionData::getWallClockPercentiles_ns() const noexcept
+{
+    return getCallHistoryPercentiles(*getImpl(),
+                                     CallHistory::Column::timeSpentTicksWallClock,
+                                     [](uint64_t ticks) { return Clock::ticksToNanoseconds(ticks); });
+}
+
+FunctionData::Percentiles FunctionData::getCpuPercentiles_ns() const noexcept
+{
+    return getCallHistoryPercentiles(*getImpl(),
+                                     CallHistory::Column::timeSpentNanosecondsCpu,
+                                     [](uint64_t ns) { return ns; });
+}
+
+FunctionData::Percentiles FunctionData::getAmountHeapAllocatedPercentiles() const noexcept
+{
+    return getCallHistoryPercentiles(*getImpl(),
+                                     CallHistory::Column::amountHeapAllocated,
+                                     [](uint64_t bytes) { return bytes; });
+}
+
+uint64_t FunctionData::getWallClockValueAtQuantile_ns(double quantile) const noexcept
+{
+    qiti::Profile::ScopedDisableProfiling disableProfiling;
+    MallocHooks::ScopedBypassMallocHooks bypassMallocHooks;
+    
+    DeferredEvents::drain(); // fold in calls that were only recorded so far
+    
+    auto merged = std::make_unique<LatencyHistogram>();
+    getImpl()->mergeDurationHistograms(&Impl::DurationHistograms::wallClockTicks, *merged);
+    return Clock::ticksToNanoseconds(merged->getValueAtQuantile(quantile));
+}
+
+uint64_t FunctionData::getCpuValueAtQuantile_ns(double quantile) const noexcept
+{
+    qiti::Profile::ScopedDisableProfiling disableProfiling;
+    MallocHooks::ScopedBypassMallocHooks bypassMallocHooks;
+    
+    DeferredEvents::drain(); // fold in calls that were only recorded so far
+    
+    auto merged = std::make_unique<LatencyHistogram>();
+    getImpl()->mergeDurationHistograms(&Impl::DurationHistograms::cpuNanoseconds, *merged);
+    return merged->getValueAtQuantile(quantile);
+}
+
+uint64_t FunctionData::getTotalPerfCounter(PerfCounter counter) const noexcept
+{
+    qiti::Profile::ScopedDisableProfiling disableProfiling;
+    qiti::ScopedNoHeapAllocations noAlloc;
+    
+    const auto merged = getImpl()->mergeThreadShards();
+    return merged.estimateTotal(merged.totalPerfCounters[static_cast<size_t>(counter)]);
+}
+
+uint64_t FunctionData::getAveragePerfCounter(PerfCounter counter) const noexcept
+{
+    qiti::Profile::ScopedDisableProfiling disableProfiling;
+    qiti::ScopedNoHeapAllocations noAlloc;
+    
+    const auto merged = getImpl()->mergeThreadShards();
+    return (merged.numCallsCompleted > 0) // prevent divide by zero
+           ? merged.totalPerfCounters[static_cast<size_t>(counter)] / merged.numCallsCompleted
+           : 0;
+}
+
+uint64_t FunctionData::getTotalResourceUsage(ResourceUsage usage) const noexcept
+{
+    qiti::Profile::ScopedDisableProfiling disableProfiling;
+    qiti::ScopedNoHeapAllocations noAlloc;
+    
+    const auto merged = getImpl()->mergeThreadShards();
+    return merged.estimateTotal(merged.totalResourceUsage[static_cast<size_t>(usage)]);
+}
+
+uint64_t FunctionData::getAverageResourceUsage(ResourceUsage usage) const noexcept
+{
+    qiti::Profile::ScopedDisableProfiling disableProfiling;
+    qiti::ScopedNoHeapAllocations noAlloc;
+    
+    const auto merged = getImpl()->mergeThreadShards();
+    return (merged.numCallsCompleted > 0) // prevent divide by zero
+           ? merged.totalResourceUsage[static_cast<size_t>(usage)] / merged.numCallsCompleted
+           : 0;
 }
 
 std::vector<const FunctionData*> FunctionData::getAllProfiledFunctionData() noexcept
@@ -196,22 +1048,55 @@ std::vector<const FunctionData*> FunctionData::getCallers() const noexcept
     qiti::Profile::ScopedDisableProfiling disableProfiling;
     MallocHooks::ScopedBypassMallocHooks bypassMallocHooks;
     
-    const auto& callersSet = getImpl()->callers;
-    std::vector<const FunctionData*> result;
-    result.reserve(callersSet.size());
+    DeferredEvents::drain(); // fold in calls that were only recorded so far
     
-    for (const auto* caller : callersSet)
-        result.push_back(caller);
+    std::vector<const FunctionData*> result;
+    for (const auto& edge : getImpl()->mergeCallerEdges(this))
+        result.push_back(edge.caller);
     
     return result;
 }
 
+std::vector<FunctionData::CallEdge> FunctionData::getCallerStats() const noexcept
+{
+    qiti::Profile::ScopedDisableProfiling disableProfiling;
+    MallocHooks::ScopedBypassMallocHooks bypassMallocHooks;
+    
+    DeferredEvents::drain(); // fold in calls that were only recorded so far
+    
+    auto edges = getImpl()->mergeCallerEdges(this);
+    std::ranges::sort(edges, std::ranges::greater{}, &CallEdge::totalTimeWallClock_ns);
+    return edges;
+}
+
+std::vector<FunctionData::CallEdge> FunctionData::getCallees() const noexcept
+{
+    qiti::Profile::ScopedDisableProfiling disableProfiling;
+    MallocHooks::ScopedBypassMallocHooks bypassMallocHooks;
+    
+    DeferredEvents::drain(); // fold in calls that were only recorded so far
+    
+    // Edges are stored with their callee, so look for this function among the callers of every function
+    std::vector<CallEdge> edges;
+    for (const auto* callee : getAllProfiledFunctionData())
+    {
+        for (const auto& edge : callee->getImpl()->mergeCallerEdges(callee))
+        {
+            if (edge.caller == this)
+                edges.push_back(edge);
+        }
+    }
+    
+    std::ranges::sort(edges, std::ranges::greater{}, &CallEdge::totalTimeWallClock_ns);
+    return edges;
+}
+
 uint64_t FunctionData::getNumExceptionsThrown() const noexcept
 {
     qiti::Profile::ScopedDisableProfiling disableProfiling;
     qiti::ScopedNoHeapAllocations noAlloc;
     
-    return getImpl()->numExceptionsThrown;
+    return getImpl()->mergeThreadShards().numExceptionsThrown;
 }
 
 bool FunctionData::isConstructor() const noexcept
@@ -283,26 +1168,20 @@ bool FunctionData::isDestructor() const noexcept
     return getImpl()->functionType == FunctionType::destructor;
 }
 
-void FunctionData::functionCalled() noexcept
-{
-    qiti::ScopedNoHeapAllocations noAlloc;
-    
-    auto* impl = getImpl();
-    ++impl->numTimesCalled;
-    
-    auto idx = threadIdToIndexOrRegister(std::this_thread::get_id());
-    impl->threadsCalledOn.set(idx);
-}
-
 bool FunctionData::wasCalledOnThread(std::thread::id thread) const noexcept
 {
     qiti::Profile::ScopedDisableProfiling disableProfiling;
-    qiti::ScopedNoHeapAllocations noAlloc;
+    MallocHooks::ScopedBypassMallocHooks bypassMallocHooks;
+    
+    DeferredEvents::drain(); // fold in calls that were only recorded so far
     
-    auto* impl = getImpl();
-    auto idx = threadIdToIndex(thread);
-    return (idx != THREAD_ID_NOT_FOUND)
-           && impl->threadsCalledOn.test(idx);
+    // Shards of exited threads keep their id until it is reused
+    for (const auto* shard = getImpl()->threadShards.load(std::memory_order_acquire); shard != nullptr; shard = shard->next)
+    {
+        if (shard->threadId.load(std::memory_order_relaxed) == thread)
+            return true;
+    }
+    return false;
 }
 
 void FunctionData::addListener(FunctionData::Listener* listener) noexcept
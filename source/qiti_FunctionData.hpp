@@ -78,9 +78,20 @@ public:
      Get the total number of times this function was called.
 
      Returns the count of all recorded invocations that have occurred since we began profiling the function.
+     Always exact, even when only some calls are sampled (see ScopedQitiTest::setSamplingInterval()).
      */
     [[nodiscard]] QITI_API uint64_t getNumTimesCalled() const noexcept;
     
+    /**
+     Get the number of calls that were sampled (measured).
+     
+     Timings, heap allocations and the last function call are only captured for sampled calls,
+     so averages, minimums and maximums are estimated from these calls.
+     Equal to getNumTimesCalled() unless sampling was enabled with ScopedQitiTest::setSamplingInterval()
+     or ScopedQitiTest::setSamplingProbability().
+     */
+    [[nodiscard]] QITI_API uint64_t getNumCallsSampled() const noexcept;
+    
     /**
      Returns the average time spent inside this function, in nanoseconds.
      
@@ -102,6 +113,56 @@ public:
      */
     [[nodiscard]] QITI_API uint64_t getAverageTimeSpentInFunctionWallClock_ns() const noexcept;
     
+    /**
+     Returns the average CPU time spent in this function itself (exclusive or "self" time), in nanoseconds.
+     
+     Unlike getAverageTimeSpentInFunctionCpu_ns(), this excludes the time spent in the profiled
+     functions it called, so a driver function that only delegates work has a small self time.
+     Time spent in unprofiled (or unsampled) callees still counts as self time.
+     
+     Feature is not supported on Windows.
+     */
+#ifdef _WIN32
+    [[deprecated("Feature is not supported on Windows")]]
+#endif
+    [[nodiscard]] QITI_API uint64_t getAverageSelfTimeSpentInFunctionCpu_ns() const noexcept;
+    
+    /**
+     Returns the average wall-clock time spent in this function itself (exclusive or "self" time), in nanoseconds.
+     @see getAverageSelfTimeSpentInFunctionCpu_ns()
+     */
+    [[nodiscard]] QITI_API uint64_t getAverageSelfTimeSpentInFunctionWallClock_ns() const noexcept;
+    
+    /** Mean and spread of the time spent in the (sampled) calls of a function. */
+    struct TimeStatistics
+    {
+        double mean_ns = 0.0;
+        double variance_ns2 = 0.0;           ///< sample variance, in nanoseconds squared
+        double standardDeviation_ns = 0.0;
+        double coefficientOfVariation = 0.0; ///< standardDeviation_ns / mean_ns (relative noise), 0 if the mean is 0
+    };
+    
+    /**
+     Returns the mean, variance, standard deviation and coefficient of variation of the
+     CPU time spent inside this function. All 0 if the function has never been called.
+     
+     Accumulated without loss of precision (Welford's algorithm), so tests can assert on the
+     noise of a measurement, e.g. only compare averages when the coefficient of variation is small.
+     
+     Feature is not supported on Windows.
+     */
+#ifdef _WIN32
+    [[deprecated("Feature is not supported on Windows")]]
+#endif
+    [[nodiscard]] QITI_API TimeStatistics getCpuStatistics() const noexcept;
+    
+    /**
+     Returns the mean, variance, standard deviation and coefficient of variation of the
+     wall-clock time spent inside this function. All 0 if the function has never been called.
+     @see getCpuStatistics()
+     */
+    [[nodiscard]] QITI_API TimeStatistics getWallClockStatistics() const noexcept;
+    
     /**
      Returns the minimum CPU time spent in any single call to this function, in nanoseconds.
      
@@ -154,9 +215,106 @@ public:
      Retrieve the most recent function call data.
 
      Returns a FunctionCallData object representing the last recorded invocation of this function.
+     Invocations still in progress are not included. When sampling, this is the last sampled invocation.
      */
     [[nodiscard]] QITI_API FunctionCallData getLastFunctionCall() const noexcept;
     
+    /**
+     Retrieve the most recent function call data of a single thread.
+     
+     Returns a default FunctionCallData object if this function never completed a call on that thread.
+     Safe to call while the function is being called on other threads, the call returned is always
+     one complete call (never partially overwritten by a concurrent call).
+     */
+    [[nodiscard]] QITI_API FunctionCallData getLastFunctionCall(std::thread::id thread) const noexcept;
+    
+    /**
+     Get the most recent calls of this function, oldest first.
+     
+     Disabled by default: enable it with ScopedQitiTest::setCallHistoryCapacity() before calling the
+     function. Up to that many calls are retained per thread that called the function (older calls
+     are overwritten), so memory stays bounded however long the test runs. When sampling, only
+     sampled calls are retained.
+     
+     Heap allocation counters of the returned calls are retained as differences, so they are
+     correct for FunctionCallData::getNumHeapAllocations() and getAmountHeapAllocated().
+     */
+    [[nodiscard]] QITI_API std::vector<FunctionCallData> getCallHistory() const noexcept;
+    
+    /** Percentiles of a measurement over the calls retained in the call history. */
+    struct Percentiles
+    {
+        uint64_t p50 = 0; ///< median
+        uint64_t p90 = 0;
+        uint64_t p99 = 0;
+        uint64_t max = 0;
+    };
+    
+    /**
+     Returns percentiles of the wall-clock time spent in the calls retained in the call history, in nanoseconds.
+     All 0 if the call history is disabled (see getCallHistory()).
+     */
+    [[nodiscard]] QITI_API Percentiles getWallClockPercentiles_ns() const noexcept;
+    
+    /**
+     Returns percentiles of the CPU time spent in the calls retained in the call history, in nanoseconds.
+     All 0 if the call history is disabled (see getCallHistory()).
+     */
+    [[nodiscard]] QITI_API Percentiles getCpuPercentiles_ns() const noexcept;
+    
+    /**
+     Returns percentiles of the bytes heap allocated by the calls retained in the call history.
+     All 0 if the call history is disabled (see getCallHistory()).
+     */
+    [[nodiscard]] QITI_API Percentiles getAmountHeapAllocatedPercentiles() const noexcept;
+    
+    /**
+     Returns the wall-clock time that a fraction of quantile (0 to 1) of the calls took at most, in nanoseconds
+     (e.g. 0.99 for the 99th percentile), within ~3%.
+     
+     Unlike the call history, this covers every (sampled) call at constant memory, so tail latencies
+     stay exact however many calls were made. Disabled by default: enable it with
+     ScopedQitiTest::enableLatencyHistograms() before calling the function. 0 while disabled.
+     */
+    [[nodiscard]] QITI_API uint64_t getWallClockValueAtQuantile_ns(double quantile) const noexcept;
+    
+    /**
+     Returns the CPU time that a fraction of quantile (0 to 1) of the calls took at most, in nanoseconds, within ~3%.
+     @see getWallClockValueAtQuantile_ns()
+     */
+    [[nodiscard]] QITI_API uint64_t getCpuValueAtQuantile_ns(double quantile) const noexcept;
+    
+    /**
+     Returns how much the given performance counter increased during all calls of this function,
+     scaled up to all calls when only some calls are sampled.
+     
+     Like time, this includes the profiled functions it called. Disabled by default: enable it with
+     ScopedQitiTest::enablePerfCounters() before calling the function. 0 while disabled, and if the
+     counter is not available (see ScopedQitiTest::isPerfCounterAvailable()).
+     */
+    [[nodiscard]] QITI_API uint64_t getTotalPerfCounter(PerfCounter counter) const noexcept;
+    
+    /**
+     Returns how much the given performance counter increased during a call of this function, on average.
+     @see getTotalPerfCounter()
+     */
+    [[nodiscard]] QITI_API uint64_t getAveragePerfCounter(PerfCounter counter) const noexcept;
+    
+    /**
+     Returns how much the given resource usage of the calling threads increased during all calls
+     of this function, scaled up to all calls when only some calls are sampled.
+     
+     Like time, this includes the profiled functions it called. Disabled by default: enable it with
+     ScopedQitiTest::enableResourceUsage() before calling the function. 0 while disabled.
+     */
+    [[nodiscard]] QITI_API uint64_t getTotalResourceUsage(ResourceUsage usage) const noexcept;
+    
+    /**
+     Returns how much the given resource usage increased during a call of this function, on average.
+     @see getTotalResourceUsage()
+     */
+    [[nodiscard]] QITI_API uint64_t getAverageResourceUsage(ResourceUsage usage) const noexcept;
+    
     /**
      Get all profiled function data.
 
@@ -175,6 +333,33 @@ public:
      */
     [[nodiscard]] QITI_API std::vector<const FunctionData*> getCallers() const noexcept;
     
+    /** Calls from one function to another: a weighted edge of the call graph. */
+    struct CallEdge
+    {
+        const FunctionData* caller = nullptr;
+        const FunctionData* callee = nullptr;
+        uint64_t numCalls = 0;              ///< sampled calls only
+        uint64_t totalTimeWallClock_ns = 0; ///< inclusive time spent in the callee for these calls
+        uint64_t totalTimeCpu_ns = 0;
+        uint64_t numHeapAllocations = 0;
+        uint64_t amountHeapAllocated = 0;
+    };
+    
+    /**
+     Get how often, and how expensively, each caller called this function.
+     
+     Tells which call path makes a function expensive: e.g. a function that is only slow when
+     called from one particular caller. Sorted by wall-clock time, most expensive first.
+     Like getCallers(), calls from outside the profiled call stack are not included.
+     */
+    [[nodiscard]] QITI_API std::vector<CallEdge> getCallerStats() const noexcept;
+    
+    /**
+     Get how often, and how expensively, this function called each profiled function.
+     Sorted by wall-clock time, most expensive first. @see getCallerStats()
+     */
+    [[nodiscard]] QITI_API std::vector<CallEdge> getCallees() const noexcept;
+    
     /**
      @returns The total number of exceptions thrown by this function.
      
@@ -333,13 +518,6 @@ private:
                                                   static_cast<int>(functionType));
     }
     
-    /**
-     Record that the function was called.
-
-     Updates internal state to log a new invocation, including timestamp and thread information.
-     */
-    QITI_API_INTERNAL void functionCalled() noexcept;
-    
     /** */
     [[nodiscard]] QITI_API_INTERNAL static constexpr FunctionType getFunctionType(const char* functionName) noexcept
     {
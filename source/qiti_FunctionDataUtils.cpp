@@ -16,9 +16,14 @@
 #include <qiti_FunctionDataUtils.hpp>
 
 #include "qiti_include.hpp"
+#include "qiti_ContextTree.hpp"
+#include "qiti_DeferredEvents.hpp"
+#include "qiti_FunctionRegistry.hpp"
 #include "qiti_Instrument.hpp"
 #include "qiti_LockData.hpp"
+#include "qiti_LockHooks.hpp"
 #include "qiti_MallocHooks.hpp"
+#include "qiti_Timeline.hpp"
 
 #ifdef _WIN32
 #include <windows.h>
@@ -29,6 +34,7 @@
 #endif
 
 #include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <cstddef>
 #include <cstdio>
@@ -39,6 +45,7 @@
 #include <mutex>
 #include <ranges>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <unordered_set>
 #include <utility>
@@ -101,13 +108,39 @@ int dladdr(const void* addr, Dl_info* info)
 }
 #endif
 
-/** */
-[[nodiscard]] static auto& getFunctionMap() noexcept
+/**
+ Serializes the creation of FunctionData (and the function name storage below).
+ 
+ Only taken the first time a function is encountered, lookups of existing
+ FunctionData go straight through the lock-free FunctionRegistry.
+ */
+[[nodiscard]] static std::mutex& getFunctionDataCreationMutex() noexcept
 {
-    static std::unordered_map<const void*, qiti::FunctionData> map;
-    return map;
+    static std::mutex mutex;
+    return mutex;
 }
 
+/** Locks without reporting the lock to LockData listeners (and without allocating). */
+class ScopedFunctionDataCreationLock
+{
+public:
+    ScopedFunctionDataCreationLock() noexcept
+    : previousBypassState(qiti::LockHooks::bypassLockHooks)
+    {
+        qiti::LockHooks::bypassLockHooks = true;
+        getFunctionDataCreationMutex().lock();
+    }
+    
+    ~ScopedFunctionDataCreationLock() noexcept
+    {
+        getFunctionDataCreationMutex().unlock();
+        qiti::LockHooks::bypassLockHooks = previousBypassState;
+    }
+    
+private:
+    const bool previousBypassState;
+};
+
 /** */
 [[nodiscard]] static const char* getFunctionName(const void* this_fn) noexcept
 {
@@ -153,56 +186,67 @@ namespace qiti
                                                                     const char* functionName,
                                                                     int functionTypeInt) noexcept
 {
-    auto& g_functionMap = getFunctionMap();
-    
-    auto it = g_functionMap.find(functionAddress);
-    if (it == g_functionMap.end()) // not yet added to map
+    // Fast path, already created
+    if (auto* entry = FunctionRegistry::find(functionAddress))
     {
-        if (functionName == nullptr)
-            functionName = getFunctionName(functionAddress);
-        
-        auto functionType = qiti::FunctionData::FunctionType::unknown; // default to unknown
-        if (functionTypeInt != -1)
-            functionType = static_cast<FunctionData::FunctionType>(functionTypeInt);
-        else if (functionName != nullptr)
-            functionType = qiti::FunctionData::getFunctionType(functionName);
-
-        qiti::FunctionData data(functionAddress,
-                                functionName,
-                                functionType);
-        
-        auto [insertedIt, success] = g_functionMap.emplace(functionAddress, std::move(data));
-        
-        return insertedIt->second;
+        if (auto* functionData = entry->functionData.load(std::memory_order_acquire))
+            return *functionData;
     }
     
-    return it->second;
+    ScopedFunctionDataCreationLock lock;
+    
+    auto& entry = FunctionRegistry::findOrInsert(functionAddress);
+    if (auto* functionData = entry.functionData.load(std::memory_order_acquire)) // created by another thread
+        return *functionData;
+    
+    if (functionName == nullptr)
+        functionName = getFunctionName(functionAddress);
+    
+    auto functionType = qiti::FunctionData::FunctionType::unknown; // default to unknown
+    if (functionTypeInt != -1)
+        functionType = static_cast<FunctionData::FunctionType>(functionTypeInt);
+    else if (functionName != nullptr)
+        functionType = qiti::FunctionData::getFunctionType(functionName);
+    
+    MallocHooks::ScopedBypassMallocHooks bypassMallocHooks;
+    
+    auto* functionData = new qiti::FunctionData(functionAddress,
+                                                functionName,
+                                                functionType);
+    entry.functionData.store(functionData, std::memory_order_release); // now owned by the registry
+    
+    return *functionData;
 }
 
 [[nodiscard]] const qiti::FunctionData* FunctionDataUtils::getFunctionData(const char* demangledFunctionName) noexcept
 {
-    auto& g_functionMap = getFunctionMap();
+    const std::string_view name(demangledFunctionName);
     
-    auto it = std::ranges::find_if(g_functionMap,
-                           [demangledFunctionName](const std::pair<const void*, const qiti::FunctionData&>& pair)
-                           {
-        return pair.second.getFunctionName() == std::string(demangledFunctionName);
-    });
+    DeferredEvents::drain(); // functions only called in deferred mode have no FunctionData yet
     
-    if (it == g_functionMap.end()) // function not found
-        return nullptr;
+    for (const auto* entry : FunctionRegistry::getAllEntries())
+    {
+        const auto* functionData = entry->functionData.load(std::memory_order_acquire);
+        if (functionData != nullptr && functionData->getFunctionName() == name)
+            return functionData;
+    }
     
-    return &(it->second);
+    return nullptr; // function not found
 }
 
 std::vector<const qiti::FunctionData*> FunctionDataUtils::getAllFunctionData() noexcept
 {
     std::vector<const qiti::FunctionData*> output;
     
-    auto& functionMap = getFunctionMap();
-    output.reserve(functionMap.size());
-    for (auto& entry : functionMap)
-        output.push_back(&entry.second);
+    DeferredEvents::drain(); // functions only called in deferred mode have no FunctionData yet
+    
+    const auto entries = FunctionRegistry::getAllEntries();
+    output.reserve(entries.size());
+    for (const auto* entry : entries)
+    {
+        if (const auto* functionData = entry->functionData.load(std::memory_order_acquire))
+            output.push_back(functionData);
+    }
     
     return output;
 }
@@ -242,7 +286,14 @@ void FunctionDataUtils::demangle(const char* mangled_name, char* demangled_name,
 
 void FunctionDataUtils::resetAll() noexcept
 {
-    getFunctionMap().clear();
+    DeferredEvents::reset(); // pending records refer to FunctionData about to be destroyed
+    ContextTree::reset();    // so do the nodes of calling-context trees
+    Timeline::reset();       // and timeline events
+    
+    {
+        ScopedFunctionDataCreationLock lock;
+        FunctionRegistry::clear(); // destroys all FunctionData
+    }
     
     Instrument::resetInstrumentation();
     Profile::resetProfiling();
@@ -81,6 +81,7 @@ public:
 private:
     friend class FunctionData;
     friend class Profile;
+    friend class DeferredEvents;
     friend struct FunctionDataUtilsTestAccess;
     
     /** */
@@ -16,11 +16,25 @@
 
 #include "qiti_FunctionData.hpp"
 
-#include <bitset>
+#include "qiti_CallHistory.hpp"
+#include "qiti_ContextTree.hpp"
+#include "qiti_FunctionCallData.hpp"
+#include "qiti_FunctionCallData_Impl.hpp"
+#include "qiti_LatencyHistogram.hpp"
+#include "qiti_PerfCounters.hpp"
+#include "qiti_ResourceUsageCounters.hpp"
+#include "qiti_Timeline.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
 #include <cstdint>
+#include <limits>
+#include <memory>
 #include <string>
 #include <thread>
 #include <unordered_set>
+#include <vector>
 
 //--------------------------------------------------------------------------
 // Doxygen - Begin Internal Documentation
@@ -34,30 +48,425 @@ struct FunctionData::Impl
 public:
     static constexpr const char* unknownFunctionName = "<unknown>";
     
+    /**
+     Which calls of a function get measured (timings, heap deltas, FunctionCallData).
+     Calls are always counted, whether they are sampled or not.
+     
+     8 bytes so it can be read with a single lock-free atomic load on every call.
+     */
+    struct SamplingRate
+    {
+        /** Sample one call in every interval calls. 0 = not set (per-function: use the default rate). */
+        uint32_t interval = 0;
+        /** If not 0, sample calls at random instead, each with a probability of randomThreshold / 2^32. */
+        uint32_t randomThreshold = 0;
+        
+        [[nodiscard]] bool isSet() const noexcept { return interval != 0 || randomThreshold != 0; }
+        
+        [[nodiscard]] static SamplingRate everyNthCall(uint32_t n) noexcept { return { std::max(n, 1u), 0 }; }
+        [[nodiscard]] static SamplingRate withProbability(double probability) noexcept;
+    };
+    
+    struct ThreadShard;
+    
+    /**
+     Sampled calls of a function made by one caller: a weighted edge of the call graph.
+     Only written by the thread owning the shard it belongs to.
+     */
+    struct CallerEdge
+    {
+        explicit CallerEdge(const FunctionData* callerFunction) noexcept
+        : caller(callerFunction) {}
+        
+        const FunctionData* const caller;
+        
+        std::atomic<uint64_t> numCalls{0};
+        std::atomic<uint64_t> totalTimeTicksWallClock{0}; // inclusive time of the callee, see Clock
+        std::atomic<uint64_t> totalTimeNanosecondsCpu{0};
+        std::atomic<uint64_t> numHeapAllocations{0};
+        std::atomic<uint64_t> amountHeapAllocated{0};
+        
+        /** Next edge into the same shard (intrusive, push-front list). */
+        CallerEdge* next = nullptr;
+    };
+    
+    /**
+     Mean and spread of a measurement, using Welford's online algorithm so it stays accurate
+     however many (and however large) samples are added. Merged with Chan et al.'s parallel update.
+     */
+    struct RunningStatistics
+    {
+        uint64_t count = 0;
+        double mean = 0.0;
+        double sumOfSquaredDeviations = 0.0; // from the mean ("M2")
+        
+        void merge(const RunningStatistics& other) noexcept;
+        
+        /** Sample variance, 0 with fewer than 2 samples. */
+        [[nodiscard]] double getVariance() const noexcept;
+    };
+    
+    /** RunningStatistics of a single writer, readable by other threads through relaxed atomics. */
+    class ShardStatistics
+    {
+    public:
+        /** Owning thread only. */
+        void add(double sample) noexcept;
+        
+        [[nodiscard]] RunningStatistics load() const noexcept;
+        
+    private:
+        std::atomic<uint64_t> count{0};
+        std::atomic<double> mean{0.0};
+        std::atomic<double> sumOfSquaredDeviations{0.0};
+    };
+    
+    /** Histograms of the durations of the sampled calls of a function, see LatencyHistogram::enabled. */
+    struct DurationHistograms
+    {
+        LatencyHistogram wallClockTicks; // see Clock
+        LatencyHistogram cpuNanoseconds;
+    };
+    
+    /** A profiled call in progress on a thread, and the samples taken when it was entered. */
+    struct CallFrame
+    {
+        ThreadShard* shard = nullptr;
+        const FunctionData* caller = nullptr;
+        CallerEdge* callerEdge = nullptr; // nullptr if there is no profiled caller
+        ContextTree::Node* contextNode = nullptr; // nullptr unless building calling-context trees
+        
+        uint64_t startTicksWallClock = 0; // see Clock
+        uint64_t startTimeCpu_ns = 0;
+        uint64_t amountHeapAllocatedBeforeFunctionCall = 0;
+        uint32_t numHeapAllocationsBeforeFunctionCall = 0;
+        
+        // Inclusive time of the completed (sampled) calls made by this call, subtracted for self time
+        uint64_t childTicksWallClock = 0;
+        uint64_t childTimeCpu_ns = 0;
+        
+        // Completed calls nested in this call at any depth, whose hooks' overhead is subtracted from it
+        uint32_t numNestedCalls = 0; // sampled
+        uint32_t numUnsampledNestedCalls = 0;
+        
+        // Measured time of slow hook paths nested in this call (e.g. creating a FunctionData, listeners), also subtracted
+        uint64_t hookOverheadTicksWallClock = 0;
+        uint64_t hookOverheadTimeCpu_ns = 0;
+        
+        // Whether the counters were read at the start of the call, see CallStack::getPerfCountersAtStart()
+        bool hasPerfCounters = false;
+        bool hasResourceUsage = false;
+        
+        uint32_t numExceptionsThrown = 0;
+        bool isSampled = true;
+    };
+    
+    /**
+     A thread's stack of profiled calls in progress (shadow call stack).
+     
+     Contiguous and of fixed capacity, so entering and exiting a function never allocates.
+     Too large for static TLS in every thread, it is created by a thread's first profiled call
+     (see getCallStack() in qiti_Profile.cpp), and the counters read at the start of the calls
+     are only created once PerfCounters or ResourceUsageCounters are enabled.
+     Calls nested deeper than capacity are still counted, but not measured (top() is nullptr).
+     */
+    class CallStack
+    {
+    public:
+        static constexpr size_t capacity = 256;
+        
+        [[nodiscard]] bool empty() const noexcept { return depth == 0; }
+        [[nodiscard]] size_t size() const noexcept { return depth; }
+        
+        /** @returns the innermost call, nullptr if there is none or if it overflowed the stack. */
+        [[nodiscard]] CallFrame* top() noexcept
+        {
+            return (depth > 0 && depth <= capacity) ? &frames[depth - 1] : nullptr;
+        }
+        
+        /** @returns the new innermost call to fill in, nullptr if it overflowed the stack. */
+        [[nodiscard]] CallFrame* push() noexcept
+        {
+            ++depth;
+            return (depth <= capacity) ? &frames[depth - 1] : nullptr;
+        }
+        
+        void pop() noexcept
+        {
+            if (depth > 0)
+                --depth;
+        }
+        
+        void clear() noexcept { depth = 0; }
+        
+        /** Where the PerfCounters are read at the start of frame, created on first use (hooks bypass malloc hooks). */
+        [[nodiscard]] PerfCounters::Values& getPerfCountersAtStart(const CallFrame& frame) noexcept;
+        
+        /** Where the ResourceUsageCounters are read at the start of frame, created on first use (hooks bypass malloc hooks). */
+        [[nodiscard]] ResourceUsageCounters::Values& getResourceUsageAtStart(const CallFrame& frame) noexcept;
+        
+        /** Replayed by DeferredEvents, so the listeners are not called within the calls' recorded times. */
+        bool isReplayed = false;
+        
+        /** Calling-context tree of this stack's calls, see ContextTree::getTree(). */
+        ContextTree* contextTree = nullptr;
+        uint64_t contextTreeGeneration = 0;
+        
+        /** Timeline buffer of this stack's calls, see Timeline::getBuffer(). */
+        Timeline::Buffer* timelineBuffer = nullptr;
+        uint64_t timelineGeneration = 0;
+        
+    private:
+        [[nodiscard]] size_t indexOf(const CallFrame& frame) const noexcept
+        {
+            return static_cast<size_t>(&frame - frames.data());
+        }
+        
+        size_t depth = 0;
+        std::array<CallFrame, capacity> frames{};
+        
+        // Indexed like frames, only read while PerfCounters::enabled / ResourceUsageCounters::enabled
+        std::unique_ptr<std::array<PerfCounters::Values, capacity>> perfCountersAtStart;
+        std::unique_ptr<std::array<ResourceUsageCounters::Values, capacity>> resourceUsageAtStart;
+    };
+    
+    /**
+     A completed call, published by one thread and safely readable by any other (seqlock).
+     
+     The writer never waits. Readers retry if the call was overwritten while they copied it,
+     so they never see a mix of two different calls.
+     */
+    class PublishedCall
+    {
+    public:
+        /** Single writer only (the thread owning the shard). */
+        void publish(const FunctionCallData::Impl& call) noexcept;
+        
+        /** @returns false if no call was published yet. */
+        [[nodiscard]] bool read(FunctionCallData::Impl& call) const noexcept;
+        
+    private:
+        static constexpr size_t numWords = (sizeof(FunctionCallData::Impl) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+        
+        std::atomic<uint32_t> sequence{0}; // odd while publishing, 0 if never published
+        std::array<std::atomic<uint64_t>, numWords> words{};
+    };
+    
+    /**
+     Per-thread accumulator for a single function.
+     
+     Each thread that calls a function gets its own shard, and only that thread ever
+     writes to it. This lets the instrumentation hooks update the data without taking
+     a lock. Readers on other threads see the counters through relaxed atomics, and
+     the FunctionData getters merge all shards together.
+     
+     A thread gives its shards back when it exits. They keep reporting its calls until a new
+     thread reuses its id, then the next thread calling the function adopts one (see
+     acquireThreadShard()) and counters simply carry on accumulating. As std::thread::id values
+     are recycled, shards don't pile up with short-lived threads.
+     */
+    struct ThreadShard
+    {
+        ThreadShard(FunctionData* ownerFunction, std::thread::id callingThread) noexcept
+        : owner(ownerFunction), threadId(callingThread) {}
+        ~ThreadShard() noexcept;
+        
+        FunctionData* const owner;
+        
+        /**
+         Thread writing to the shard. Kept after it exited, so its calls are still reported as made on it,
+         until a new thread reuses the id (then empty, see ThreadShardCache) or adopts the shard.
+         */
+        std::atomic<std::thread::id> threadId;
+        
+        /** False once the owning thread exited, until another thread adopts the shard. */
+        std::atomic<bool> isOwned{true};
+        
+        std::atomic<uint64_t> numTimesCalled{0};
+        std::atomic<uint64_t> numCallsSampled{0};
+        std::atomic<uint64_t> numCallsCompleted{0}; // sampled calls only, like the times below
+        std::atomic<uint64_t> totalTimeSpentInFunctionNanosecondsCpu{0};
+        std::atomic<uint64_t> totalTimeSpentInFunctionTicksWallClock{0}; // see Clock
+        std::atomic<uint64_t> totalSelfTimeNanosecondsCpu{0};
+        std::atomic<uint64_t> totalSelfTimeTicksWallClock{0};
+        
+        /** Minimums are std::numeric_limits<uint64_t>::max() until a call completed, as a call can take 0 after compensation. */
+        std::atomic<uint64_t> minTimeSpentInFunctionNanosecondsCpu{std::numeric_limits<uint64_t>::max()};
+        std::atomic<uint64_t> maxTimeSpentInFunctionNanosecondsCpu{0};
+        std::atomic<uint64_t> minTimeSpentInFunctionTicksWallClock{std::numeric_limits<uint64_t>::max()};
+        std::atomic<uint64_t> maxTimeSpentInFunctionTicksWallClock{0};
+        
+        std::atomic<uint64_t> numExceptionsThrown{0};
+        
+        /** Sum of the PerfCounters of the sampled calls, indexed by PerfCounter. */
+        std::array<std::atomic<uint64_t>, PerfCounters::numCounters> totalPerfCounters{};
+        
+        /** Sum of the ResourceUsage of the sampled calls, indexed by ResourceUsage. */
+        std::array<std::atomic<uint64_t>, ResourceUsageCounters::numCounters> totalResourceUsage{};
+        
+        ShardStatistics wallClockTicksStatistics{}; // see Clock
+        ShardStatistics cpuNanosecondsStatistics{};
+        
+        /** Edges from every function that called this function on this thread. */
+        std::atomic<CallerEdge*> callerEdges{nullptr};
+        
+        /** Owning thread only: edge of the most recent caller, which is most often the next caller too. */
+        CallerEdge* lastCallerEdge = nullptr;
+        
+        /** Last completed (sampled) call on this thread, copied from its CallFrame. */
+        PublishedCall lastCall{};
+        
+        /** Recent completed (sampled) calls, created on first use if CallHistory::capacityPerFunction > 0. */
+        std::atomic<CallHistory*> history{nullptr};
+        
+        /** Created by the first sampled call while LatencyHistogram::enabled, so the exit path never allocates. */
+        std::atomic<DurationHistograms*> histograms{nullptr};
+        
+        /** Owning thread only: unsampled calls left until the next sampled one (SamplingRate::interval). */
+        uint32_t numCallsUntilNextSample = 0;
+        
+        /** Next shard of the same function (intrusive, push-front list). */
+        ThreadShard* next = nullptr;
+        
+        /**
+         Starts a new call: counts it, notifies listeners and pushes it onto callStack.
+         Sampled calls are also linked to their caller (the top of callStack).
+         @returns the new call, for the caller to fill in the samples taken at function entry,
+                  or nullptr if this call is not sampled or overflowed callStack (nothing should be measured).
+         */
+        CallFrame* beginCall(CallStack& callStack) noexcept;
+        
+        /**
+         Completes the current (sampled) call with the samples taken at function exit, publishes it
+         as lastCall and pops it from callStack.
+         perfCountersAtEnd and resourceUsageAtEnd are nullptr if they were not read at function exit.
+         */
+        void endCall(CallStack& callStack,
+                     uint64_t endTicksWallClock,
+                     uint64_t endTimeCpu_ns,
+                     uint32_t numHeapAllocations,
+                     uint64_t amountHeapAllocated,
+                     const PerfCounters::Values* perfCountersAtEnd,
+                     const ResourceUsageCounters::Values* resourceUsageAtEnd) noexcept;
+        
+        /** Completes the current call when it was not sampled, and pops it from callStack. */
+        void endUnsampledCall(CallStack& callStack) noexcept;
+        
+        /** Counts an exception thrown by the current call (the top of callStack). */
+        static void exceptionThrown(CallStack& callStack) noexcept;
+        
+        /** Owning thread only, when it exits: lets another thread adopt the shard. */
+        void release() noexcept { isOwned.store(false, std::memory_order_release); }
+        
+    private:
+        [[nodiscard]] bool shouldSampleCall() noexcept;
+        
+        /** Owning thread only: the edge from caller, created on first use. */
+        [[nodiscard]] CallerEdge* getCallerEdge(const FunctionData* caller) noexcept;
+    };
+    
+    /** Counters of all thread shards merged together. */
+    struct MergedShards
+    {
+        uint64_t numTimesCalled = 0;
+        uint64_t numCallsSampled = 0;
+        uint64_t numCallsCompleted = 0;
+        uint64_t totalTimeSpentInFunctionNanosecondsCpu = 0;
+        uint64_t totalTimeSpentInFunctionTicksWallClock = 0;
+        uint64_t totalSelfTimeNanosecondsCpu = 0;
+        uint64_t totalSelfTimeTicksWallClock = 0;
+        uint64_t minTimeSpentInFunctionNanosecondsCpu = 0; // 0 if no call completed
+        uint64_t maxTimeSpentInFunctionNanosecondsCpu = 0;
+        uint64_t minTimeSpentInFunctionTicksWallClock = 0; // 0 if no call completed
+        uint64_t maxTimeSpentInFunctionTicksWallClock = 0;
+        uint64_t numExceptionsThrown = 0;
+        PerfCounters::Values totalPerfCounters{};
+        ResourceUsageCounters::Values totalResourceUsage{};
+        RunningStatistics wallClockTicksStatistics{};
+        RunningStatistics cpuNanosecondsStatistics{};
+        
+        /**
+         Scales a total measured over the sampled calls up to all calls.
+         Exact (returned as is) when every call was sampled.
+         */
+        [[nodiscard]] uint64_t estimateTotal(uint64_t sampledTotal) const noexcept;
+    };
+    
+    Impl() noexcept = default;
+    ~Impl() noexcept;
+    
+    /** Creates and publishes a new shard for the given thread. Safe to call concurrently. */
+    [[nodiscard]] ThreadShard* addThreadShard(FunctionData* owner,
+                                              std::thread::id threadId = std::this_thread::get_id()) noexcept;
+    
+    /**
+     Adopts a shard released by a thread that exited (once its id was reused) for the calling thread,
+     or adds a new one. Safe to call concurrently.
+     */
+    [[nodiscard]] ThreadShard* acquireThreadShard(FunctionData* owner) noexcept;
+    
+    /** Appends a column of the call history of all threads (in no particular order). */
+    void copyCallHistoryColumn(CallHistory::Column column, std::vector<uint64_t>& values) const noexcept;
+    
+    /** Edges from every caller of this function (callee), merged across threads. Unordered. */
+    [[nodiscard]] std::vector<CallEdge> mergeCallerEdges(const FunctionData* callee) const noexcept;
+    
+    /** Merges the given histogram of all threads into merged. */
+    void mergeDurationHistograms(LatencyHistogram DurationHistograms::* histogram, LatencyHistogram& merged) const noexcept;
+    
+    /**
+     Most recent completed call of all threads, or of a single thread if thread is not nullptr.
+     Safe to call while other threads are updating their shards.
+     */
+    [[nodiscard]] FunctionCallData getLastCall(const std::thread::id* thread) const noexcept;
+    
+    /** Sums/min/max all shards. Safe to call while other threads are updating their shards. */
+    [[nodiscard]] MergedShards mergeThreadShards() const noexcept;
+    
+    /** Single-writer increment, only to be called from the thread owning the counter. */
+    static void addToShardCounter(std::atomic<uint64_t>& counter, uint64_t value) noexcept
+    {
+        counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+    }
+    
     const char* functionName = unknownFunctionName;
     const void* address = nullptr;
     
-    uint64_t numTimesCalled = 0;
-    uint64_t averageTimeSpentInFunctionNanosecondsCpu = 0;
-    uint64_t averageTimeSpentInFunctionNanosecondsWallClock = 0;
+    /** One shard per thread that called the function, reused after it exited (push-front list, never shrinks until destroyed). */
+    std::atomic<ThreadShard*> threadShards{nullptr};
+    
+    FunctionType functionType = FunctionType::regular;
     
-    uint64_t minTimeSpentInFunctionNanosecondsCpu = 0;
-    uint64_t maxTimeSpentInFunctionNanosecondsCpu = 0;
-    uint64_t minTimeSpentInFunctionNanosecondsWallClock = 0;
-    uint64_t maxTimeSpentInFunctionNanosecondsWallClock = 0;
+    /** Rate set for this function only, overriding defaultSamplingRate when set. */
+    std::atomic<SamplingRate> samplingRate{};
     
-    static constexpr size_t MAX_THREADS = 256;
-    std::bitset<MAX_THREADS> threadsCalledOn;
+    /** Rate of all functions without their own rate. Every call by default. */
+    QITI_API_VAR static std::atomic<SamplingRate> defaultSamplingRate;
     
-    FunctionType functionType = FunctionType::regular;
+    /**
+     Time the hooks of a (sampled) profiled call add to the measured time of every profiled
+     call it is nested in, measured by Profile::calibrateOverhead().
+     */
+    QITI_API_VAR static std::atomic<uint64_t> overheadTicksWallClockPerNestedCall;
+    QITI_API_VAR static std::atomic<uint64_t> overheadNanosecondsCpuPerNestedCall;
     
-    std::unordered_set<FunctionData::Listener*> listeners{};
-    std::unordered_set<const FunctionData*> callers{};
+    /** Same for a call that was not sampled (only counted), measured by Profile::calibrateOverhead(). */
+    QITI_API_VAR static std::atomic<uint64_t> overheadTicksWallClockPerUnsampledNestedCall;
+    QITI_API_VAR static std::atomic<uint64_t> overheadNanosecondsCpuPerUnsampledNestedCall;
+    
+    /** Time measured for a call of an empty function, measured by Profile::calibrateOverhead(). */
+    QITI_API_VAR static std::atomic<uint64_t> emptyCallTicksWallClock;
+    QITI_API_VAR static std::atomic<uint64_t> emptyCallNanosecondsCpu;
     
-    uint64_t numExceptionsThrown = 0;
+    /** Whether the overhead of nested calls is subtracted from measured times (default). */
+    QITI_API_VAR static std::atomic<bool> compensateOverhead;
     
-    FunctionCallData lastCallData{};
+    std::unordered_set<FunctionData::Listener*> listeners{};
 };
+
+// Thread-local call stack to track caller relationships, nullptr until the thread's first profiled call
+extern constinit thread_local FunctionData::Impl::CallStack* g_callStack;
+
 } // namespace qiti
 
 //--------------------------------------------------------------------------
@@ -0,0 +1,227 @@
+
+/******************************************************************************
+ * Qiti — C++ Profiling Library
+ *
+ * @file     qiti_FunctionFilter.cpp
+ *
+ * @author   Adam Shield
+ * @date     2026-10-16
+ *
+ * @copyright (c) 2025 Adam Shield
+ * SPDX-License-Identifier: MIT
+ *
+ * See LICENSE.txt for license terms.
+ ******************************************************************************/
+
+#include "qiti_FunctionFilter.hpp"
+
+#include "qiti_FunctionDataUtils.hpp" // dladdr() (Windows equivalent on Windows)
+#include "qiti_FunctionRegistry.hpp"
+#include "qiti_LockHooks.hpp"
+#include "qiti_MallocHooks.hpp"
+
+#ifdef _WIN32
+#include <windows.h>
+#include <dbghelp.h>
+#else
+#include <cxxabi.h>
+#include <dlfcn.h>
+#endif
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+//--------------------------------------------------------------------------
+
+using MutexType = std::mutex;
+using LockType = std::scoped_lock<MutexType>;
+
+/** Rules are only read on the (once per function) slow path, so a plain mutex is fine. */
+static MutexType g_rulesLock;
+
+struct FilterRules
+{
+    std::vector<qiti::FunctionFilter::GlobPattern> includeFunctions;
+    std::vector<qiti::FunctionFilter::GlobPattern> excludeFunctions;
+    std::vector<qiti::FunctionFilter::GlobPattern> includeModules;
+    std::vector<qiti::FunctionFilter::GlobPattern> excludeModules;
+};
+
+[[nodiscard]] static FilterRules& getRules() noexcept
+{
+    static FilterRules rules;
+    return rules;
+}
+
+[[nodiscard]] static bool matchesAny(const std::vector<qiti::FunctionFilter::GlobPattern>& patterns,
+                                     std::string_view text) noexcept
+{
+    return std::ranges::any_of(patterns,
+                               [text](const qiti::FunctionFilter::GlobPattern& pattern)
+                               {
+                                   return pattern.matches(text);
+                               });
+}
+
+/** Decisions cached with the previous rules are now stale. */
+static void clearCachedDecisions() noexcept
+{
+    for (auto* entry : qiti::FunctionRegistry::getAllEntries())
+        entry->filterDecision.store(qiti::FunctionRegistry::FilterDecision::unknown, std::memory_order_relaxed);
+}
+
+//--------------------------------------------------------------------------
+
+namespace qiti
+{
+
+FunctionFilter::GlobPattern::GlobPattern(std::string_view pattern) noexcept
+{
+    MallocHooks::ScopedBypassMallocHooks bypassMallocHooks;
+
+    anchoredAtStart = ! pattern.starts_with('*');
+    anchoredAtEnd   = ! pattern.ends_with('*');
+
+    size_t start = 0;
+    while (start <= pattern.size())
+    {
+        auto end = pattern.find('*', start);
+        if (end == std::string_view::npos)
+            end = pattern.size();
+
+        if (end > start || segments.empty()) // keep a single empty segment for an empty pattern
+            segments.emplace_back(pattern.substr(start, end - start));
+
+        start = end + 1;
+    }
+
+    // Collapse the empty placeholder segment of patterns made only of '*'
+    if (segments.size() == 1 && segments.front().empty() && ! anchoredAtStart)
+        segments.clear();
+}
+
+bool FunctionFilter::GlobPattern::matches(std::string_view text) const noexcept
+{
+    size_t pos = 0;
+
+    for (size_t i = 0; i < segments.size(); ++i)
+    {
+        const std::string_view segment = segments[i];
+        const bool isFirst = (i == 0);
+        const bool isLast  = (i == segments.size() - 1);
+
+        if (isFirst && anchoredAtStart)
+        {
+            if (! text.starts_with(segment))
+                return false;
+            pos = segment.size();
+        }
+        else if (isLast && anchoredAtEnd)
+        {
+            // Suffix must not overlap what was already matched
+            return text.size() >= pos + segment.size() && text.ends_with(segment);
+        }
+        else
+        {
+            const auto found = text.find(segment, pos);
+            if (found == std::string_view::npos)
+                return false;
+            pos = found + segment.size();
+        }
+    }
+
+    return ! anchoredAtEnd || pos == text.size();
+}
+
+void FunctionFilter::addRule(RuleType type, const char* pattern) noexcept
+{
+    if (pattern == nullptr)
+        return;
+
+    MallocHooks::ScopedBypassMallocHooks bypassMallocHooks;
+
+    {
+        qiti::LockHooks::LockBypassingHook<LockType, MutexType> lock(g_rulesLock);
+
+        auto& rules = getRules();
+        switch (type)
+        {
+            case RuleType::includeFunctions: rules.includeFunctions.emplace_back(pattern); break;
+            case RuleType::excludeFunctions: rules.excludeFunctions.emplace_back(pattern); break;
+            case RuleType::includeModules:   rules.includeModules.emplace_back(pattern);   break;
+            case RuleType::excludeModules:   rules.excludeModules.emplace_back(pattern);   break;
+        }
+    }
+
+    clearCachedDecisions();
+}
+
+void FunctionFilter::clearRules() noexcept
+{
+    MallocHooks::ScopedBypassMallocHooks bypassMallocHooks;
+
+    {
+        qiti::LockHooks::LockBypassingHook<LockType, MutexType> lock(g_rulesLock);
+        getRules() = {};
+    }
+
+    clearCachedDecisions();
+}
+
+bool FunctionFilter::shouldProfile(const void* functionAddress) noexcept
+{
+    MallocHooks::ScopedBypassMallocHooks bypassMallocHooks;
+
+    Dl_info info;
+    if (! dladdr(functionAddress, &info))
+        return true; // nothing to match rules against
+
+    std::string functionName;
+    if (info.dli_sname != nullptr)
+    {
+#ifdef _WIN32
+        // Windows: Use UnDecorateSymbolName for demangling
+        char buffer[1024];
+        if (UnDecorateSymbolName(info.dli_sname, buffer, sizeof(buffer), UNDNAME_COMPLETE))
+            functionName = buffer;
+        else
+            functionName = info.dli_sname;
+#else
+        int status = 0;
+        char* demangled = abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status);
+        if (status == 0 && demangled)
+            functionName = demangled;
+        else
+            functionName = info.dli_sname;
+        std::free(demangled);
+#endif
+    }
+
+    // Always skip templated functions that use qiti types as template parameters
+    // (e.g. std::vector<qiti::FunctionData*>)
+    if (functionName.find("<qiti::") != std::string::npos)
+        return false;
+
+    const std::string_view moduleName = (info.dli_fname != nullptr) ? info.dli_fname : "";
+
+    qiti::LockHooks::LockBypassingHook<LockType, MutexType> lock(g_rulesLock);
+    const auto& rules = getRules();
+
+    if (matchesAny(rules.excludeFunctions, functionName) || matchesAny(rules.excludeModules, moduleName))
+        return false;
+
+    if (! rules.includeFunctions.empty() && ! matchesAny(rules.includeFunctions, functionName))
+        return false;
+
+    if (! rules.includeModules.empty() && ! matchesAny(rules.includeModules, moduleName))
+        return false;
+
+    return true;
+}
+
+} // namespace qiti
@@ -0,0 +1,90 @@
+/******************************************************************************
+ * Qiti — C++ Profiling Library
+ *
+ * @file     qiti_FunctionFilter.hpp
+ *
+ * @author   Adam Shield
+ * @date     2026-10-16
+ *
+ * @copyright (c) 2025 Adam Shield
+ * SPDX-License-Identifier: MIT
+ *
+ * See LICENSE.txt for license terms.
+ ******************************************************************************/
+
+#pragma once
+
+#include "qiti_API.hpp"
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+//--------------------------------------------------------------------------
+// Doxygen - Begin Internal Documentation
+/** \cond INTERNAL */
+//--------------------------------------------------------------------------
+
+namespace qiti
+{
+//--------------------------------------------------------------------------
+/**
+ User rules deciding which functions are profiled while profiling all functions.
+
+ Rules are '*' globs matched against either the demangled function name
+ (e.g. "myproject::*", "std::*") or the path of the module (executable/shared library)
+ containing the function, as reported by dladdr() (e.g. "*libmyproject*").
+
+ A function is profiled unless it matches any exclusion, and, if there are any
+ inclusion rules of a given kind, it must also match at least one of them.
+
+ Evaluating the rules is expensive (dladdr + demangling), which is why the result is
+ computed once per address and cached in the FunctionRegistry (see
+ FunctionRegistry::Entry::filterDecision). Changing the rules clears the cached results.
+
+ @note This class is designed for internal use by the Qiti profiling system.
+ */
+class FunctionFilter
+{
+public:
+    enum class RuleType
+    {
+        includeFunctions,
+        excludeFunctions,
+        includeModules,
+        excludeModules
+    };
+
+    /** A '*' glob, split once into its literal segments so matching never re-parses the pattern. */
+    class GlobPattern
+    {
+    public:
+        QITI_API explicit GlobPattern(std::string_view pattern) noexcept;
+
+        [[nodiscard]] QITI_API bool matches(std::string_view text) const noexcept;
+
+    private:
+        std::vector<std::string> segments;
+        bool anchoredAtStart = true; // pattern does not start with '*'
+        bool anchoredAtEnd   = true; // pattern does not end with '*'
+    };
+
+    /** Adds a rule and clears all cached decisions. */
+    QITI_API_INTERNAL static void addRule(RuleType type, const char* pattern) noexcept;
+
+    /** Removes all rules and clears all cached decisions. */
+    QITI_API_INTERNAL static void clearRules() noexcept;
+
+    /** Evaluate all rules (slow, see class description). */
+    [[nodiscard]] QITI_API_INTERNAL static bool shouldProfile(const void* functionAddress) noexcept;
+
+    // Deleted constructors/destructors
+    FunctionFilter() = delete;
+    ~FunctionFilter() = delete;
+}; // class FunctionFilter
+} // namespace qiti
+
+//--------------------------------------------------------------------------
+/** \endcond */
+// Doxygen - End Internal Documentation
+//--------------------------------------------------------------------------
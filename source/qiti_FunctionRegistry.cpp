@@ -0,0 +1,229 @@
+
+/******************************************************************************
+ * Qiti — C++ Profiling Library
+ *
+ * @file     qiti_FunctionRegistry.cpp
+ *
+ * @author   Adam Shield
+ * @date     2026-10-16
+ *
+ * @copyright (c) 2025 Adam Shield
+ * SPDX-License-Identifier: MIT
+ *
+ * See LICENSE.txt for license terms.
+ ******************************************************************************/
+
+#include "qiti_FunctionRegistry.hpp"
+
+#include "qiti_FunctionData.hpp"
+#include "qiti_LockHooks.hpp"
+#include "qiti_MallocHooks.hpp"
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+//--------------------------------------------------------------------------
+
+namespace
+{
+/** One open-addressing slot. The address is duplicated here so probing never dereferences an Entry. */
+struct Slot
+{
+    std::atomic<const void*> address{nullptr};
+    qiti::FunctionRegistry::Entry* entry = nullptr; // written before address is published
+};
+
+struct Table
+{
+    explicit Table(size_t capacity) noexcept
+    : mask(capacity - 1), slots(std::make_unique<Slot[]>(capacity))
+    {
+        assert((capacity & mask) == 0 && "Capacity must be a power of two");
+    }
+
+    [[nodiscard]] size_t capacity() const noexcept { return mask + 1; }
+
+    const size_t mask;
+    const std::unique_ptr<Slot[]> slots;
+};
+
+/** Large enough that a typical test never grows the table. Must be a power of two. */
+constexpr size_t initialCapacity = 1024;
+
+/** Grow once more than half of the slots are used, to keep probe sequences short. */
+constexpr size_t maxLoadFactorDenominator = 2;
+
+/** Read on every lookup, only ever replaced under g_insertMutex. */
+constinit std::atomic<Table*> g_table{nullptr};
+
+constinit std::mutex g_insertMutex;
+
+/** Everything that is only touched while holding g_insertMutex. */
+struct RegistryStorage
+{
+    /** Current table is always tables.back(). Older tables are kept alive for concurrent readers. */
+    std::vector<std::unique_ptr<Table>> tables;
+    std::vector<std::unique_ptr<qiti::FunctionRegistry::Entry>> entries;
+};
+
+[[nodiscard]] RegistryStorage& getStorage() noexcept
+{
+    static RegistryStorage storage;
+    return storage;
+}
+
+/** Pointers are aligned, so mix the bits (Murmur3 finalizer) before masking. */
+[[nodiscard]] inline size_t hashAddress(const void* address) noexcept
+{
+    auto h = static_cast<uint64_t>(reinterpret_cast<uintptr_t>(address));
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    return static_cast<size_t>(h);
+}
+
+[[nodiscard]] qiti::FunctionRegistry::Entry* findInTable(const Table& table, const void* address) noexcept
+{
+    for (size_t i = hashAddress(address) & table.mask; ; i = (i + 1) & table.mask)
+    {
+        auto& slot = table.slots[i];
+        const auto* slotAddress = slot.address.load(std::memory_order_acquire);
+        if (slotAddress == address)
+            return slot.entry;
+        if (slotAddress == nullptr)
+            return nullptr; // never registered (no deletions, so an empty slot ends the probe)
+    }
+}
+
+/** Caller must hold g_insertMutex and guarantee the table has a free slot. */
+void insertIntoTable(Table& table, qiti::FunctionRegistry::Entry* entry) noexcept
+{
+    for (size_t i = hashAddress(entry->address) & table.mask; ; i = (i + 1) & table.mask)
+    {
+        auto& slot = table.slots[i];
+        if (slot.address.load(std::memory_order_relaxed) == nullptr)
+        {
+            slot.entry = entry;
+            slot.address.store(entry->address, std::memory_order_release); // publish
+            return;
+        }
+    }
+}
+
+/** Locks the registry without reporting the lock to LockData listeners. */
+class ScopedInsertLock
+{
+public:
+    ScopedInsertLock() noexcept
+    : previousBypassState(qiti::LockHooks::bypassLockHooks)
+    {
+        qiti::LockHooks::bypassLockHooks = true;
+        g_insertMutex.lock();
+    }
+
+    ~ScopedInsertLock() noexcept
+    {
+        g_insertMutex.unlock();
+        qiti::LockHooks::bypassLockHooks = previousBypassState;
+    }
+
+private:
+    const bool previousBypassState;
+};
+} // namespace
+
+//--------------------------------------------------------------------------
+
+namespace qiti
+{
+
+std::atomic<uint64_t> FunctionRegistry::generation{0};
+
+FunctionRegistry::Entry* FunctionRegistry::find(const void* address) noexcept
+{
+    const auto* table = g_table.load(std::memory_order_acquire);
+    if (table == nullptr)
+        return nullptr;
+
+    return findInTable(*table, address);
+}
+
+FunctionRegistry::Entry& FunctionRegistry::findOrInsert(const void* address) noexcept
+{
+    assert(address != nullptr && "nullptr is used to mark empty slots");
+
+    MallocHooks::ScopedBypassMallocHooks bypassMallocHooks;
+    ScopedInsertLock lock;
+
+    auto& storage = getStorage();
+
+    auto* table = g_table.load(std::memory_order_relaxed);
+    if (table != nullptr)
+    {
+        if (auto* existing = findInTable(*table, address))
+            return *existing;
+    }
+
+    // Grow (or create) the table first if needed
+    const auto numEntries = storage.entries.size();
+    if (table == nullptr || (numEntries + 1) * maxLoadFactorDenominator > table->capacity())
+    {
+        const auto newCapacity = (table == nullptr) ? initialCapacity : table->capacity() * 2;
+        auto& newTable = storage.tables.emplace_back(std::make_unique<Table>(newCapacity));
+        for (auto& entry : storage.entries)
+            insertIntoTable(*newTable, entry.get());
+
+        table = newTable.get();
+        g_table.store(table, std::memory_order_release); // old table stays valid for in-flight readers
+    }
+
+    auto& entry = storage.entries.emplace_back(std::make_unique<Entry>(address, static_cast<uint32_t>(numEntries)));
+    insertIntoTable(*table, entry.get());
+
+    return *entry;
+}
+
+std::vector<FunctionRegistry::Entry*> FunctionRegistry::getAllEntries() noexcept
+{
+    MallocHooks::ScopedBypassMallocHooks bypassMallocHooks;
+    ScopedInsertLock lock;
+
+    const auto& entries = getStorage().entries;
+
+    std::vector<Entry*> output;
+    output.reserve(entries.size());
+    for (const auto& entry : entries)
+        output.push_back(entry.get());
+
+    return output;
+}
+
+uint32_t FunctionRegistry::size() noexcept
+{
+    ScopedInsertLock lock;
+
+    return static_cast<uint32_t>(getStorage().entries.size());
+}
+
+void FunctionRegistry::clear() noexcept
+{
+    MallocHooks::ScopedBypassMallocHooks bypassMallocHooks;
+    ScopedInsertLock lock;
+
+    auto& storage = getStorage();
+
+    g_table.store(nullptr, std::memory_order_release);
+    generation.fetch_add(1, std::memory_order_acq_rel);
+
+    for (auto& entry : storage.entries)
+        delete entry->functionData.exchange(nullptr, std::memory_order_acq_rel);
+
+    storage.entries.clear();
+    storage.tables.clear();
+}
+
+} // namespace qiti
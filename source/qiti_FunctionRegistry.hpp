@@ -0,0 +1,127 @@
+/******************************************************************************
+ * Qiti — C++ Profiling Library
+ *
+ * @file     qiti_FunctionRegistry.hpp
+ *
+ * @author   Adam Shield
+ * @date     2026-10-16
+ *
+ * @copyright (c) 2025 Adam Shield
+ * SPDX-License-Identifier: MIT
+ *
+ * See LICENSE.txt for license terms.
+ ******************************************************************************/
+
+#pragma once
+
+#include "qiti_API.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+//--------------------------------------------------------------------------
+// Doxygen - Begin Internal Documentation
+/** \cond INTERNAL */
+//--------------------------------------------------------------------------
+
+namespace qiti
+{
+//--------------------------------------------------------------------------
+class FunctionData;
+//--------------------------------------------------------------------------
+/**
+ Address -> function lookup table queried by the instrumentation hooks.
+
+ A flat, open-addressed (linear probing) hash table. Each registered function
+ address has exactly one Entry, holding both whether the function is explicitly
+ profiled and its FunctionData (if any), so a hook only needs a single lookup.
+
+ Lookups are lock-free and may run concurrently with insertions from other threads.
+ Insertions are serialized internally. When the table grows, a larger table is
+ published and the old one is kept alive until clear(), so in-flight lookups never
+ read freed memory.
+
+ @note This class is designed for internal use by the Qiti profiling system.
+ */
+class FunctionRegistry
+{
+public:
+    /** Cached result of the FunctionFilter rules for one address. */
+    enum class FilterDecision : uint8_t
+    {
+        unknown,  // rules not evaluated yet (or changed since)
+        included,
+        excluded
+    };
+    
+    /** A registered function address. Entries never move and are only freed by clear(). */
+    struct Entry
+    {
+        QITI_API_INTERNAL Entry(const void* functionAddress, uint32_t registrationIndex) noexcept
+        : address(functionAddress), index(registrationIndex) {}
+
+        const void* const address;
+
+        /** Dense index in registration order (0, 1, 2, ...), used to index per-thread arrays. */
+        const uint32_t index;
+
+        /** True while the function is explicitly profiled (see Profile::beginProfilingFunction()). */
+        std::atomic<bool> isProfiled{false};
+
+        /** Owned by the registry. nullptr until FunctionDataUtils creates it. */
+        std::atomic<FunctionData*> functionData{nullptr};
+
+        /**
+         Whether the function passes the FunctionFilter rules, only used while profiling all functions.
+         Functions that are excluded still get an entry (without FunctionData), so the rules are only
+         evaluated once per address.
+         */
+        std::atomic<FilterDecision> filterDecision{FilterDecision::unknown};
+    };
+
+    /**
+     Lock-free lookup, safe to call concurrently with findOrInsert().
+     @returns nullptr if the address was never registered.
+     */
+    [[nodiscard]] QITI_API static Entry* find(const void* address) noexcept;
+
+    /** @returns the existing entry for the address, or registers a new one. */
+    [[nodiscard]] QITI_API static Entry& findOrInsert(const void* address) noexcept;
+
+    /** Snapshot of all entries, in registration order. */
+    [[nodiscard]] QITI_API_INTERNAL static std::vector<Entry*> getAllEntries() noexcept;
+
+    /** Number of registered addresses. */
+    [[nodiscard]] QITI_API static uint32_t size() noexcept;
+
+    /**
+     Frees all entries (and their FunctionData).
+
+     Must not be called while other threads may still be inside an instrumentation hook.
+     */
+    QITI_API static void clear() noexcept;
+
+    /**
+     Incremented every time the registry is cleared.
+
+     Lets thread-local caches of Entry/FunctionData pointers detect that they are stale.
+     */
+    [[nodiscard]] QITI_API_INTERNAL static uint64_t getGeneration() noexcept
+    {
+        return generation.load(std::memory_order_acquire);
+    }
+
+    // Deleted constructors/destructors
+    FunctionRegistry() = delete;
+    ~FunctionRegistry() = delete;
+
+private:
+    QITI_API_VAR static std::atomic<uint64_t> generation;
+}; // class FunctionRegistry
+} // namespace qiti
+
+//--------------------------------------------------------------------------
+/** \endcond */
+// Doxygen - End Internal Documentation
+//--------------------------------------------------------------------------
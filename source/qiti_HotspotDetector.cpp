@@ -14,6 +14,8 @@
 
 #include "qiti_HotspotDetector.hpp"
 
+#include "qiti_Clock.hpp"
+#include "qiti_FunctionData_Impl.hpp"
 #include "qiti_MallocHooks.hpp"
 #include "qiti_Profile.hpp"
 #include "qiti_ScopedNoHeapAllocations.hpp"
@@ -35,10 +37,10 @@ std::vector<HotspotDetector::Hotspot> HotspotDetector::detectHotspots() noexcept
     return detectHotspots(0.0); // No threshold - return all functions
 }
 
-std::vector<HotspotDetector::Hotspot> HotspotDetector::detectHotspots(Sensitivity sensitivity) noexcept
+std::vector<HotspotDetector::Hotspot> HotspotDetector::detectHotspots(Sensitivity sensitivity, Ranking ranking) noexcept
 {
     // First get all hotspots sorted by score
-    auto allHotspots = detectHotspots(0.0);
+    auto allHotspots = detectHotspots(0.0, ranking);
     
     if (allHotspots.empty() || sensitivity == Sensitivity::ALL)
         return allHotspots;
@@ -76,7 +78,7 @@ std::vector<HotspotDetector::Hotspot> HotspotDetector::detectHotspots(Sensitivit
     return result;
 }
 
-std::vector<HotspotDetector::Hotspot> HotspotDetector::detectHotspots(double scoreThreshold) noexcept
+std::vector<HotspotDetector::Hotspot> HotspotDetector::detectHotspots(double scoreThreshold, Ranking ranking) noexcept
 {
     qiti::Profile::ScopedDisableProfiling disableProfiling;
     qiti::MallocHooks::ScopedBypassMallocHooks bypassMallocHooks;
@@ -93,7 +95,7 @@ std::vector<HotspotDetector::Hotspot> HotspotDetector::detectHotspots(double sco
         if (func == nullptr)
             continue;
             
-        double score = calculateHotspotScore(func);
+        double score = calculateHotspotScore(func, ranking);
         
         // Only include functions above the threshold
         if (score >= scoreThreshold)
@@ -117,7 +119,7 @@ std::vector<HotspotDetector::Hotspot> HotspotDetector::detectHotspots(double sco
     return hotspots;
 }
 
-double HotspotDetector::calculateHotspotScore(const FunctionData* func) noexcept
+double HotspotDetector::calculateHotspotScore(const FunctionData* func, Ranking ranking) noexcept
 {
     qiti::Profile::ScopedDisableProfiling disableProfiling;
     qiti::ScopedNoHeapAllocations noAllocs;
@@ -125,20 +127,20 @@ double HotspotDetector::calculateHotspotScore(const FunctionData* func) noexcept
     if (func == nullptr)
         return 0.0;
     
-    // Calculate total time spent = number of calls × average time per call
-    uint64_t numCalls = func->getNumTimesCalled();
+    // Total time spent, summed across all threads' shards (and scaled up to all calls when sampling)
+    const auto merged = func->getImpl()->mergeThreadShards();
+    if (merged.numTimesCalled == 0)
+        return 0.0;
+    
+    const bool isSelfTime = (ranking == Ranking::selfTime);
 #ifdef _WIN32 // CPU Time feature not supported on Windows
-    uint64_t avgTime = func->getAverageTimeSpentInFunctionWallClock_ns();
+    uint64_t totalTime = Clock::ticksToNanoseconds(merged.estimateTotal(isSelfTime ? merged.totalSelfTimeTicksWallClock
+                                                                                   : merged.totalTimeSpentInFunctionTicksWallClock));
 #else
-    uint64_t avgTime = func->getAverageTimeSpentInFunctionCpu_ns();
+    uint64_t totalTime = merged.estimateTotal(isSelfTime ? merged.totalSelfTimeNanosecondsCpu
+                                                         : merged.totalTimeSpentInFunctionNanosecondsCpu);
 #endif
     
-    if (numCalls == 0)
-        return 0.0;
-    
-    // Total time in nanoseconds
-    uint64_t totalTime = numCalls * avgTime;
-    
     // Convert to double (score represents total nanoseconds)
     return static_cast<double>(totalTime);
 }
@@ -152,18 +154,25 @@ std::string HotspotDetector::getHotspotReason(const FunctionData* func) noexcept
     
     std::ostringstream reason;
     
-    uint64_t numCalls = func->getNumTimesCalled();
+    const auto merged = func->getImpl()->mergeThreadShards();
+    uint64_t numCalls = merged.numTimesCalled;
 #ifdef _WIN32 // CPU Time feature not supported on Windows
-    uint64_t avgTime = func->getAverageTimeSpentInFunctionWallClock_ns();
-    uint64_t maxTime = func->getMaxTimeSpentInFunctionWallClock_ns();
+    uint64_t sampledTotalTime = Clock::ticksToNanoseconds(merged.totalTimeSpentInFunctionTicksWallClock);
+    uint64_t sampledSelfTime = Clock::ticksToNanoseconds(merged.totalSelfTimeTicksWallClock);
+    uint64_t maxTime = Clock::ticksToNanoseconds(merged.maxTimeSpentInFunctionTicksWallClock);
 #else
-    uint64_t avgTime = func->getAverageTimeSpentInFunctionCpu_ns();
-    uint64_t maxTime = func->getMaxTimeSpentInFunctionCpu_ns();
+    uint64_t sampledTotalTime = merged.totalTimeSpentInFunctionNanosecondsCpu;
+    uint64_t sampledSelfTime = merged.totalSelfTimeNanosecondsCpu;
+    uint64_t maxTime = merged.maxTimeSpentInFunctionNanosecondsCpu;
 #endif
-    uint64_t totalTime = numCalls * avgTime;
+    uint64_t totalTime = merged.estimateTotal(sampledTotalTime);
+    uint64_t selfTime = merged.estimateTotal(sampledSelfTime);
+    uint64_t avgTime = (merged.numCallsCompleted > 0) ? (sampledTotalTime / merged.numCallsCompleted) : 0;
+    const bool isSampled = merged.numCallsSampled < merged.numTimesCalled;
     
     // Primary reason - total time consumption
-    reason << "Total time: " << (totalTime / 1000000) << "ms";
+    reason << "Total time: " << (isSampled ? "~" : "") << (totalTime / 1000000) << "ms";
+    reason << ", self: " << (isSampled ? "~" : "") << (selfTime / 1000000) << "ms";
     
     // Add details about call frequency
     reason << " (" << numCalls << " calls";
@@ -179,6 +188,9 @@ std::string HotspotDetector::getHotspotReason(const FunctionData* func) noexcept
     
     reason << ")";
     
+    if (isSampled)
+        reason << " [sampled " << merged.numCallsSampled << " of " << numCalls << " calls]";
+    
     // Add special characteristics
     if (func->getNumExceptionsThrown() > 0)
         reason << " [" << func->getNumExceptionsThrown() << " exceptions]";
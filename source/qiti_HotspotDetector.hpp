@@ -65,6 +65,15 @@ public:
         ALL      ///< Detect all functions with any execution time (equivalent to no threshold)
     };
     
+    /**
+     Which time functions are ranked by.
+     */
+    enum class Ranking
+    {
+        totalTime, ///< Inclusive time: everything between entry and exit, so drivers (e.g. main) rank highest
+        selfTime   ///< Exclusive time: minus the time spent in profiled callees, so leaf functions doing the work rank highest
+    };
+    
     /**
      Represents a detected performance hotspot.
      */
@@ -92,8 +101,10 @@ public:
      
      @param sensitivity The sensitivity level for hotspot detection. 
      Recommended for general performance analysis.
+     @param ranking Whether to rank by total (inclusive) or self (exclusive) time.
      */
-    [[nodiscard]] QITI_API static std::vector<Hotspot> detectHotspots(Sensitivity sensitivity) noexcept;
+    [[nodiscard]] QITI_API static std::vector<Hotspot> detectHotspots(Sensitivity sensitivity,
+                                                                      Ranking ranking = Ranking::totalTime) noexcept;
     
     /**
      @returns A vector of detected hotspots above the specified threshold.
@@ -109,17 +120,21 @@ public:
      - 1,000,000,000 (1s total) - High threshold
      
      Use this when you need precise control over the threshold value.
+     
+     @param ranking Whether to rank by total (inclusive) or self (exclusive) time.
      */
-    [[nodiscard]] QITI_API static std::vector<Hotspot> detectHotspots(double scoreThreshold) noexcept;
+    [[nodiscard]] QITI_API static std::vector<Hotspot> detectHotspots(double scoreThreshold,
+                                                                      Ranking ranking = Ranking::totalTime) noexcept;
     
 private:
     /**
      Calculate the hotspot score for a given function.
      
      @param func The function to analyze
+     @param ranking Whether to score total (inclusive) or self (exclusive) time
      @returns A hotspot score based on total time consumption (calls × average time)
      */
-    [[nodiscard]] QITI_API_INTERNAL static double calculateHotspotScore(const FunctionData* func) noexcept;
+    [[nodiscard]] QITI_API_INTERNAL static double calculateHotspotScore(const FunctionData* func, Ranking ranking) noexcept;
     
     /**
      Generate a human-readable explanation for why a function is considered a hotspot.
@@ -21,6 +21,7 @@
 
 #include <atomic>
 #include <cassert>
+#include <cstdint>
 #include <functional>
 #include <iostream>
 #include <mutex>
@@ -35,6 +36,9 @@ extern bool isQitiTestRunning() noexcept;
 
 // Thread-local storage for function call callbacks
 inline static thread_local std::unordered_map<const void*, std::function<void()>> g_onNextFunctionCallMap;
+// Size of this thread's g_onNextFunctionCallMap, so the hooks can skip the lookup.
+// Per thread, as only this thread's callbacks can run here (and the map dies with the thread).
+static constinit thread_local uint32_t g_numFunctionCallCallbacks = 0;
 // Thread-local storage for thread creation callbacks
 inline static std::atomic<std::function<void(std::thread::id)>*> g_onThreadCreationCallback{nullptr};
 
@@ -66,7 +70,9 @@ namespace qiti
 {
 void Instrument::onNextFunctionCallInternal(std::function<void()> callback, const void* functionAddress) noexcept
 {
-    g_onNextFunctionCallMap[functionAddress] = std::move(callback);
+    auto [it, inserted] = g_onNextFunctionCallMap.insert_or_assign(functionAddress, std::move(callback));
+    if (inserted)
+        ++g_numFunctionCallCallbacks;
 }
 
 void Instrument::resetInstrumentation() noexcept
@@ -75,6 +81,7 @@ void Instrument::resetInstrumentation() noexcept
     
     MallocHooks::getOnNextHeapAllocation() = nullptr;
     g_onNextFunctionCallMap.clear();
+    g_numFunctionCallCallbacks = 0;
     g_onThreadCreationCallback.store(nullptr, std::memory_order_relaxed);
 }
 
@@ -108,10 +115,16 @@ void Instrument::onThreadCreation(std::function<void(std::thread::id threadId)>
     // Set the atomic pointer to point to our stored callback with release ordering
     // to ensure storedCallback update is visible before the pointer
     g_onThreadCreationCallback.store(&storedCallback, std::memory_order_release);
+    
+    // New threads are detected by the hooks (their first instrumented call)
+    Profile::hooksActive.store(true, std::memory_order_relaxed);
 }
 
 void Instrument::checkAndExecuteFunctionCallCallback(const void* functionAddress) noexcept
 {
+    if (g_numFunctionCallCallbacks == 0)
+        return; // don't touch (and construct) the thread_local map on every profiled call
+    
     qiti::ScopedNoHeapAllocations noAlloc;
     
     auto it = g_onNextFunctionCallMap.find(functionAddress);
@@ -119,6 +132,7 @@ void Instrument::checkAndExecuteFunctionCallCallback(const void* functionAddress
     {
         it->second(); // Execute callback
         g_onNextFunctionCallMap.erase(it); // Remove after execution
+        --g_numFunctionCallCallbacks;
     }
 }
 
@@ -16,19 +16,13 @@
 #include "qiti_MallocHooks.hpp"
 
 #include "qiti_Instrument.hpp"
-#include "qiti_LockData.hpp" // PC: for pthread_mutex_t
-#include "qiti_LockHooks.hpp"
 #include "qiti_Profile.hpp"
 
+#include <atomic>
 #include <memory>
-#include <mutex>
 
 //--------------------------------------------------------------------------
 
-using MutexType = std::mutex;
-using LockType = std::scoped_lock<MutexType>;
-
-static MutexType g_hookLock;
 static thread_local bool g_inHook = false;
 
 extern "C" void qitiEnsureInstrumentTranslationUnitInitialized() noexcept;
@@ -43,13 +37,49 @@ namespace qiti
  The InstrumentHooks class provides the internal implementation for handling
  function entry and exit events generated by the compiler's -finstrument-functions
  flag. It coordinates with the profiling system to track function calls while
- managing thread safety and preventing recursive hook invocation.
+ preventing recursive hook invocation. The hooks do not take a global lock: each
+ thread records into its own per-function shard (see FunctionData::Impl::ThreadShard).
+
+ The exported hooks only check isActive() inline, everything else is out of line, so
+ instrumented code pays for a single relaxed load while nothing is profiled.
 
  @note This class is designed for internal use by the Qiti profiling system.
  */
 class InstrumentHooks
 {
 public:
+    [[nodiscard]] QITI_API_INLINE static inline bool isActive() noexcept
+    {
+        return Profile::hooksActive.load(std::memory_order_relaxed);
+    }
+    
+    /** Cold path of the exported enter hook, guarding against recursing into itself. */
+    QITI_API_INTERNAL __attribute__((noinline, cold)) static void
+    onFunctionEnter(void* this_fn, void* call_site) noexcept
+    {
+        if (g_inHook)
+            return;       // already in our hook, bail out
+        g_inHook = true;  // mark “in hook” for this thread
+        
+        __cyg_profile_func_enter(this_fn, call_site);
+        
+        g_inHook = false; // un-mark
+    }
+    
+    /** Cold path of the exported exit hook, guarding against recursing into itself. */
+    QITI_API_INTERNAL __attribute__((noinline, cold)) static void
+    onFunctionExit(void* this_fn, void* call_site) noexcept
+    {
+        if (g_inHook)
+            return;
+        g_inHook = true;
+        
+        __cyg_profile_func_exit(this_fn, call_site);
+        
+        g_inHook = false;
+    }
+    
+private:
     QITI_API_INTERNAL static void
     __cyg_profile_func_enter(void* this_fn, [[maybe_unused]] void* call_site) noexcept
     {
@@ -60,7 +90,7 @@ public:
         {
             qiti::MallocHooks::ScopedBypassMallocHooks bypassMallocHooks;
             
-            qiti::LockHooks::LockBypassingHook<LockType, MutexType> lock(g_hookLock);
+            // No global lock, profiling data is accumulated in per-thread shards
             qiti::Profile::updateFunctionDataOnEnter(this_fn);
             
             // Execute any pending function call callbacks
@@ -75,11 +105,11 @@ public:
         {
             qiti::MallocHooks::ScopedBypassMallocHooks bypassMallocHooks;
             
-            qiti::LockHooks::LockBypassingHook<LockType, MutexType> lock(g_hookLock);
             qiti::Profile::updateFunctionDataOnExit(this_fn);
         }
     }
-
+    
+public:
     // Deleted constructors/destructors
     InstrumentHooks() = delete;
     ~InstrumentHooks() = delete;
@@ -92,26 +122,21 @@ public:
 extern "C" void QITI_API // Mark “no-instrument” to prevent recursing into itself
 __cyg_profile_func_enter(void* this_fn, [[maybe_unused]] void* call_site) noexcept
 {
-    if (g_inHook)
-        return;       // already in our hook, bail out
-    g_inHook = true;  // mark “in hook” for this thread
-    
-    qiti::InstrumentHooks::__cyg_profile_func_enter(this_fn, call_site);
+    // Idle fast path: nothing is profiled
+    if (! qiti::InstrumentHooks::isActive()) [[likely]]
+        return;
     
-    g_inHook = false; // un-mark
+    qiti::InstrumentHooks::onFunctionEnter(this_fn, call_site);
 }
 
 /** Hook exposed by -finstrument-functions called whenever exiting instrumented function. */
 extern "C" void QITI_API // Mark “no-instrument” to prevent recursing into itself
 __cyg_profile_func_exit(void * this_fn, [[maybe_unused]] void* call_site) noexcept
 {
-    if (g_inHook)
+    if (! qiti::InstrumentHooks::isActive()) [[likely]]
         return;
-    g_inHook = true;
-    
-    qiti::InstrumentHooks::__cyg_profile_func_exit(this_fn, call_site);
     
-    g_inHook = false;
+    qiti::InstrumentHooks::onFunctionExit(this_fn, call_site);
 }
 
 //--------------------------------------------------------------------------
@@ -0,0 +1,72 @@
+
+/******************************************************************************
+ * Qiti — C++ Profiling Library
+ *
+ * @file     qiti_LatencyHistogram.cpp
+ *
+ * @author   Adam Shield
+ * @date     2026-10-16
+ *
+ * @copyright (c) 2025 Adam Shield
+ * SPDX-License-Identifier: MIT
+ *
+ * See LICENSE.txt for license terms.
+ ******************************************************************************/
+
+#include "qiti_LatencyHistogram.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+//--------------------------------------------------------------------------
+
+namespace qiti
+{
+
+static_assert(LatencyHistogram::bucketIndex(~uint64_t{0}) == LatencyHistogram::numBuckets - 1);
+static_assert(LatencyHistogram::bucketHighestValue(LatencyHistogram::numBuckets - 1) == ~uint64_t{0});
+static_assert(LatencyHistogram::bucketIndex(LatencyHistogram::bucketHighestValue(100)) == 100);
+static_assert(LatencyHistogram::bucketIndex(LatencyHistogram::bucketHighestValue(100) + 1) == 101);
+
+std::atomic<bool> LatencyHistogram::enabled{false};
+
+void LatencyHistogram::merge(const LatencyHistogram& other) noexcept
+{
+    for (size_t i = 0; i < numBuckets; ++i)
+    {
+        if (const auto count = other.counts[i].load(std::memory_order_relaxed); count > 0)
+            counts[i].store(counts[i].load(std::memory_order_relaxed) + count, std::memory_order_relaxed);
+    }
+    
+    totalCount.store(totalCount.load(std::memory_order_relaxed) + other.totalCount.load(std::memory_order_relaxed),
+                     std::memory_order_relaxed);
+    maxValue.store(std::max(maxValue.load(std::memory_order_relaxed), other.maxValue.load(std::memory_order_relaxed)),
+                   std::memory_order_relaxed);
+}
+
+uint64_t LatencyHistogram::getValueAtQuantile(double quantile) const noexcept
+{
+    const auto total = getTotalCount();
+    if (total == 0)
+        return 0;
+    
+    // Nearest-rank: the value of the rank-th smallest value counted
+    const auto rank = std::clamp(static_cast<uint64_t>(std::ceil(std::clamp(quantile, 0.0, 1.0) * static_cast<double>(total))),
+                                 uint64_t{1},
+                                 total);
+    
+    const auto max = maxValue.load(std::memory_order_relaxed);
+    uint64_t countSoFar = 0;
+    for (size_t i = 0; i < numBuckets; ++i)
+    {
+        countSoFar += counts[i].load(std::memory_order_relaxed);
+        if (countSoFar >= rank)
+            return std::min(bucketHighestValue(i), max);
+    }
+    return max; // the writer counted a value while we were reading
+}
+
+} // namespace qiti
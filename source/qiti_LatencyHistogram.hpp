@@ -0,0 +1,110 @@
+/******************************************************************************
+ * Qiti — C++ Profiling Library
+ *
+ * @file     qiti_LatencyHistogram.hpp
+ *
+ * @author   Adam Shield
+ * @date     2026-10-16
+ *
+ * @copyright (c) 2025 Adam Shield
+ * SPDX-License-Identifier: MIT
+ *
+ * See LICENSE.txt for license terms.
+ ******************************************************************************/
+
+#pragma once
+
+#include "qiti_API.hpp"
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+
+//--------------------------------------------------------------------------
+// Doxygen - Begin Internal Documentation
+/** \cond INTERNAL */
+//--------------------------------------------------------------------------
+
+namespace qiti
+{
+//--------------------------------------------------------------------------
+/**
+ Log-linear (HDR-style) histogram of durations.
+ 
+ Values below 2^subBucketBits each get their own bucket. Above that, every power of two
+ is split into 2^subBucketBits equally wide buckets, so any uint64_t value is counted in
+ constant memory with a relative error of at most 1 / 2^subBucketBits (~3%).
+ 
+ Single writer: record() is O(1) (a count leading zeros and two relaxed stores) and never
+ allocates. Other threads may read (and merge) at any time through relaxed atomics.
+ 
+ @note This class is designed for internal use by the Qiti profiling system.
+ */
+class LatencyHistogram
+{
+public:
+    static constexpr uint32_t subBucketBits = 5;
+    static constexpr size_t subBucketCount = size_t{1} << subBucketBits;
+    static constexpr size_t numBuckets = (64 - subBucketBits + 1) * subBucketCount;
+    
+    /** Whether profiled functions keep histograms of their durations, false by default. */
+    QITI_API_VAR static std::atomic<bool> enabled;
+    
+    /** Writer only: counts one value. */
+    QITI_API_INLINE inline void record(uint64_t value) noexcept
+    {
+        auto& count = counts[bucketIndex(value)];
+        count.store(count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        totalCount.store(totalCount.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        
+        if (value > maxValue.load(std::memory_order_relaxed))
+            maxValue.store(value, std::memory_order_relaxed);
+    }
+    
+    /** Adds the counts of other to this histogram. This histogram must not be written concurrently. */
+    QITI_API_INTERNAL void merge(const LatencyHistogram& other) noexcept;
+    
+    /**
+     Value that a fraction of quantile (0..1) of the counted values are less than or equal to,
+     within the histogram's precision (the highest value of its bucket, at most the largest value counted).
+     0 if no value was counted.
+     */
+    [[nodiscard]] QITI_API_INTERNAL uint64_t getValueAtQuantile(double quantile) const noexcept;
+    
+    [[nodiscard]] uint64_t getTotalCount() const noexcept { return totalCount.load(std::memory_order_relaxed); }
+    
+    [[nodiscard]] QITI_API_INLINE static constexpr size_t bucketIndex(uint64_t value) noexcept
+    {
+        if (value < subBucketCount)
+            return static_cast<size_t>(value);
+        
+        // Position of the bucket within its power of two: the subBucketBits bits below the most significant one
+        const auto shift = static_cast<uint32_t>(std::bit_width(value)) - subBucketBits - 1;
+        const auto subBucket = static_cast<size_t>(value >> shift) - subBucketCount;
+        return (shift + 1) * subBucketCount + subBucket;
+    }
+    
+    /** Highest value counted in the given bucket. */
+    [[nodiscard]] QITI_API_INLINE static constexpr uint64_t bucketHighestValue(size_t index) noexcept
+    {
+        if (index < subBucketCount)
+            return index;
+        
+        const auto shift = static_cast<uint32_t>(index / subBucketCount) - 1;
+        const auto lowest = static_cast<uint64_t>(subBucketCount + index % subBucketCount) << shift;
+        return lowest + ((uint64_t{1} << shift) - 1);
+    }
+    
+private:
+    std::array<std::atomic<uint64_t>, numBuckets> counts{};
+    std::atomic<uint64_t> totalCount{0};
+    std::atomic<uint64_t> maxValue{0};
+}; // class LatencyHistogram
+} // namespace qiti
+
+//--------------------------------------------------------------------------
+/** \endcond */
+// Doxygen - End Internal Documentation
+//--------------------------------------------------------------------------
@@ -20,12 +20,26 @@
 
 #include <sstream>
 #include <string>
+#include <tuple>
+#include <utility>
 
 namespace qiti
 {
 LeakSanitizer::LeakSanitizer() noexcept = default;
+LeakSanitizer::LeakSanitizer(Scope scope) noexcept : _scope(scope) {}
 LeakSanitizer::~LeakSanitizer() noexcept = default;
 
+/** @returns {bytes currently allocated, bytes allocated in total} by the threads of the scope */
+[[nodiscard]] static std::pair<uint64_t, uint64_t> getAmountsHeapAllocated(LeakSanitizer::Scope scope) noexcept
+{
+    if (scope == LeakSanitizer::Scope::allThreads)
+        return { qiti::MallocHooks::getCurrentAmountHeapAllocatedInProcess(),
+                 qiti::MallocHooks::getTotalAmountHeapAllocatedInProcess() };
+    
+    return { qiti::MallocHooks::getCurrentAmountHeapAllocatedOnCurrentThread(),
+             qiti::MallocHooks::getTotalAmountHeapAllocatedOnCurrentThread() };
+}
+
 void LeakSanitizer::run(std::function<void()> func) noexcept
 {
     // Reset stats for this run
@@ -44,8 +58,7 @@ void LeakSanitizer::run(std::function<void()> func) noexcept
         // Cache function for rerun()
         _cachedFunction = func;
         
-        amountHeapAllocatedBefore = qiti::MallocHooks::getCurrentAmountHeapAllocatedOnCurrentThread();
-        totalAllocatedBefore = qiti::MallocHooks::getTotalAmountHeapAllocatedOnCurrentThread();
+        std::tie(amountHeapAllocatedBefore, totalAllocatedBefore) = getAmountsHeapAllocated(_scope);
     } // ScopedDisableProfiling goes out of scope, re-enable profiling during user function execution
     
     if (func != nullptr)
@@ -57,15 +70,15 @@ void LeakSanitizer::run(std::function<void()> func) noexcept
         qiti::Profile::ScopedDisableProfiling disableProfiling;
         
         // Any new heap allocations should be freed by the end of the function so this value should match.
-        amountHeapAllocatedAfter = qiti::MallocHooks::getCurrentAmountHeapAllocatedOnCurrentThread();
-        totalAllocatedAfter = qiti::MallocHooks::getTotalAmountHeapAllocatedOnCurrentThread();
+        std::tie(amountHeapAllocatedAfter, totalAllocatedAfter) = getAmountsHeapAllocated(_scope);
         
         // Calculate allocations that happened during this run
         _totalAllocated = (totalAllocatedAfter - totalAllocatedBefore);
-        _netLeak = (amountHeapAllocatedAfter - amountHeapAllocatedBefore);
-        _totalDeallocated = _totalAllocated - _netLeak;
+        // Signed: other threads may free allocations made before run(), so the amount can go down
+        _netLeak = static_cast<int64_t>(amountHeapAllocatedAfter) - static_cast<int64_t>(amountHeapAllocatedBefore);
+        _totalDeallocated = static_cast<uint64_t>(static_cast<int64_t>(_totalAllocated) - _netLeak);
         
-        if (_netLeak != 0)
+        if (_netLeak > 0)
             _passed = false;
     }
 }
@@ -95,13 +108,14 @@ std::string LeakSanitizer::getReport() const noexcept
     if (_netLeak > 0)
         report << " (Memory leak detected)";
     else if (_netLeak < 0)
-        report << " (More memory freed than allocated - possible double free)";
+        report << " (More memory freed than allocated - allocations made before running were freed)";
     
     return report.str();
 }
 
 LeakSanitizer::LeakSanitizer(LeakSanitizer&& other) noexcept
     : _passed(other._passed.load())
+    , _scope(other._scope)
 {
 }
 
@@ -110,6 +124,7 @@ LeakSanitizer& LeakSanitizer::operator=(LeakSanitizer&& other) noexcept
     if (this != &other)
     {
         _passed = other._passed.load();
+        _scope = other._scope;
     }
     return *this;
 }
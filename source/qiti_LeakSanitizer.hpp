@@ -32,9 +32,9 @@ namespace qiti
  memory allocated before and after the function runs - if they don't match,
  it indicates a memory leak.
  
- @note This class works by leveraging Qiti's malloc hooks to track allocations
- on the current thread. It will only detect leaks from allocations made through
- operator new/delete or malloc/free that are instrumented by Qiti.
+ @note This class works by leveraging Qiti's malloc hooks to track allocations.
+ It will only detect leaks from allocations made through operator new/delete or
+ malloc/free that are instrumented by Qiti. Allocations may be freed on any thread.
  
  @code{.cpp}
  qiti::LeakSanitizer lsan;
@@ -54,9 +54,24 @@ namespace qiti
 class LeakSanitizer final
 {
 public:
-    /** Default constructor. Initializes leak sanitizer in passed state. */
+    /** Whose heap allocations run() checks for leaks. */
+    enum class Scope
+    {
+        currentThread, ///< Allocations made by the thread calling run() (the default)
+        allThreads     ///< Allocations made by any thread while run() executes, e.g. by a pipeline's worker threads
+    };
+    
+    /** Default constructor. Initializes leak sanitizer in passed state, checking Scope::currentThread. */
     QITI_API LeakSanitizer() noexcept;
     
+    /**
+     Initializes leak sanitizer in passed state, checking the allocations of the given threads.
+     
+     With Scope::allThreads, allocations of threads unrelated to the function that are
+     still alive when run() returns are reported as leaks too.
+     */
+    QITI_API explicit LeakSanitizer(Scope scope) noexcept;
+    
     /** Destructor. */
     QITI_API ~LeakSanitizer() noexcept;
     
@@ -117,9 +132,10 @@ private:
     //--------------------------------------------------------------------------
     
     std::atomic<bool> _passed = true;
+    Scope _scope = Scope::currentThread;
     uint64_t _totalAllocated = 0;
     uint64_t _totalDeallocated = 0;
-    uint64_t _netLeak = 0;
+    int64_t _netLeak = 0; // negative if more was freed than allocated
     std::function<void()> _cachedFunction = nullptr;
     
     //--------------------------------------------------------------------------
@@ -15,7 +15,10 @@
 
 #include "qiti_MallocHooks.hpp"
 
+#include "qiti_AllocationTable.hpp"
 #include "qiti_FunctionDataUtils.hpp"
+#include "qiti_FunctionFilter.hpp"
+#include "qiti_LockHooks.hpp"
 
 #ifdef _WIN32
   #include <windows.h>
@@ -23,15 +26,19 @@
 #else
   #include <cxxabi.h>     // __cxa_demangle
   #include <dlfcn.h>      // dladdr()
-  #include <execinfo.h>   // backtrace(), backtrace_symbols()
+  #include <execinfo.h>   // backtrace()
 #endif
 
+#include <algorithm>
 #include <array>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
 #include <memory>
 #include <mutex>
-#include <sstream>        // std::ostringstream
 #include <string>
-#include <unordered_map>
 #include <vector>
 
 //--------------------------------------------------------------------------
@@ -44,7 +51,6 @@ extern bool isQitiTestRunning() noexcept;
 static thread_local bool g_bypassMallocHooks = false;
 static thread_local uint32_t g_numHeapAllocationsOnCurrentThread = 0;
 static thread_local uint64_t g_totalAmountHeapAllocatedOnCurrentThread = 0;
-static thread_local uint64_t g_currentAmountHeapAllocatedOnCurrentThread = 0;
 static thread_local std::function<void()> g_onNextHeapAllocation = nullptr;
 
 // Accessor function implementations
@@ -63,38 +69,57 @@ uint64_t& qiti::MallocHooks::getTotalAmountHeapAllocatedOnCurrentThread() noexce
     return g_totalAmountHeapAllocatedOnCurrentThread;
 }
 
-uint64_t& qiti::MallocHooks::getCurrentAmountHeapAllocatedOnCurrentThread() noexcept
+uint64_t qiti::MallocHooks::getCurrentAmountHeapAllocatedOnCurrentThread() noexcept
 {
-    return g_currentAmountHeapAllocatedOnCurrentThread;
+    return AllocationTable::getCountersOfCurrentThread().getCurrentAmount();
 }
 
-std::function<void()>& qiti::MallocHooks::getOnNextHeapAllocation() noexcept
+uint64_t qiti::MallocHooks::getCurrentAmountHeapAllocatedInProcess() noexcept
 {
-    return g_onNextHeapAllocation;
+    return AllocationTable::getCurrentAmountInProcess();
 }
 
-// Thread-local allocation tracking for leak detection
-static thread_local std::unordered_map<void*, std::size_t> g_allocationSizes;
+uint64_t qiti::MallocHooks::getTotalAmountHeapAllocatedInProcess() noexcept
+{
+    return AllocationTable::getTotalAmountInProcess();
+}
 
-#ifndef _WIN32
-static thread_local struct AllocationSizesCleanup final
+std::function<void()>& qiti::MallocHooks::getOnNextHeapAllocation() noexcept
 {
-    QITI_API_INTERNAL ~AllocationSizesCleanup() noexcept
-    {
-        qiti::MallocHooks::ScopedBypassMallocHooks bypassHooks;
-        g_allocationSizes.clear(); // delete everything without triggering hooks
-    }
-} g_allocationSizesCleanup;
-#endif
+    return g_onNextHeapAllocation;
+}
 
-/** Functions we never want to count towards heap allocations that we track. */
+/** Functions we never want to count towards heap allocations that we track, as '*' globs. */
 static inline const std::array<const char*, 1> blackListedFunctions
 {
-    "Catch::Section::Section" // every time a Catch2 unit test enters a SECTION
+    "Catch::Section::Section*" // every time a Catch2 unit test enters a SECTION
 };
 
+using MutexType = std::mutex;
+using LockType = std::scoped_lock<MutexType>;
+
+/** Patterns are only read when resolving a return address seen for the first time, so a plain mutex is fine. */
+static MutexType g_blacklistLock;
+
+/** Incremented whenever the blacklist changes, so return addresses resolved before are resolved again. */
+static std::atomic<uint32_t> g_blacklistGeneration{1};
+
+[[nodiscard]] static std::vector<qiti::FunctionFilter::GlobPattern>& getBlacklist() noexcept
+{
+    static std::vector<qiti::FunctionFilter::GlobPattern> blacklist = []
+    {
+        qiti::MallocHooks::ScopedBypassMallocHooks bypassHooks;
+        
+        std::vector<qiti::FunctionFilter::GlobPattern> defaults;
+        for (const char* func : blackListedFunctions)
+            defaults.emplace_back(func);
+        return defaults;
+    }();
+    return blacklist;
+}
+
 /** Demangle a C++ ABI symbol name, or return the original on error */
-[[maybe_unused]] QITI_API_INTERNAL static std::string demangle(const char* name) noexcept
+QITI_API_INTERNAL static std::string demangle(const char* name) noexcept
 {
 #ifdef _WIN32
     // Windows: Use UnDecorateSymbolName
@@ -115,220 +140,177 @@ static inline const std::array<const char*, 1> blackListedFunctions
 #endif
 }
 
-/** Capture the current call stack (skipping the first `skip` frames) */
-QITI_API_INTERNAL static std::vector<std::string> captureStackTrace(int framesToSkip = 1) noexcept
+/** Slow path: dladdr + demangling, once per return address (see isBlacklistedReturnAddress()). */
+[[nodiscard]] QITI_API_INTERNAL static bool resolveIsBlacklisted(uintptr_t returnAddress) noexcept
 {
-#ifdef _WIN32
-#if 0 // Temporarily disabled for debugging Windows initialization issues
-    constexpr int MAX_FRAMES = 128;
-    void* stack[MAX_FRAMES];
-    WORD frames = CaptureStackBackTrace(static_cast<DWORD>(framesToSkip), MAX_FRAMES - framesToSkip, stack, nullptr);
+    qiti::MallocHooks::ScopedBypassMallocHooks bypassHooks;
     
-    std::vector<std::string> out;
-    out.reserve(frames);
+    // Held around dladdr() too, the Windows one (see qiti_FunctionDataUtils) resolves into static buffers
+    qiti::LockHooks::LockBypassingHook<LockType, MutexType> lock(g_blacklistLock);
     
-    HANDLE process = GetCurrentProcess();
-    BOOL symInitResult = SymInitialize(process, nullptr, TRUE);
+    // The return address follows the call, which may be the last instruction of its function
+    Dl_info info;
+    if (! dladdr(reinterpret_cast<void*>(returnAddress - 1), &info) || info.dli_sname == nullptr)
+        return false;
     
-    if (symInitResult)
-    {
-        char buffer[sizeof(SYMBOL_INFO) + MAX_SYM_NAME * sizeof(TCHAR)];
-        auto symbol = reinterpret_cast<PSYMBOL_INFO>(buffer);
-        symbol->MaxNameLen = MAX_SYM_NAME;
-        symbol->SizeOfStruct = sizeof(SYMBOL_INFO);
-        
-        for (int i = 0; i < frames; ++i)
-        {
-            auto address = reinterpret_cast<DWORD64>(stack[i]);
-            if (SymFromAddr(process, address, nullptr, symbol))
-            {
-                out.push_back(demangle(symbol->Name));
-            }
-            else
-            {
-                std::ostringstream oss;
-                oss << stack[i];
-                out.push_back(oss.str());
-            }
-        }
-        
-        SymCleanup(process);
-    }
-    else
-    {
-        // Fallback: just show addresses if symbol initialization fails
-        for (int i = 0; i < frames; ++i)
-        {
-            std::ostringstream oss;
-            oss << stack[i];
-            out.push_back(oss.str());
-        }
-    }
-    return out;
-#else
-    (void)framesToSkip;
-    // Windows: Disable stack tracing temporarily for debugging
-    std::vector<std::string> out;
-    out.push_back("<stack tracing disabled on Windows>");
-    return out;
-#endif
-#else
-    constexpr int MAX_FRAMES = 128;
-    std::array<void*, MAX_FRAMES> addrs;
-    int frames = backtrace(addrs.data(), MAX_FRAMES);
+    const auto functionName = demangle(info.dli_sname);
+    return std::ranges::any_of(getBlacklist(),
+                               [&functionName](const qiti::FunctionFilter::GlobPattern& pattern)
+                               {
+                                   return pattern.matches(functionName);
+                               });
+}
+
+/** Whether a return address is in a blacklisted function, cached per thread. */
+struct CachedReturnAddress
+{
+    uintptr_t returnAddress = 0;
+    uint32_t generation = 0; // of the blacklist it was resolved with, 0 = empty
+    bool isBlacklisted = false;
+};
+
+static constexpr size_t numCachedReturnAddresses = 256;
+static_assert(std::has_single_bit(numCachedReturnAddresses));
 
-    std::vector<std::string> out;
-    out.reserve(static_cast<size_t>(frames - framesToSkip));
+/** Direct-mapped, trivially destructible so reading it never allocates or registers a TLS destructor. */
+static constinit thread_local std::array<CachedReturnAddress, numCachedReturnAddresses> g_returnAddressCache{};
 
-    for (int i = framesToSkip; i < frames; ++i)
+[[nodiscard]] QITI_API_INTERNAL static bool isBlacklistedReturnAddress(uintptr_t returnAddress, uint32_t generation) noexcept
+{
+    const auto hash = static_cast<uint64_t>(returnAddress) * 0x9E3779B97F4A7C15ull; // Fibonacci hashing
+    auto& entry = g_returnAddressCache[static_cast<size_t>(hash >> (64 - std::countr_zero(numCachedReturnAddresses)))];
+    
+    if (entry.returnAddress != returnAddress || entry.generation != generation) [[unlikely]]
+        entry = { returnAddress, generation, resolveIsBlacklisted(returnAddress) };
+    
+    return entry.isBlacklisted;
+}
+
+/**
+ Check if a blacklisted function is on the stack, without symbolizing every frame.
+ 
+ Looks every return address up in a per-thread cache, so only return addresses seen for the first
+ time cost a dladdr() and demangling.
+ The return addresses are collected with the unwind tables (CaptureStackBackTrace() on Windows,
+ backtrace() elsewhere) rather than by following frame pointers, which would silently skip the
+ frames of code built without them (e.g. an optimized Catch2).
+ */
+QITI_API_INTERNAL static bool stackContainsBlacklistedFunction() noexcept
+{
+    static constexpr int maxFrames = 128;
+    
+    const auto generation = g_blacklistGeneration.load(std::memory_order_acquire);
+    
+    std::array<void*, maxFrames> returnAddresses;
+#ifdef _WIN32
+    const auto numFrames = CaptureStackBackTrace(0, static_cast<DWORD>(maxFrames), returnAddresses.data(), nullptr);
+#else
+    int numFrames = 0;
     {
-        Dl_info info;
-        if (dladdr(addrs[static_cast<size_t>(i)], &info) && info.dli_sname)
-        {
-            // demangle the raw symbol
-            out.push_back(demangle(info.dli_sname));
-        }
-        else
-        {
-            // fallback: just print the address
-            std::ostringstream oss;
-            oss << addrs[static_cast<size_t>(i)];
-            out.push_back(oss.str());
-        }
+        qiti::MallocHooks::ScopedBypassMallocHooks bypassHooks; // the first call loads the unwinder
+        numFrames = backtrace(returnAddresses.data(), maxFrames);
     }
-    return out;
 #endif
+    return std::any_of(returnAddresses.begin(), returnAddresses.begin() + numFrames,
+                       [generation](void* returnAddress)
+                       {
+                           return isBlacklistedReturnAddress(reinterpret_cast<uintptr_t>(returnAddress), generation);
+                       });
 }
 
-/** Check if the stack trace contains a frame whose demangled name contains the substring `funcName */
-[[nodiscard]] QITI_API_INTERNAL inline static bool stackContainsFunction(const std::string& funcName, int framesToSkip = 1) noexcept
+void qiti::MallocHooks::addBlacklistedFunction(const char* namePattern) noexcept
 {
-    auto trace = captureStackTrace(framesToSkip);
-    for (auto& frame : trace)
-        if (frame.find(funcName) != std::string::npos)
-            return true;
-    return false;
+    if (namePattern == nullptr)
+        return;
+    
+    ScopedBypassMallocHooks bypassHooks;
+    
+    {
+        qiti::LockHooks::LockBypassingHook<LockType, MutexType> lock(g_blacklistLock);
+        getBlacklist().emplace_back(namePattern);
+    }
+    g_blacklistGeneration.fetch_add(1, std::memory_order_acq_rel);
 }
 
-/** */
-QITI_API_INTERNAL inline static bool stackContainsBlacklistedFunction() noexcept
+void qiti::MallocHooks::resetBlacklistedFunctions() noexcept
 {
-    qiti::MallocHooks::ScopedBypassMallocHooks bypassHooks;
+    ScopedBypassMallocHooks bypassHooks;
     
-    for (const char* func : blackListedFunctions)
-        if (stackContainsFunction(std::string(func), /*framesToSkip*/ 4))
-            return true;
-    return false;
+    {
+        qiti::LockHooks::LockBypassingHook<LockType, MutexType> lock(g_blacklistLock);
+        auto& blacklist = getBlacklist();
+        if (blacklist.size() == blackListedFunctions.size())
+            return; // only the defaults
+        blacklist.erase(blacklist.begin() + static_cast<std::ptrdiff_t>(blackListedFunctions.size()), blacklist.end());
+    }
+    g_blacklistGeneration.fetch_add(1, std::memory_order_acq_rel);
 }
 
 //--------------------------------------------------------------------------
 
-QITI_API_INTERNAL void qiti::MallocHooks::mallocHook(std::size_t size) noexcept
+/** @returns true if the allocation was counted, i.e. not bypassed or made by a blacklisted function */
+QITI_API_INTERNAL static bool countHeapAllocation(std::size_t size) noexcept
 {
     if (! isQitiTestRunning())
-        return;
+        return false;
     
     if (g_bypassMallocHooks)
-        return;
+        return false;
     
     if (stackContainsBlacklistedFunction())
-        return;
+        return false;
     
     ++g_numHeapAllocationsOnCurrentThread;
     g_totalAmountHeapAllocatedOnCurrentThread += size;
-    g_currentAmountHeapAllocatedOnCurrentThread += size;
 
     if (g_onNextHeapAllocation != nullptr)
     {
         g_onNextHeapAllocation();
         g_onNextHeapAllocation = nullptr;
     }
+    return true;
 }
 
-[[maybe_unused]] QITI_API_INTERNAL static void freeHook(void* ptr) noexcept
+QITI_API_INTERNAL void qiti::MallocHooks::mallocHook(std::size_t size) noexcept
 {
-    if (! isQitiTestRunning())
-        return;
-    
-    if (g_bypassMallocHooks)
-        return;
-    
-    if (ptr != nullptr)
-    {
-        // Use map-based tracking (consistent with other implementations)
-        auto it = g_allocationSizes.find(ptr);
-        if (it != g_allocationSizes.end())
-        {
-            qiti::MallocHooks::ScopedBypassMallocHooks bypassHooks;
-            g_currentAmountHeapAllocatedOnCurrentThread -= it->second;
-            g_allocationSizes.erase(it); // deletes
-        }
-    }
+    (void)countHeapAllocation(size);
 }
 
 void qiti::MallocHooks::mallocHookWithTracking(void* ptr, std::size_t size) noexcept
 {
-    if (! isQitiTestRunning())
-        return;
-        
-    // Always call the basic malloc hook (it has its own bypass check)
-    mallocHook(size);
-    
-    // Only do leak tracking if we're not bypassing and have a valid pointer
-    if (! g_bypassMallocHooks && ptr != nullptr)
-    {
-        qiti::MallocHooks::ScopedBypassMallocHooks bypassHooks;
-        g_allocationSizes[ptr] = size; // heap allocates
-    }
+    // Allocations that are not counted are not tracked either, so freeing them is not subtracted
+    if (countHeapAllocation(size) && ptr != nullptr)
+        AllocationTable::insert(ptr, size);
 }
 
 void qiti::MallocHooks::freeHookWithTracking(void* ptr) noexcept
 {
-    if (! isQitiTestRunning() || ptr == nullptr)
+    // Also between tests: allocations tracked by one test must not stay live once freed
+    if (ptr == nullptr)
         return;
     
-    // Only do leak tracking if we're not bypassing
-    if (! g_bypassMallocHooks && g_allocationSizes.size() > 0)
-    {
-        auto it = g_allocationSizes.find(ptr);
-        if (it != g_allocationSizes.end())
-        {
-            qiti::MallocHooks::ScopedBypassMallocHooks bypassHooks;
-            g_currentAmountHeapAllocatedOnCurrentThread -= it->second;
-            g_allocationSizes.erase(it); // deletes
-        }
-    }
+    // Never erase while bypassing: the table itself frees with the hooks bypassed, while locked
+    if (! g_bypassMallocHooks)
+        (void)AllocationTable::erase(ptr);
 }
 
 void qiti::MallocHooks::reallocHookWithTracking(void* oldPtr, void* newPtr, std::size_t oldSize, std::size_t newSize) noexcept
 {
+    if (g_bypassMallocHooks)
+        return;
+    
+    // Handle the old allocation, also between tests (see freeHookWithTracking())
+    const bool wasTracked = (oldPtr != nullptr) && AllocationTable::erase(oldPtr);
     if (! isQitiTestRunning())
         return;
-        
-    // Handle the old allocation
-    if (oldPtr != nullptr)
-    {
-        auto it = g_allocationSizes.find(oldPtr);
-        if (it != g_allocationSizes.end())
-        {
-            qiti::MallocHooks::ScopedBypassMallocHooks bypassHooks;
-            g_currentAmountHeapAllocatedOnCurrentThread -= it->second;
-            g_allocationSizes.erase(it); // deletes
-        }
-    }
     
     // Handle the new allocation
     if (newPtr != nullptr)
     {
-        // Only call mallocHook for the net size change
-        if (newSize > oldSize)
-        {
-            mallocHook(newSize - oldSize);
-        }
-        
-        qiti::MallocHooks::ScopedBypassMallocHooks bypassHooks;
-        g_currentAmountHeapAllocatedOnCurrentThread += newSize;
-        g_allocationSizes[newPtr] = newSize; // heap allocates
+        // Only count the net size change as a new allocation
+        const bool isCounted = (newSize > oldSize) && countHeapAllocation(newSize - oldSize);
+        if (wasTracked || isCounted)
+            AllocationTable::insert(newPtr, newSize);
     }
 }
 
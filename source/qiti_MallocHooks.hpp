@@ -46,7 +46,16 @@ public:
     [[nodiscard]] QITI_API static bool& getBypassMallocHooks() noexcept;
     [[nodiscard]] QITI_API static uint32_t& getNumHeapAllocationsOnCurrentThread() noexcept;
     [[nodiscard]] QITI_API static uint64_t& getTotalAmountHeapAllocatedOnCurrentThread() noexcept;
-    [[nodiscard]] QITI_API static uint64_t& getCurrentAmountHeapAllocatedOnCurrentThread() noexcept;
+    
+    /** Bytes allocated by the current thread that were not freed yet, by any thread. */
+    [[nodiscard]] QITI_API static uint64_t getCurrentAmountHeapAllocatedOnCurrentThread() noexcept;
+    
+    /** Bytes allocated by all threads that were not freed yet. */
+    [[nodiscard]] QITI_API static uint64_t getCurrentAmountHeapAllocatedInProcess() noexcept;
+    
+    /** Bytes of tracked allocations ever made by all threads (reallocations count as new allocations). */
+    [[nodiscard]] QITI_API static uint64_t getTotalAmountHeapAllocatedInProcess() noexcept;
+    
     [[nodiscard]] QITI_API static std::function<void()>& getOnNextHeapAllocation() noexcept;
     
     /**
@@ -85,6 +94,9 @@ public:
      Records the allocation size, updates thread-local counters, and executes
      any pending onNextHeapAllocation callback if set.
      
+     Allocations made while a blacklisted function is on the stack are ignored,
+     see addBlacklistedFunction().
+     
      Custom implementation details ignored if not currently in a Qiti test.
      */
     QITI_API static void mallocHook(std::size_t size) noexcept;
@@ -92,6 +104,9 @@ public:
     /**
      Hook invoked on each malloc call with pointer tracking for leak detection.
      
+     Counted allocations are recorded in the process-wide AllocationTable, so they
+     can be freed from any thread.
+     
      @param ptr Pointer returned by malloc (nullptr if allocation failed)
      @param size Size of allocation
      */
@@ -117,6 +132,18 @@ public:
                                                  std::size_t oldSize,
                                                  std::size_t newSize) noexcept;
     
+    /**
+     Never count heap allocations made while a function whose demangled name matches
+     the '*' glob is on the stack (e.g. "Catch::Section::Section*", the default).
+     
+     The stack is unwound with the unwind tables (frame pointers are not needed), and each
+     return address is only resolved to a function name the first time a thread sees it.
+     */
+    QITI_API_INTERNAL static void addBlacklistedFunction(const char* namePattern) noexcept;
+    
+    /** Removes the functions added with addBlacklistedFunction(), keeping the defaults. */
+    QITI_API_INTERNAL static void resetBlacklistedFunctions() noexcept;
+    
     // Deleted constructors/destructors
     MallocHooks() = delete;
     ~MallocHooks() = delete;
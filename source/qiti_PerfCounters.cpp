@@ -0,0 +1,285 @@
+
+/******************************************************************************
+ * Qiti — C++ Profiling Library
+ *
+ * @file     qiti_PerfCounters.cpp
+ *
+ * @author   Adam Shield
+ * @date     2026-10-16
+ *
+ * @copyright (c) 2025 Adam Shield
+ * SPDX-License-Identifier: MIT
+ *
+ * See LICENSE.txt for license terms.
+ ******************************************************************************/
+
+#include "qiti_PerfCounters.hpp"
+
+#include "qiti_MallocHooks.hpp"
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#ifdef __x86_64__
+#include <x86intrin.h>
+#endif
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+
+//--------------------------------------------------------------------------
+
+#ifdef __linux__
+namespace
+{
+struct CounterConfig
+{
+    uint32_t type;
+    uint64_t config;
+};
+
+/** perf_event_attr type and config of every PerfCounter, in the same order. */
+constexpr std::array<CounterConfig, qiti::PerfCounters::numCounters> g_counterConfigs
+{{
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+    { PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS },
+    { PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES }
+}};
+
+constexpr size_t firstSoftwareCounter = static_cast<size_t>(qiti::PerfCounter::pageFaults);
+} // namespace
+
+/** Counters of a thread that are read together, see PerfCounters. */
+struct CounterGroup
+{
+    static constexpr size_t maxNumMembers = qiti::PerfCounters::numCounters;
+
+    int leaderFd = -1;
+    uint32_t numMembers = 0;
+
+    // Of each member, in the order the kernel reports them (order of opening)
+    std::array<uint8_t, maxNumMembers> counters{}; // PerfCounter
+    std::array<int, maxNumMembers> fds{};
+    std::array<const volatile perf_event_mmap_page*, maxNumMembers> pages{}; // nullptr if not mmapped
+};
+
+/** Trivially destructible so reading it never registers a TLS destructor. */
+struct ThreadCounters
+{
+    CounterGroup hardware;
+    CounterGroup software;
+    bool isOpen = false;
+};
+
+/** This thread's counters. */
+static constinit thread_local ThreadCounters g_threadCounters{};
+
+QITI_API_INTERNAL static int openCounter(const CounterConfig& counterConfig, int groupFd) noexcept
+{
+    perf_event_attr attr{};
+    attr.size        = sizeof(attr);
+    attr.type        = counterConfig.type;
+    attr.config      = counterConfig.config;
+    attr.read_format = PERF_FORMAT_GROUP;
+    attr.exclude_hv  = 1;
+    if (groupFd < 0)
+        attr.pinned = 1; // only a leader can be pinned, which pins its group
+
+    // pid = 0, cpu = -1: the calling thread, on any CPU
+    auto fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, groupFd, PERF_FLAG_FD_CLOEXEC));
+    if (fd < 0 && (errno == EACCES || errno == EPERM))
+    {
+        // perf_event_paranoid >= 2 only allows counting userspace
+        attr.exclude_kernel = 1;
+        fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, groupFd, PERF_FLAG_FD_CLOEXEC));
+    }
+    return fd;
+}
+
+QITI_API_INTERNAL static void openGroup(CounterGroup& group, size_t firstCounter, size_t endCounter, bool mapPages) noexcept
+{
+    const auto pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+
+    for (auto counter = firstCounter; counter < endCounter; ++counter)
+    {
+        const auto fd = openCounter(g_counterConfigs[counter], group.leaderFd);
+        if (fd < 0)
+            continue; // e.g. no PMU, or this counter is not supported by it
+
+        if (group.leaderFd < 0)
+            group.leaderFd = fd;
+
+        const volatile perf_event_mmap_page* page = nullptr;
+        if (mapPages)
+        {
+            void* mapped = mmap(nullptr, pageSize, PROT_READ, MAP_SHARED, fd, 0);
+            if (mapped != MAP_FAILED)
+                page = static_cast<const volatile perf_event_mmap_page*>(mapped);
+        }
+
+        const auto member = group.numMembers++;
+        group.counters[member] = static_cast<uint8_t>(counter);
+        group.fds[member] = fd;
+        group.pages[member] = page;
+    }
+}
+
+QITI_API_INTERNAL static void closeGroup(CounterGroup& group) noexcept
+{
+    const auto pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+
+    // Members first, the leader last
+    for (auto member = group.numMembers; member-- > 0;)
+    {
+        if (group.pages[member] != nullptr)
+            munmap(const_cast<perf_event_mmap_page*>(group.pages[member]), pageSize);
+        close(group.fds[member]);
+    }
+    group = {};
+}
+
+/**
+ Closes this thread's counters when the thread exits.
+ Only touched when opening the counters, as registering its TLS destructor allocates.
+ */
+static thread_local struct ThreadCountersCloser final
+{
+    bool isArmed = false;
+
+    ~ThreadCountersCloser() noexcept
+    {
+        if (isArmed)
+        {
+            closeGroup(g_threadCounters.hardware);
+            closeGroup(g_threadCounters.software);
+            g_threadCounters.isOpen = false;
+        }
+    }
+} g_threadCountersCloser;
+
+QITI_API_INTERNAL static void openThreadCounters(ThreadCounters& counters) noexcept
+{
+    qiti::MallocHooks::ScopedBypassMallocHooks bypassMallocHooks;
+
+    openGroup(counters.hardware, 0, firstSoftwareCounter, true);
+    openGroup(counters.software, firstSoftwareCounter, qiti::PerfCounters::numCounters, false);
+    counters.isOpen = true;
+    g_threadCountersCloser.isArmed = true;
+}
+
+#ifdef __x86_64__
+/**
+ Reads every member of the group from userspace (see "struct perf_event_mmap_page" in linux/perf_event.h).
+ @returns false if a member cannot be read with rdpmc right now, e.g. not mmapped or not allowed.
+ */
+QITI_API_INTERNAL static bool readGroupWithRdpmc(const CounterGroup& group, qiti::PerfCounters::Values& values) noexcept
+{
+    for (uint32_t member = 0; member < group.numMembers; ++member)
+    {
+        const auto* page = group.pages[member];
+        if (page == nullptr)
+            return false;
+
+        uint32_t sequence;
+        int64_t count;
+        do
+        {
+            sequence = page->lock;
+            std::atomic_signal_fence(std::memory_order_acq_rel);
+
+            const auto index = page->index; // 0 if the counter is not on the PMU right now
+            if (! page->cap_user_rdpmc || index == 0)
+                return false;
+
+            // The counter is pmc_width bits wide, sign-extend it
+            const auto shift = 64 - page->pmc_width;
+            const auto pmc = static_cast<int64_t>(static_cast<uint64_t>(__rdpmc(static_cast<int>(index - 1))) << shift) >> shift;
+            count = page->offset + pmc;
+
+            std::atomic_signal_fence(std::memory_order_acq_rel);
+        }
+        while (page->lock != sequence);
+
+        values[group.counters[member]] = static_cast<uint64_t>(count);
+    }
+    return true;
+}
+#endif // __x86_64__
+
+/** Reads every member of the group at once with read() (PERF_FORMAT_GROUP). */
+QITI_API_INTERNAL static void readGroupWithSyscall(const CounterGroup& group, qiti::PerfCounters::Values& values) noexcept
+{
+    struct
+    {
+        uint64_t numMembers;
+        uint64_t values[CounterGroup::maxNumMembers];
+    } buffer;
+
+    // Nothing to read if the pinned group could not be scheduled (error state)
+    if (::read(group.leaderFd, &buffer, sizeof(buffer)) < static_cast<ssize_t>(sizeof(uint64_t)))
+        return;
+
+    const auto numMembers = std::min(static_cast<uint32_t>(buffer.numMembers), group.numMembers);
+    for (uint32_t member = 0; member < numMembers; ++member)
+        values[group.counters[member]] = buffer.values[member];
+}
+#endif // __linux__
+
+//--------------------------------------------------------------------------
+
+namespace qiti
+{
+
+std::atomic<bool> PerfCounters::enabled{false};
+
+bool PerfCounters::isAvailable([[maybe_unused]] PerfCounter counter) noexcept
+{
+#ifdef __linux__
+    auto& counters = g_threadCounters;
+    if (! counters.isOpen)
+        openThreadCounters(counters);
+
+    for (const auto* group : { &counters.hardware, &counters.software })
+    {
+        const auto* end = group->counters.begin() + group->numMembers;
+        if (std::find(group->counters.begin(), end, static_cast<uint8_t>(counter)) != end)
+            return true;
+    }
+#endif
+    return false;
+}
+
+void PerfCounters::read(Values& values) noexcept
+{
+    values.fill(0);
+
+#ifdef __linux__
+    auto& counters = g_threadCounters;
+    if (! counters.isOpen) [[unlikely]]
+        openThreadCounters(counters);
+
+    if (counters.hardware.leaderFd >= 0)
+    {
+#ifdef __x86_64__
+        if (! readGroupWithRdpmc(counters.hardware, values))
+#endif
+            readGroupWithSyscall(counters.hardware, values);
+    }
+
+    if (counters.software.leaderFd >= 0)
+        readGroupWithSyscall(counters.software, values);
+#endif
+}
+
+} // namespace qiti
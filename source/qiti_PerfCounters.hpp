@@ -0,0 +1,78 @@
+/******************************************************************************
+ * Qiti — C++ Profiling Library
+ *
+ * @file     qiti_PerfCounters.hpp
+ *
+ * @author   Adam Shield
+ * @date     2026-10-16
+ *
+ * @copyright (c) 2025 Adam Shield
+ * SPDX-License-Identifier: MIT
+ *
+ * See LICENSE.txt for license terms.
+ ******************************************************************************/
+
+#pragma once
+
+#include "qiti_API.hpp"
+
+#include "qiti_FunctionCallData.hpp"
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+//--------------------------------------------------------------------------
+// Doxygen - Begin Internal Documentation
+/** \cond INTERNAL */
+//--------------------------------------------------------------------------
+
+namespace qiti
+{
+//--------------------------------------------------------------------------
+/**
+ Per-thread perf_event_open() counters, read by the instrumentation hooks while enabled.
+
+ Every thread opens its counters on first use, in two groups (so the members of a group
+ are always counted over exactly the same interval):
+ - hardware (instructions, cycles, cache misses, branch misses): pinned, so it is never
+   multiplexed. Read with rdpmc through the mmap page of each counter on x86_64 when the
+   kernel allows it (no syscall), otherwise with a single read() of the whole group.
+ - software (page faults, context switches): kernel counters, one read() of the group.
+
+ Counters that cannot be opened (no PMU, e.g. in most VMs, or not permitted by
+ perf_event_paranoid) always read 0, see isAvailable(). Kernel activity is only counted
+ when the kernel allows it, context switches in particular need perf_event_paranoid < 2.
+
+ Only available on Linux, every counter reads 0 elsewhere.
+
+ @note This class is designed for internal use by the Qiti profiling system.
+ */
+class PerfCounters
+{
+public:
+    static constexpr size_t numCounters = static_cast<size_t>(PerfCounter::contextSwitches) + 1;
+
+    /** A reading of every counter of a thread, indexed by PerfCounter. */
+    using Values = std::array<uint64_t, numCounters>;
+
+    /** Whether the hooks read the counters of sampled calls, false by default. */
+    QITI_API_VAR static std::atomic<bool> enabled;
+
+    /** @returns true if the calling thread could open the counter (opens its counters on first use). */
+    [[nodiscard]] QITI_API static bool isAvailable(PerfCounter counter) noexcept;
+
+    /** Hot path: reads the calling thread's counters (opens them on first use). Unavailable counters read 0. */
+    QITI_API_INTERNAL static void read(Values& values) noexcept;
+
+    // Deleted constructors/destructors
+    PerfCounters() = delete;
+    ~PerfCounters() = delete;
+}; // class PerfCounters
+} // namespace qiti
+
+//--------------------------------------------------------------------------
+/** \endcond */
+// Doxygen - End Internal Documentation
+//--------------------------------------------------------------------------
@@ -15,12 +15,24 @@
 
 #include "qiti_Profile.hpp"
 
+#include "qiti_CallHistory.hpp"
+#include "qiti_Clock.hpp"
+#include "qiti_ContextTree.hpp"
+#include "qiti_DeferredEvents.hpp"
 #include "qiti_FunctionCallData_Impl.hpp"
 #include "qiti_FunctionCallData.hpp"
 #include "qiti_FunctionData_Impl.hpp"
 #include "qiti_FunctionData.hpp"
+#include "qiti_FunctionFilter.hpp"
+#include "qiti_FunctionRegistry.hpp"
+#include "qiti_LatencyHistogram.hpp"
+#include "qiti_LockHooks.hpp"
 #include "qiti_MallocHooks.hpp"
+#include "qiti_PerfCounters.hpp"
+#include "qiti_ResourceUsageCounters.hpp"
 #include "qiti_ScopedNoHeapAllocations.hpp"
+#include "qiti_Timeline.hpp"
+#include "qiti_XRayHooks.hpp"
 
 #ifdef _WIN32
 #include <windows.h>
@@ -32,41 +44,311 @@
 #include <unistd.h>
 #endif
 
+#include <atomic>
 #include <cassert>
 #include <cstring>
 #include <exception>
 #include <iostream>
+#include <limits>
 #include <memory>
 #include <mutex>
 #include <regex>
-#include <stack>
-#include <unordered_set>
 #include <utility>
 #include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
 
 
 namespace qiti
 {
 //--------------------------------------------------------------------------
 
-inline std::unordered_set<const void*> g_functionsToProfile;
-bool g_profileAllFunctions = false;
+static std::atomic<bool> g_profileAllFunctions{false};
 
-// Thread-local call stack to track caller relationships
-thread_local std::stack<qiti::FunctionData*> g_callStack;
+// Thread-local call stack to track caller relationships, see getCallStack()
+constinit thread_local FunctionData::Impl::CallStack* g_callStack = nullptr;
+
+/** Set once this thread freed its call stack, so the calls made while it exits are not profiled. */
+static constinit thread_local bool g_hasFreedCallStack = false;
+
+/** Frees this thread's call stack when it exits. */
+struct CallStackReleaser
+{
+    ~CallStackReleaser() noexcept
+    {
+        MallocHooks::ScopedBypassMallocHooks bypassMallocHooks;
+        
+        delete g_callStack;
+        g_callStack = nullptr;
+        g_hasFreedCallStack = true;
+    }
+};
+
+/**
+ @returns this thread's call stack, created by its first profiled call so the threads that never
+          profile anything don't pay for it, or nullptr once the thread is exiting.
+ */
+[[nodiscard]] static FunctionData::Impl::CallStack* getCallStack() noexcept
+{
+    if (g_callStack != nullptr) [[likely]]
+        return g_callStack;
+    if (g_hasFreedCallStack)
+        return nullptr;
+    
+    MallocHooks::ScopedBypassMallocHooks bypassMallocHooks;
+    
+    g_callStack = new FunctionData::Impl::CallStack();
+    static thread_local CallStackReleaser releaser; // registers the TLS destructor
+    (void)releaser;
+    return g_callStack;
+}
 
 static thread_local bool g_profilingEnabled = true;
 
-#ifndef _WIN32
-struct Init_g_functionsToProfile
+/**
+ Per-thread, single-entry cache in front of the FunctionRegistry.
+ 
+ The enter/exit hooks look up the same address at least twice in a row (once to
+ decide whether to profile it, once to update it) and leaf functions exit right after
+ they enter, so caching the last looked up function catches most lookups.
+ 
+ Trivially destructible on purpose: it is read on every instrumented call, including
+ from threads that never profile anything, and must not register a TLS destructor
+ (which would allocate inside ScopedNoHeapAllocations).
+ */
+struct LastFunctionCache
+{
+    uint64_t generation = 0;
+    const void* address = nullptr;
+    FunctionRegistry::Entry* entry = nullptr;
+};
+static constinit thread_local LastFunctionCache g_lastFunction{};
+
+/**
+ Shards released by threads that exited, by thread id. Once a thread is joined its id can be
+ reused, so a new thread with the same id detaches them from it (see claimThreadId()).
+ */
+struct ExitedThreads
 {
-    Init_g_functionsToProfile()
+    uint64_t generation = 0; // of the FunctionRegistry, the shards of other generations are destroyed
+    std::unordered_map<std::thread::id, std::vector<FunctionData::Impl::ThreadShard*>> shards;
+};
+
+using MutexType = std::mutex;
+using LockType = std::scoped_lock<MutexType>;
+
+/** Only locked when threads first profile a function or exit. */
+static MutexType g_exitedThreadsLock;
+
+/** The caller must hold g_exitedThreadsLock. */
+[[nodiscard]] static ExitedThreads& getExitedThreads() noexcept
+{
+    static ExitedThreads exitedThreads;
+    
+    const auto generation = FunctionRegistry::getGeneration();
+    if (exitedThreads.generation != generation)
     {
-        g_functionsToProfile.reserve(256); // automatically reserve on startup
+        exitedThreads.shards.clear();
+        exitedThreads.generation = generation;
     }
+    return exitedThreads;
+}
+
+/**
+ This thread's shards, indexed by FunctionRegistry::Entry::index, so the (locked)
+ FunctionData creation path is only taken once per thread per function.
+ Releases them when the thread exits, for the next threads to adopt.
+ 
+ Only accessed from within the hooks' ScopedBypassMallocHooks.
+ */
+struct ThreadShardCache
+{
+    ~ThreadShardCache() noexcept;
+    
+    uint64_t generation = 0;
+    bool hasClaimedThreadId = false;
+    std::vector<FunctionData::Impl::ThreadShard*> shards;
 };
-static const Init_g_functionsToProfile init_g_functionsToProfile;
-#endif
+static thread_local ThreadShardCache g_threadShards;
+
+ThreadShardCache::~ThreadShardCache() noexcept
+{
+    MallocHooks::ScopedBypassMallocHooks bypassMallocHooks;
+    LockHooks::LockBypassingHook<LockType, MutexType> lock(g_exitedThreadsLock);
+    
+    // Like FunctionRegistry::clear(), profiling must not be reset while threads are exiting
+    auto& exitedThreads = getExitedThreads();
+    if (generation != exitedThreads.generation)
+        return; // its shards have been destroyed
+    
+    std::vector<FunctionData::Impl::ThreadShard*>* exitedShards = nullptr;
+    for (auto* shard : shards)
+    {
+        if (shard == nullptr)
+            continue;
+        
+        if (exitedShards == nullptr)
+            exitedShards = &exitedThreads.shards[std::this_thread::get_id()];
+        exitedShards->push_back(shard);
+        shard->release();
+    }
+}
+
+/** Detaches the shards of an exited thread that had the same id from this thread. Once per thread. */
+static void claimThreadId() noexcept
+{
+    MallocHooks::ScopedBypassMallocHooks bypassMallocHooks;
+    LockHooks::LockBypassingHook<LockType, MutexType> lock(g_exitedThreadsLock);
+    
+    auto& exitedShards = getExitedThreads().shards;
+    const auto threadId = std::this_thread::get_id();
+    const auto it = exitedShards.find(threadId);
+    if (it == exitedShards.end())
+        return;
+    
+    for (auto* shard : it->second)
+    {
+        // Unless another thread adopted it since
+        auto expected = threadId;
+        shard->threadId.compare_exchange_strong(expected, std::thread::id{}, std::memory_order_relaxed);
+    }
+    exitedShards.erase(it);
+}
+
+/** @returns nullptr if the function was never registered. */
+[[nodiscard]] static FunctionRegistry::Entry* findRegistryEntry(const void* this_fn) noexcept
+{
+    auto& cache = g_lastFunction;
+    
+    // Entries from a previous generation have been destroyed
+    const auto generation = FunctionRegistry::getGeneration();
+    if (cache.address == this_fn && cache.generation == generation)
+        return cache.entry;
+    
+    auto* entry = FunctionRegistry::find(this_fn);
+    if (entry != nullptr) // don't cache misses, the function may be registered later on by another thread
+    {
+        cache.generation = generation;
+        cache.address = this_fn;
+        cache.entry = entry;
+    }
+    return entry;
+}
+
+/** @returns nullptr if this thread has no shard for the function yet. */
+[[nodiscard]] static FunctionData::Impl::ThreadShard* getCachedThreadShard(const void* this_fn) noexcept
+{
+    auto& cache = g_threadShards;
+    
+    const auto generation = FunctionRegistry::getGeneration();
+    if (cache.generation != generation) [[unlikely]]
+    {
+        // Shards from a previous generation have been destroyed
+        cache.shards.clear();
+        cache.generation = generation;
+        
+        // Stack entries would be dangling as well
+        if (g_callStack != nullptr)
+            g_callStack->clear();
+    }
+    
+    const auto* entry = findRegistryEntry(this_fn);
+    if (entry == nullptr)
+        return nullptr;
+    
+    const auto& shards = cache.shards;
+    return (entry->index < shards.size()) ? shards[entry->index] : nullptr;
+}
+
+/** Creates this thread's shard of functionData (first call of the function on this thread). */
+[[nodiscard]] static FunctionData::Impl::ThreadShard* createThreadShard(const void* this_fn,
+                                                                        FunctionData& functionData) noexcept
+{
+    const auto* entry = findRegistryEntry(this_fn);
+    assert(entry != nullptr && "FunctionData is always registered");
+    
+    auto& cache = g_threadShards;
+    if (! cache.hasClaimedThreadId) [[unlikely]]
+    {
+        claimThreadId();
+        cache.hasClaimedThreadId = true;
+    }
+    
+    auto* shard = functionData.getImpl()->acquireThreadShard(&functionData);
+    
+    auto& shards = cache.shards;
+    if (shards.size() <= entry->index)
+        shards.resize(entry->index + 1, nullptr);
+    shards[entry->index] = shard;
+    
+    return shard;
+}
+
+/** The measured part of the enter hook: starts a call of the shard's function on callStack. */
+static void beginMeasuredCall(FunctionData::Impl::ThreadShard& shard, FunctionData::Impl::CallStack& callStack) noexcept
+{
+    qiti::ScopedNoHeapAllocations noAlloc;
+    
+    auto* frame = shard.beginCall(callStack);
+    if (frame == nullptr)
+        return; // not sampled, only counted
+    
+    frame->numHeapAllocationsBeforeFunctionCall = qiti::MallocHooks::getNumHeapAllocationsOnCurrentThread();
+    frame->amountHeapAllocatedBeforeFunctionCall = qiti::MallocHooks::getTotalAmountHeapAllocatedOnCurrentThread();
+    
+    // Before the timestamps, so reading the counters is not measured as time spent in the function
+    if (PerfCounters::enabled.load(std::memory_order_relaxed)) [[unlikely]]
+    {
+        PerfCounters::read(callStack.getPerfCountersAtStart(*frame));
+        frame->hasPerfCounters = true;
+    }
+    if (ResourceUsageCounters::enabled.load(std::memory_order_relaxed)) [[unlikely]]
+    {
+        ResourceUsageCounters::read(callStack.getResourceUsageAtStart(*frame));
+        frame->hasResourceUsage = true;
+    }
+    
+    // Grab starting times last without doing additional work after
+    frame->startTicksWallClock = Clock::startTimestamp();
+    frame->startTimeCpu_ns = Clock::threadCpuTime_ns(); // last to be most precise
+}
+
+/** The measured part of the exit hook: ends the call of frame, given the end times taken first thing by the hook. */
+static void endMeasuredCall(FunctionData::Impl::ThreadShard& shard,
+                            FunctionData::Impl::CallStack& callStack,
+                            const FunctionData::Impl::CallFrame* frame,
+                            bool isMeasured,
+                            uint64_t clockEndTicks,
+                            uint64_t cpuEndTime_ns) noexcept
+{
+    qiti::ScopedNoHeapAllocations noAlloc;
+    
+    // The stack may have been cleared by the lookup (reset), or not match if profiling started mid-call
+    if (! isMeasured || callStack.top() != frame || frame->shard != &shard)
+    {
+        shard.endUnsampledCall(callStack);
+        return;
+    }
+    
+    PerfCounters::Values perfCountersAtEnd;
+    const bool hasPerfCounters = frame->hasPerfCounters;
+    if (hasPerfCounters) [[unlikely]]
+        PerfCounters::read(perfCountersAtEnd);
+    
+    ResourceUsageCounters::Values resourceUsageAtEnd;
+    const bool hasResourceUsage = frame->hasResourceUsage;
+    if (hasResourceUsage) [[unlikely]]
+        ResourceUsageCounters::read(resourceUsageAtEnd);
+    
+    shard.endCall(callStack,
+                  clockEndTicks,
+                  cpuEndTime_ns,
+                  qiti::MallocHooks::getNumHeapAllocationsOnCurrentThread(),
+                  qiti::MallocHooks::getTotalAmountHeapAllocatedOnCurrentThread(),
+                  hasPerfCounters ? &perfCountersAtEnd : nullptr,
+                  hasResourceUsage ? &resourceUsageAtEnd : nullptr);
+}
 
 //--------------------------------------------------------------------------
 
@@ -83,35 +365,201 @@ Profile::ScopedDisableProfiling::~ScopedDisableProfiling() noexcept
 
 //--------------------------------------------------------------------------
 
+std::atomic<bool> Profile::hooksActive{false};
+
 void Profile::resetProfiling() noexcept
-{        
-    g_functionsToProfile.clear();
-    g_profileAllFunctions = false;
+{
+    hooksActive.store(false, std::memory_order_relaxed);
+    for (auto* entry : FunctionRegistry::getAllEntries())
+        entry->isProfiled.store(false, std::memory_order_relaxed);
+    g_profileAllFunctions.store(false, std::memory_order_relaxed);
+    XRayHooks::unpatchAllFunctions();
+    FunctionFilter::clearRules();
+    MallocHooks::resetBlacklistedFunctions();
+    FunctionData::Impl::defaultSamplingRate.store(FunctionData::Impl::SamplingRate::everyNthCall(1), std::memory_order_relaxed);
+    CallHistory::capacityPerFunction.store(0, std::memory_order_relaxed);
+    LatencyHistogram::enabled.store(false, std::memory_order_relaxed);
+    PerfCounters::enabled.store(false, std::memory_order_relaxed);
+    ResourceUsageCounters::enabled.store(false, std::memory_order_relaxed);
+    FunctionData::Impl::compensateOverhead.store(true, std::memory_order_relaxed);
     qiti::MallocHooks::getNumHeapAllocationsOnCurrentThread() = 0u;
     qiti::MallocHooks::getTotalAmountHeapAllocatedOnCurrentThread() = 0ull;
 }
 
-void Profile::beginProfilingFunction(const void* functionAddress, const char* functionName) noexcept
+void Profile::calibrateOverhead() noexcept
 {
-    g_functionsToProfile.insert(functionAddress); // automatically skips duplicates
+    static constexpr uint32_t numRounds = 16;
+    static constexpr uint32_t numNestedCallsPerRound = 64;
+    
+    using SamplingRate = FunctionData::Impl::SamplingRate;
+    
+    MallocHooks::ScopedBypassMallocHooks bypassMallocHooks;
+    
+    // Stand-ins for a profiled function calling another one, never registered so no test sees them.
+    // They follow the current configuration (histograms, call history...) like any profiled function.
+    static const char outerFunction = 0;
+    static const char innerFunction = 0;
+    static const char unsampledInnerFunction = 0;
+    FunctionData outer(&outerFunction, "<qiti overhead calibration>", FunctionData::FunctionType::regular);
+    FunctionData inner(&innerFunction, "<qiti overhead calibration>", FunctionData::FunctionType::regular);
+    FunctionData unsampledInner(&unsampledInnerFunction, "<qiti overhead calibration>", FunctionData::FunctionType::regular);
+    
+    // Always/never sampled, the same way (counting or drawing random numbers) as the default rate samples
+    const bool isSamplingAtRandom = FunctionData::Impl::defaultSamplingRate.load(std::memory_order_relaxed).randomThreshold != 0;
+    outer.getImpl()->samplingRate.store(SamplingRate::everyNthCall(1), std::memory_order_relaxed);
+    inner.getImpl()->samplingRate.store(isSamplingAtRandom ? SamplingRate{ 0, std::numeric_limits<uint32_t>::max() }
+                                                           : SamplingRate::everyNthCall(1),
+                                        std::memory_order_relaxed);
+    unsampledInner.getImpl()->samplingRate.store(isSamplingAtRandom ? SamplingRate{ 0, 1 }
+                                                                    : SamplingRate::everyNthCall(std::numeric_limits<uint32_t>::max()),
+                                                 std::memory_order_relaxed);
+    auto& outerShard = *outer.getImpl()->addThreadShard(&outer);
+    auto& innerShard = *inner.getImpl()->addThreadShard(&inner);
+    auto& unsampledInnerShard = *unsampledInner.getImpl()->addThreadShard(&unsampledInner);
     
-    // This adds the function to our function map
+    // Calling-context tree and timeline of their own, which no test sees either
+    auto callStack = std::make_unique<FunctionData::Impl::CallStack>();
+    const auto contextTree = ContextTree::createUnlistedTree(callStack->contextTreeGeneration);
+    const auto timelineBuffer = Timeline::createUnlistedBuffer(callStack->timelineGeneration, std::this_thread::get_id());
+    callStack->contextTree = contextTree.get();
+    callStack->timelineBuffer = timelineBuffer.get();
+    
+    // Measure the raw overhead
+    FunctionData::Impl::overheadTicksWallClockPerNestedCall.store(0, std::memory_order_relaxed);
+    FunctionData::Impl::overheadNanosecondsCpuPerNestedCall.store(0, std::memory_order_relaxed);
+    FunctionData::Impl::overheadTicksWallClockPerUnsampledNestedCall.store(0, std::memory_order_relaxed);
+    FunctionData::Impl::overheadNanosecondsCpuPerUnsampledNestedCall.store(0, std::memory_order_relaxed);
+    
+    // Like the enter and exit hooks (only sampled calls take timestamps)
+    const auto callMeasured = [&callStack](FunctionData::Impl::ThreadShard& shard, auto&& body)
+    {
+        beginMeasuredCall(shard, *callStack);
+        body();
+        
+        const auto* frame = callStack->top();
+        const bool isMeasured = (frame != nullptr && frame->isSampled);
+        uint64_t cpuEndTime_ns = 0;
+        uint64_t clockEndTicks = 0;
+        if (isMeasured)
+        {
+            cpuEndTime_ns = Clock::threadCpuTime_ns();
+            clockEndTicks = Clock::endTimestamp();
+        }
+        endMeasuredCall(shard, *callStack, frame, isMeasured, clockEndTicks, cpuEndTime_ns);
+    };
+    
+    // Uses up the first call, which is always sampled
+    callMeasured(unsampledInnerShard, []{});
+    
+    // The fastest round is the one least disturbed (preemption, cache misses...)
+    auto overheadTicksWallClock = std::numeric_limits<uint64_t>::max();
+    auto overheadNanosecondsCpu = std::numeric_limits<uint64_t>::max();
+    auto unsampledOverheadTicksWallClock = std::numeric_limits<uint64_t>::max();
+    auto unsampledOverheadNanosecondsCpu = std::numeric_limits<uint64_t>::max();
+    auto emptyCallTicksWallClock = std::numeric_limits<uint64_t>::max();
+    auto emptyCallNanosecondsCpu = std::numeric_limits<uint64_t>::max();
+    for (uint32_t round = 0; round < numRounds; ++round)
+    {
+        const auto outerTicksBefore = outerShard.totalTimeSpentInFunctionTicksWallClock.load(std::memory_order_relaxed);
+        const auto outerCpuBefore = outerShard.totalTimeSpentInFunctionNanosecondsCpu.load(std::memory_order_relaxed);
+        const auto innerTicksBefore = innerShard.totalTimeSpentInFunctionTicksWallClock.load(std::memory_order_relaxed);
+        const auto innerCpuBefore = innerShard.totalTimeSpentInFunctionNanosecondsCpu.load(std::memory_order_relaxed);
+        
+        callMeasured(outerShard, [&]
+        {
+            for (uint32_t i = 0; i < numNestedCallsPerRound; ++i)
+                callMeasured(innerShard, []{});
+        });
+        
+        // What the outer call measured beyond its nested calls is the overhead of their hooks
+        const auto outerTicks = outerShard.totalTimeSpentInFunctionTicksWallClock.load(std::memory_order_relaxed) - outerTicksBefore;
+        const auto outerCpu = outerShard.totalTimeSpentInFunctionNanosecondsCpu.load(std::memory_order_relaxed) - outerCpuBefore;
+        const auto innerTicks = innerShard.totalTimeSpentInFunctionTicksWallClock.load(std::memory_order_relaxed) - innerTicksBefore;
+        const auto innerCpu = innerShard.totalTimeSpentInFunctionNanosecondsCpu.load(std::memory_order_relaxed) - innerCpuBefore;
+        
+        overheadTicksWallClock = std::min(overheadTicksWallClock, (outerTicks - std::min(innerTicks, outerTicks)) / numNestedCallsPerRound);
+        overheadNanosecondsCpu = std::min(overheadNanosecondsCpu, (outerCpu - std::min(innerCpu, outerCpu)) / numNestedCallsPerRound);
+        emptyCallTicksWallClock = std::min(emptyCallTicksWallClock, innerTicks / numNestedCallsPerRound);
+        emptyCallNanosecondsCpu = std::min(emptyCallNanosecondsCpu, innerCpu / numNestedCallsPerRound);
+        
+        // Unsampled calls measure nothing, all the outer call measured is the overhead of their hooks
+        const auto unsampledOuterTicksBefore = outerShard.totalTimeSpentInFunctionTicksWallClock.load(std::memory_order_relaxed);
+        const auto unsampledOuterCpuBefore = outerShard.totalTimeSpentInFunctionNanosecondsCpu.load(std::memory_order_relaxed);
+        
+        callMeasured(outerShard, [&]
+        {
+            for (uint32_t i = 0; i < numNestedCallsPerRound; ++i)
+                callMeasured(unsampledInnerShard, []{});
+        });
+        
+        const auto unsampledOuterTicks = outerShard.totalTimeSpentInFunctionTicksWallClock.load(std::memory_order_relaxed) - unsampledOuterTicksBefore;
+        const auto unsampledOuterCpu = outerShard.totalTimeSpentInFunctionNanosecondsCpu.load(std::memory_order_relaxed) - unsampledOuterCpuBefore;
+        unsampledOverheadTicksWallClock = std::min(unsampledOverheadTicksWallClock, unsampledOuterTicks / numNestedCallsPerRound);
+        unsampledOverheadNanosecondsCpu = std::min(unsampledOverheadNanosecondsCpu, unsampledOuterCpu / numNestedCallsPerRound);
+    }
+    
+    // The hooks then only push records (sampled or not), and the replayed calls carry the overhead of those pushes instead
+    if (DeferredEvents::isEnabled())
+    {
+        overheadTicksWallClock = overheadNanosecondsCpu = std::numeric_limits<uint64_t>::max();
+        emptyCallTicksWallClock = emptyCallNanosecondsCpu = std::numeric_limits<uint64_t>::max();
+        for (uint32_t round = 0; round < numRounds; ++round)
+        {
+            const auto overhead = DeferredEvents::measureOverhead(numNestedCallsPerRound);
+            overheadTicksWallClock = std::min(overheadTicksWallClock, overhead.ticksWallClockPerNestedCall);
+            overheadNanosecondsCpu = std::min(overheadNanosecondsCpu, overhead.nanosecondsCpuPerNestedCall);
+            emptyCallTicksWallClock = std::min(emptyCallTicksWallClock, overhead.emptyCallTicksWallClock);
+            emptyCallNanosecondsCpu = std::min(emptyCallNanosecondsCpu, overhead.emptyCallNanosecondsCpu);
+        }
+        unsampledOverheadTicksWallClock = overheadTicksWallClock;
+        unsampledOverheadNanosecondsCpu = overheadNanosecondsCpu;
+    }
+    
+    FunctionData::Impl::overheadTicksWallClockPerNestedCall.store(overheadTicksWallClock, std::memory_order_relaxed);
+    FunctionData::Impl::overheadNanosecondsCpuPerNestedCall.store(overheadNanosecondsCpu, std::memory_order_relaxed);
+    FunctionData::Impl::overheadTicksWallClockPerUnsampledNestedCall.store(unsampledOverheadTicksWallClock, std::memory_order_relaxed);
+    FunctionData::Impl::overheadNanosecondsCpuPerUnsampledNestedCall.store(unsampledOverheadNanosecondsCpu, std::memory_order_relaxed);
+    FunctionData::Impl::emptyCallTicksWallClock.store(emptyCallTicksWallClock, std::memory_order_relaxed);
+    FunctionData::Impl::emptyCallNanosecondsCpu.store(emptyCallNanosecondsCpu, std::memory_order_relaxed);
+}
+
+void Profile::beginProfilingFunction(const void* functionAddress, const char* functionName) noexcept
+{
+    // This adds the function to our function registry
     (void)FunctionDataUtils::getFunctionDataFromAddress(functionAddress, functionName);
+    
+    FunctionRegistry::findOrInsert(functionAddress).isProfiled.store(true, std::memory_order_relaxed);
+    hooksActive.store(true, std::memory_order_relaxed);
+    XRayHooks::patchFunction(functionAddress);
 }
 
 void Profile::endProfilingFunction(const void* functionAddress) noexcept
 {
-    g_functionsToProfile.erase(functionAddress);
+    if (auto* entry = FunctionRegistry::find(functionAddress))
+        entry->isProfiled.store(false, std::memory_order_relaxed);
+    
+    if (! g_profileAllFunctions.load(std::memory_order_relaxed))
+        XRayHooks::unpatchFunction(functionAddress);
 }
 
 void Profile::beginProfilingAllFunctions() noexcept
 {
-    g_profileAllFunctions = true;
+    g_profileAllFunctions.store(true, std::memory_order_relaxed);
+    hooksActive.store(true, std::memory_order_relaxed);
+    XRayHooks::patchAllFunctions();
 }
 
 void Profile::endProfilingAllFunctions() noexcept
 {
-    g_profileAllFunctions = false;
+    g_profileAllFunctions.store(false, std::memory_order_relaxed);
+    
+    // Only keep the sleds of explicitly profiled functions
+    XRayHooks::unpatchAllFunctions();
+    for (auto* entry : FunctionRegistry::getAllEntries())
+    {
+        if (entry->isProfiled.load(std::memory_order_relaxed))
+            XRayHooks::patchFunction(entry->address);
+    }
 }
 
 bool Profile::isProfilingFunction(const void* funcAddress) noexcept
@@ -122,41 +570,29 @@ bool Profile::isProfilingFunction(const void* funcAddress) noexcept
     if (! g_profilingEnabled)
         return false;
     
-    if (g_functionsToProfile.contains(funcAddress))
+    auto* entry = findRegistryEntry(funcAddress);
+    if (entry != nullptr && entry->isProfiled.load(std::memory_order_relaxed))
         return true;
     
-    if (! g_profileAllFunctions)
+    if (! g_profileAllFunctions.load(std::memory_order_relaxed))
         return false;
     
-    // When profiling all functions, skip templated functions that use qiti types as
-    // template parameters (e.g. std::vector<qiti::FunctionData*>)
-    Dl_info info;
-    if (dladdr(funcAddress, &info) && info.dli_sname)
+    // Profiling all functions: evaluate the user's filter rules once per function
+    if (entry == nullptr)
     {
-#ifdef _WIN32
-        // Windows: Use UnDecorateSymbolName for demangling
-        char buffer[1024];
-        if (UnDecorateSymbolName(info.dli_sname, buffer, sizeof(buffer), UNDNAME_COMPLETE))
-        {
-            bool shouldSkip = strstr(buffer, "<qiti::") != nullptr;
-            if (shouldSkip)
-                return false;
-        }
-#else
-        int status = 0;
-        char* demangled = abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status);
-        
-        if (status == 0 && demangled)
-        {
-            bool shouldSkip = strstr(demangled, "<qiti::") != nullptr;
-            free(demangled);
-            if (shouldSkip)
-                return false;
-        }
-#endif
+        MallocHooks::ScopedBypassMallocHooks bypassMallocHooks;
+        entry = &FunctionRegistry::findOrInsert(funcAddress);
     }
     
-    return true;
+    auto decision = entry->filterDecision.load(std::memory_order_relaxed);
+    if (decision == FunctionRegistry::FilterDecision::unknown) [[unlikely]]
+    {
+        decision = FunctionFilter::shouldProfile(funcAddress) ? FunctionRegistry::FilterDecision::included
+                                                              : FunctionRegistry::FilterDecision::excluded;
+        entry->filterDecision.store(decision, std::memory_order_relaxed);
+    }
+    
+    return decision == FunctionRegistry::FilterDecision::included;
 }
 
 void Profile::beginProfilingType(std::type_index /*functionAddress*/) noexcept
@@ -181,131 +617,67 @@ uint64_t Profile::getAmountHeapAllocatedOnCurrentThread() noexcept
 
 void Profile::updateFunctionDataOnEnter(const void* this_fn) noexcept
 {
-    // Update FunctionData
-    auto& functionData = FunctionDataUtils::getFunctionDataFromAddress(this_fn);
-    
-    qiti::ScopedNoHeapAllocations noAlloc; // TODO: can we move this up to very top?
-    
-    auto* impl = functionData.getImpl();
-    functionData.functionCalled();
-    
-    for (auto* listener : impl->listeners)
-        listener->onFunctionEnter(&functionData);
-    
-    // Update FunctionCallData
-    impl->lastCallData.reset(); // Deletes previous impl
-    
-    // Track caller relationship - check if there's a caller on the stack
-    const FunctionData* caller = nullptr;
-    if (! g_callStack.empty())
+    if (DeferredEvents::isEnabled())
     {
-        caller = g_callStack.top();
-        if (caller != nullptr)
-            impl->callers.insert(caller);
+        DeferredEvents::pushFunctionEnter(this_fn);
+        return;
     }
     
-    // Push this function onto the call stack
-    g_callStack.push(&functionData);
+    auto* callStack = getCallStack();
+    if (callStack == nullptr) [[unlikely]]
+        return; // thread exiting
     
-    auto* lastCallImpl = impl->lastCallData.getImpl();
-    lastCallImpl->caller = caller;
-    lastCallImpl->callingThread = std::this_thread::get_id();
-    lastCallImpl->numHeapAllocationsBeforeFunctionCall = qiti::MallocHooks::getNumHeapAllocationsOnCurrentThread();
-    lastCallImpl->amountHeapAllocatedBeforeFunctionCall = qiti::MallocHooks::getTotalAmountHeapAllocatedOnCurrentThread();
+    // Get this thread's shard, only touching the (locked) FunctionData creation on first use
+    auto* shard = getCachedThreadShard(this_fn);
+    if (shard == nullptr) [[unlikely]]
+    {
+        // Creating the FunctionData (demangling, filtering...) is far slower than the calibrated
+        // hook overhead, so measure it for the calls it is nested in to subtract it
+        const auto startTimeCpu_ns = Clock::threadCpuTime_ns();
+        const auto startTicksWallClock = Clock::startTimestamp();
+        
+        shard = createThreadShard(this_fn, FunctionDataUtils::getFunctionDataFromAddress(this_fn));
+        
+        if (auto* parent = callStack->top())
+        {
+            parent->hookOverheadTicksWallClock += Clock::endTimestamp() - startTicksWallClock;
+            parent->hookOverheadTimeCpu_ns += Clock::threadCpuTime_ns() - startTimeCpu_ns;
+        }
+    }
     
-    // Grab starting times last without doing additional work after
-    lastCallImpl->startTimeWallClock = std::chrono::steady_clock::now();
-#ifndef _WIN32 // CPU Time feature not supported on Windows
-    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &lastCallImpl->startTimeCpu); // last to be most precise
-#endif
+    beginMeasuredCall(*shard, *callStack);
 }
 
 void Profile::updateFunctionDataOnExit(const void* this_fn) noexcept
 {
-    qiti::ScopedNoHeapAllocations noAlloc;
-    
-    auto& functionData = FunctionDataUtils::getFunctionDataFromAddress(this_fn);
-    auto* impl = functionData.getImpl();
-    auto* callImpl = impl->lastCallData.getImpl();
-    timespec cpuEndTime;
-    
-    // Get end times immediately before doing any other work
-#if ! defined(_WIN32) // feature not supported on Windows
-    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpuEndTime); // first to be most precise
-#endif
-    const auto clockEndTime = std::chrono::steady_clock::now();
-    
-    // Get elapsed times
-    const auto cpuElapsed_ns =
-        (static_cast<uint64_t>(cpuEndTime.tv_sec - callImpl->startTimeCpu.tv_sec) * 1'000'000'000ULL) +
-        (static_cast<uint64_t>(cpuEndTime.tv_nsec) - static_cast<uint64_t>(callImpl->startTimeCpu.tv_nsec));
-    const auto clockElapsed_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(clockEndTime - callImpl->startTimeWallClock);
-
-    // Update FunctionCallData (before updating listeners in case listeners need that information)
-    callImpl->endTimeWallClock = clockEndTime;
-    callImpl->endTimeCpu = cpuEndTime;
-    callImpl->timeSpentInFunctionNanosecondsWallClock = static_cast<uint64_t>(clockElapsed_ns.count());
-    callImpl->timeSpentInFunctionNanosecondsCpu = cpuElapsed_ns;
-    callImpl->numHeapAllocationsAfterFunctionCall = qiti::MallocHooks::getNumHeapAllocationsOnCurrentThread();
-    callImpl->amountHeapAllocatedAfterFunctionCall = qiti::MallocHooks::getTotalAmountHeapAllocatedOnCurrentThread();
-    
-    // Update listeners
-    for (auto* listener : impl->listeners)
-        listener->onFunctionExit(&functionData);
-    
-    // Update average time spent in function (must be after FunctionCallData is finished)
-    if(impl->averageTimeSpentInFunctionNanosecondsWallClock == 0)
-        impl->averageTimeSpentInFunctionNanosecondsWallClock = callImpl->timeSpentInFunctionNanosecondsWallClock;
-    else
+    if (DeferredEvents::isEnabled())
     {
-        const auto currentAverage = impl->averageTimeSpentInFunctionNanosecondsWallClock;
-        auto effectiveTotal = currentAverage * (impl->numTimesCalled-1);
-        effectiveTotal += callImpl->timeSpentInFunctionNanosecondsWallClock;
-        const auto newAverage = (impl->numTimesCalled > 0) // prevent divide by zero
-                                ? (effectiveTotal / impl->numTimesCalled)
-                                : 0;
-        impl->averageTimeSpentInFunctionNanosecondsWallClock = newAverage;
+        DeferredEvents::pushFunctionExit(this_fn);
+        return;
     }
     
-    if(impl->averageTimeSpentInFunctionNanosecondsCpu == 0)
-        impl->averageTimeSpentInFunctionNanosecondsCpu = callImpl->timeSpentInFunctionNanosecondsCpu;
-    else
-    {
-        const auto currentAverage = impl->averageTimeSpentInFunctionNanosecondsCpu;
-        auto effectiveTotal = currentAverage * (impl->numTimesCalled-1);
-        effectiveTotal += callImpl->timeSpentInFunctionNanosecondsCpu;
-        const auto newAverage = (impl->numTimesCalled > 0) // prevent divide by zero
-                                ? (effectiveTotal / impl->numTimesCalled)
-                                : 0;
-        impl->averageTimeSpentInFunctionNanosecondsCpu = newAverage;
-    }
+    auto* callStack = getCallStack();
+    if (callStack == nullptr) [[unlikely]]
+        return; // thread exiting
     
-    // Update min/max time spent in function (wall clock)
-    if(impl->minTimeSpentInFunctionNanosecondsWallClock == 0 || 
-       callImpl->timeSpentInFunctionNanosecondsWallClock < impl->minTimeSpentInFunctionNanosecondsWallClock)
-    {
-        impl->minTimeSpentInFunctionNanosecondsWallClock = callImpl->timeSpentInFunctionNanosecondsWallClock;
-    }
-    if(callImpl->timeSpentInFunctionNanosecondsWallClock > impl->maxTimeSpentInFunctionNanosecondsWallClock)
-    {
-        impl->maxTimeSpentInFunctionNanosecondsWallClock = callImpl->timeSpentInFunctionNanosecondsWallClock;
-    }
+    // Unsampled (or too deeply nested) calls have nothing to measure
+    const auto* frame = callStack->top();
+    const bool isMeasured = (frame != nullptr && frame->isSampled);
     
-    // Update min/max time spent in function (CPU)
-    if(impl->minTimeSpentInFunctionNanosecondsCpu == 0 || 
-       callImpl->timeSpentInFunctionNanosecondsCpu < impl->minTimeSpentInFunctionNanosecondsCpu)
-    {
-        impl->minTimeSpentInFunctionNanosecondsCpu = callImpl->timeSpentInFunctionNanosecondsCpu;
-    }
-    if(callImpl->timeSpentInFunctionNanosecondsCpu > impl->maxTimeSpentInFunctionNanosecondsCpu)
+    // Get end times immediately before doing any other work
+    uint64_t cpuEndTime_ns = 0;
+    uint64_t clockEndTicks = 0;
+    if (isMeasured)
     {
-        impl->maxTimeSpentInFunctionNanosecondsCpu = callImpl->timeSpentInFunctionNanosecondsCpu;
+        cpuEndTime_ns = Clock::threadCpuTime_ns(); // first to be most precise
+        clockEndTicks = Clock::endTimestamp();
     }
     
-    // Pop this function from the call stack
-    if (! g_callStack.empty())
-    {
-        g_callStack.pop();
-    }
+    // Get this thread's shard, only touching the (locked) FunctionData creation on first use
+    auto* shard = getCachedThreadShard(this_fn);
+    if (shard == nullptr) [[unlikely]]
+        shard = createThreadShard(this_fn, FunctionDataUtils::getFunctionDataFromAddress(this_fn));
+    
+    endMeasuredCall(*shard, *callStack, frame, isMeasured, clockEndTicks, cpuEndTime_ns);
 }
 } // namespace qiti
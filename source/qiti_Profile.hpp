@@ -18,8 +18,8 @@
 #include "qiti_API.hpp"
 
 #include <array>
+#include <atomic>
 #include <cstdint>
-#include <stack>
 #include <string>
 #include <type_traits>
 #include <typeindex>
@@ -33,8 +33,6 @@ namespace qiti
 //--------------------------------------------------------------------------
 
 class FunctionData;
-// Forward declaration for external access
-extern thread_local std::stack<qiti::FunctionData*> g_callStack;
 
 namespace FunctionNameHelpers
 {
@@ -144,6 +142,23 @@ public:
      */
     QITI_API static void resetProfiling() noexcept;
     
+    /**
+     Measures the overhead of the instrumentation hooks with the current configuration (clocks,
+     sampling, histograms, call history, calling-context trees, timeline...), by timing sampled
+     and unsampled calls of stand-in functions nested in another.
+     
+     Every profiled call adds the time its hooks take to the measured time of all the profiled
+     calls it is nested in. endCall() subtracts this overhead again. Called when a ScopedQitiTest
+     starts and whenever a setting that changes the cost of the hooks changes.
+     
+     While deferred aggregation is enabled, the overhead measured is that of the ring pushes
+     the hooks do instead (see DeferredEvents::measureOverhead()).
+     
+     @note Per-function listeners are timed by the hooks themselves instead. Looking up the
+           called function is not included, so the estimate errs on the low side.
+     */
+    QITI_API static void calibrateOverhead() noexcept;
+    
     /**
      Begins profiling for a free function.
      
@@ -313,6 +328,15 @@ private:
     friend class Instrument;
     friend class InstrumentHooks;
     
+    /**
+     Whether the instrumentation hooks have anything to do. Set once any function is profiled (or
+     all of them are) or a thread creation callback is registered, cleared by resetProfiling().
+     
+     The exported hooks check it before anything else, so while nothing is profiled every
+     instrumented call only pays for a single relaxed load.
+     */
+    QITI_API_VAR static std::atomic<bool> hooksActive;
+    
     /**
      Updates profiling data when a function is entered.
 
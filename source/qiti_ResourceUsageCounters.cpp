@@ -0,0 +1,62 @@
+
+/******************************************************************************
+ * Qiti — C++ Profiling Library
+ *
+ * @file     qiti_ResourceUsageCounters.cpp
+ *
+ * @author   Adam Shield
+ * @date     2026-10-16
+ *
+ * @copyright (c) 2025 Adam Shield
+ * SPDX-License-Identifier: MIT
+ *
+ * See LICENSE.txt for license terms.
+ ******************************************************************************/
+
+#include "qiti_ResourceUsageCounters.hpp"
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+#include <atomic>
+#include <cstdint>
+
+//--------------------------------------------------------------------------
+
+namespace qiti
+{
+
+std::atomic<bool> ResourceUsageCounters::enabled{false};
+
+bool ResourceUsageCounters::isAvailable() noexcept
+{
+#ifdef RUSAGE_THREAD
+    return true;
+#else
+    return false;
+#endif
+}
+
+void ResourceUsageCounters::read(Values& values) noexcept
+{
+#ifdef RUSAGE_THREAD
+    rusage usage{};
+    if (getrusage(RUSAGE_THREAD, &usage) != 0)
+    {
+        values.fill(0);
+        return;
+    }
+
+    values[static_cast<size_t>(ResourceUsage::minorPageFaults)]            = static_cast<uint64_t>(usage.ru_minflt);
+    values[static_cast<size_t>(ResourceUsage::majorPageFaults)]            = static_cast<uint64_t>(usage.ru_majflt);
+    values[static_cast<size_t>(ResourceUsage::voluntaryContextSwitches)]   = static_cast<uint64_t>(usage.ru_nvcsw);
+    values[static_cast<size_t>(ResourceUsage::involuntaryContextSwitches)] = static_cast<uint64_t>(usage.ru_nivcsw);
+    values[static_cast<size_t>(ResourceUsage::blockInputOperations)]       = static_cast<uint64_t>(usage.ru_inblock);
+    values[static_cast<size_t>(ResourceUsage::blockOutputOperations)]      = static_cast<uint64_t>(usage.ru_oublock);
+#else
+    values.fill(0);
+#endif
+}
+
+} // namespace qiti
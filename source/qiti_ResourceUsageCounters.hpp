@@ -0,0 +1,68 @@
+/******************************************************************************
+ * Qiti — C++ Profiling Library
+ *
+ * @file     qiti_ResourceUsageCounters.hpp
+ *
+ * @author   Adam Shield
+ * @date     2026-10-16
+ *
+ * @copyright (c) 2025 Adam Shield
+ * SPDX-License-Identifier: MIT
+ *
+ * See LICENSE.txt for license terms.
+ ******************************************************************************/
+
+#pragma once
+
+#include "qiti_API.hpp"
+
+#include "qiti_FunctionCallData.hpp"
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+//--------------------------------------------------------------------------
+// Doxygen - Begin Internal Documentation
+/** \cond INTERNAL */
+//--------------------------------------------------------------------------
+
+namespace qiti
+{
+//--------------------------------------------------------------------------
+/**
+ Resource usage of the calling thread (getrusage(RUSAGE_THREAD)), read by the
+ instrumentation hooks while enabled.
+
+ Only available on Linux (RUSAGE_THREAD), every counter reads 0 elsewhere.
+
+ @note This class is designed for internal use by the Qiti profiling system.
+ */
+class ResourceUsageCounters
+{
+public:
+    static constexpr size_t numCounters = static_cast<size_t>(ResourceUsage::blockOutputOperations) + 1;
+
+    /** A reading of every counter of a thread, indexed by ResourceUsage. */
+    using Values = std::array<uint64_t, numCounters>;
+
+    /** Whether the hooks read the resource usage of sampled calls, false by default. */
+    QITI_API_VAR static std::atomic<bool> enabled;
+
+    /** @returns true if the resource usage of a thread can be read on this platform. */
+    [[nodiscard]] QITI_API static bool isAvailable() noexcept;
+
+    /** Hot path: reads the calling thread's resource usage (one syscall). */
+    QITI_API_INTERNAL static void read(Values& values) noexcept;
+
+    // Deleted constructors/destructors
+    ResourceUsageCounters() = delete;
+    ~ResourceUsageCounters() = delete;
+}; // class ResourceUsageCounters
+} // namespace qiti
+
+//--------------------------------------------------------------------------
+/** \endcond */
+// Doxygen - End Internal Documentation
+//--------------------------------------------------------------------------
@@ -15,9 +15,20 @@
 
 #include "qiti_ScopedQitiTest.hpp"
 
+#include "qiti_CallHistory.hpp"
+#include "qiti_Clock.hpp"
+#include "qiti_ContextTree.hpp"
+#include "qiti_DeferredEvents.hpp"
+#include "qiti_Export.hpp"
 #include "qiti_FunctionData.hpp"
+#include "qiti_FunctionData_Impl.hpp"
 #include "qiti_FunctionDataUtils.hpp"
+#include "qiti_FunctionFilter.hpp"
+#include "qiti_LatencyHistogram.hpp"
 #include "qiti_MallocHooks.hpp"
+#include "qiti_PerfCounters.hpp"
+#include "qiti_ResourceUsageCounters.hpp"
+#include "qiti_Timeline.hpp"
 
 #include <atomic>
 #include <cassert>
@@ -26,6 +37,7 @@
 #include <iostream>
 #include <limits>
 #include <memory>
+#include <string>
 #include <utility>
 
 #ifndef QITI_VERSION_MAJOR
@@ -64,6 +76,8 @@ struct ScopedQitiTest::Impl
     std::chrono::steady_clock::time_point begin_time;
     
     uint64_t maxLengthOfTest_ms = std::numeric_limits<uint64_t>::max();
+    
+    std::string timelineOutputPath; // empty = don't write
 };
 
 [[maybe_unused]] static void ensureInternalQitiCodeWasNotAccidentallyInstrumented() noexcept
@@ -99,6 +113,8 @@ ScopedQitiTest::ScopedQitiTest() noexcept
     // Heap allocate now before wiping memory of heap allocations
     auto newImpl = std::make_unique<Impl>();
     FunctionDataUtils::resetAll(); // start test from a blank slate
+    Clock::reset(); // calibrates the TSC on first use
+    Profile::calibrateOverhead();
     
     [[maybe_unused]] bool qitiTestWasAlreadyRunning = qitiTestRunning.exchange(true, std::memory_order_relaxed);
     assert(! qitiTestWasAlreadyRunning); // Only one Qiti test permitted at a time
@@ -118,6 +134,9 @@ ScopedQitiTest::~ScopedQitiTest() noexcept
     
     qitiTestRunning.store(false, std::memory_order_relaxed);
     
+    if (! impl->timelineOutputPath.empty())
+        Export::writeChromeTrace(impl->timelineOutputPath.c_str());
+    
     FunctionDataUtils::resetAll(); // clean up after ourselves
 }
 
@@ -135,6 +154,177 @@ void ScopedQitiTest::enableProfilingOnAllFunctions(bool enable) noexcept
            : Profile::endProfilingAllFunctions();
 }
 
+bool ScopedQitiTest::setWallClockSource(WallClockSource source) noexcept
+{
+    const bool isAvailable = Clock::setWallSource(source == WallClockSource::tsc ? Clock::WallSource::tsc
+                                                                                 : Clock::WallSource::steadyClock);
+    Profile::calibrateOverhead(); // overhead is in ticks of the source
+    return isAvailable;
+}
+
+ScopedQitiTest::WallClockSource ScopedQitiTest::getWallClockSource() const noexcept
+{
+    return Clock::getWallSource() == Clock::WallSource::tsc ? WallClockSource::tsc
+                                                            : WallClockSource::steadyClock;
+}
+
+bool ScopedQitiTest::setCpuTimeSource(CpuTimeSource source) noexcept
+{
+    const bool isAvailable = Clock::setCpuSource(source == CpuTimeSource::perfTaskClock ? Clock::CpuSource::perfTaskClock
+                                                                                        : Clock::CpuSource::clockGettime);
+    Profile::calibrateOverhead(); // reading the CPU time is most of the overhead
+    return isAvailable;
+}
+
+ScopedQitiTest::CpuTimeSource ScopedQitiTest::getCpuTimeSource() const noexcept
+{
+    return Clock::getCpuSource() == Clock::CpuSource::perfTaskClock ? CpuTimeSource::perfTaskClock
+                                                                    : CpuTimeSource::clockGettime;
+}
+
+void ScopedQitiTest::enableDeferredAggregation(bool enable) noexcept
+{
+    DeferredEvents::setEnabled(enable);
+    Profile::calibrateOverhead(); // the hooks only push records while enabled
+}
+
+void ScopedQitiTest::setSamplingInterval(uint32_t everyNthCall) noexcept
+{
+    FunctionData::Impl::defaultSamplingRate.store(FunctionData::Impl::SamplingRate::everyNthCall(everyNthCall),
+                                                  std::memory_order_relaxed);
+    Profile::calibrateOverhead(); // counting calls to sample is part of the overhead
+}
+
+void ScopedQitiTest::setSamplingProbability(double probability) noexcept
+{
+    FunctionData::Impl::defaultSamplingRate.store(FunctionData::Impl::SamplingRate::withProbability(probability),
+                                                  std::memory_order_relaxed);
+    Profile::calibrateOverhead(); // drawing random numbers is part of the overhead
+}
+
+void ScopedQitiTest::setSamplingInterval(const FunctionData* function, uint32_t everyNthCall) noexcept
+{
+    if (function == nullptr)
+        return;
+    
+    // FunctionData is only handed out as const, but is owned (mutably) by Qiti
+    const_cast<FunctionData*>(function)->getImpl()->samplingRate.store(FunctionData::Impl::SamplingRate::everyNthCall(everyNthCall),
+                                                                       std::memory_order_relaxed);
+}
+
+void ScopedQitiTest::setSamplingProbability(const FunctionData* function, double probability) noexcept
+{
+    if (function == nullptr)
+        return;
+    
+    const_cast<FunctionData*>(function)->getImpl()->samplingRate.store(FunctionData::Impl::SamplingRate::withProbability(probability),
+                                                                       std::memory_order_relaxed);
+}
+
+void ScopedQitiTest::setCallHistoryCapacity(uint32_t numCallsPerThread) noexcept
+{
+    CallHistory::capacityPerFunction.store(numCallsPerThread, std::memory_order_relaxed);
+    Profile::calibrateOverhead(); // recording the calls is part of the overhead
+}
+
+void ScopedQitiTest::enableLatencyHistograms(bool enable) noexcept
+{
+    LatencyHistogram::enabled.store(enable, std::memory_order_relaxed);
+    Profile::calibrateOverhead(); // recording the durations is part of the overhead
+}
+
+void ScopedQitiTest::enablePerfCounters(bool enable) noexcept
+{
+    PerfCounters::enabled.store(enable, std::memory_order_relaxed);
+    Profile::calibrateOverhead(); // reading the counters is part of the overhead
+}
+
+bool ScopedQitiTest::isPerfCounterAvailable(PerfCounter counter) noexcept
+{
+    MallocHooks::ScopedBypassMallocHooks bypassMallocHooks;
+    
+    return PerfCounters::isAvailable(counter);
+}
+
+void ScopedQitiTest::enableResourceUsage(bool enable) noexcept
+{
+    ResourceUsageCounters::enabled.store(enable, std::memory_order_relaxed);
+    Profile::calibrateOverhead(); // reading the resource usage is part of the overhead
+}
+
+void ScopedQitiTest::enableCallingContextTree(bool enable) noexcept
+{
+    ContextTree::enabled.store(enable, std::memory_order_relaxed);
+    Profile::calibrateOverhead(); // finding the nodes is part of the overhead
+}
+
+void ScopedQitiTest::setCallingContextTreeMaxDepth(uint32_t maxDepth) noexcept
+{
+    ContextTree::maxDepth.store(maxDepth, std::memory_order_relaxed);
+}
+
+void ScopedQitiTest::calibrateInstrumentationOverhead() noexcept
+{
+    Profile::calibrateOverhead();
+}
+
+ScopedQitiTest::InstrumentationOverhead ScopedQitiTest::getInstrumentationOverhead() const noexcept
+{
+    InstrumentationOverhead overhead;
+    overhead.perNestedCallWallClock_ns = Clock::ticksToNanoseconds(FunctionData::Impl::overheadTicksWallClockPerNestedCall.load(std::memory_order_relaxed));
+    overhead.perNestedCallCpu_ns = FunctionData::Impl::overheadNanosecondsCpuPerNestedCall.load(std::memory_order_relaxed);
+    overhead.perUnsampledNestedCallWallClock_ns = Clock::ticksToNanoseconds(FunctionData::Impl::overheadTicksWallClockPerUnsampledNestedCall.load(std::memory_order_relaxed));
+    overhead.perUnsampledNestedCallCpu_ns = FunctionData::Impl::overheadNanosecondsCpuPerUnsampledNestedCall.load(std::memory_order_relaxed);
+    overhead.emptyCallWallClock_ns = Clock::ticksToNanoseconds(FunctionData::Impl::emptyCallTicksWallClock.load(std::memory_order_relaxed));
+    overhead.emptyCallCpu_ns = FunctionData::Impl::emptyCallNanosecondsCpu.load(std::memory_order_relaxed);
+    return overhead;
+}
+
+void ScopedQitiTest::enableOverheadCompensation(bool enable) noexcept
+{
+    FunctionData::Impl::compensateOverhead.store(enable, std::memory_order_relaxed);
+}
+
+void ScopedQitiTest::enableTimeline(bool enable) noexcept
+{
+    Timeline::setEnabled(enable);
+    Profile::calibrateOverhead(); // recording the events is part of the overhead
+}
+
+void ScopedQitiTest::setTimelineOutputPath(const char* path) noexcept
+{
+    MallocHooks::ScopedBypassMallocHooks bypassMallocHooks;
+    
+    impl->timelineOutputPath = (path != nullptr) ? path : "";
+    if (path != nullptr)
+        enableTimeline(true);
+}
+
+void ScopedQitiTest::includeFunctions(const char* namePattern) noexcept
+{
+    FunctionFilter::addRule(FunctionFilter::RuleType::includeFunctions, namePattern);
+}
+
+void ScopedQitiTest::excludeFunctions(const char* namePattern) noexcept
+{
+    FunctionFilter::addRule(FunctionFilter::RuleType::excludeFunctions, namePattern);
+}
+
+void ScopedQitiTest::includeModules(const char* modulePattern) noexcept
+{
+    FunctionFilter::addRule(FunctionFilter::RuleType::includeModules, modulePattern);
+}
+
+void ScopedQitiTest::excludeModules(const char* modulePattern) noexcept
+{
+    FunctionFilter::addRule(FunctionFilter::RuleType::excludeModules, modulePattern);
+}
+
+void ScopedQitiTest::ignoreHeapAllocationsIn(const char* functionNamePattern) noexcept
+{
+    MallocHooks::addBlacklistedFunction(functionNamePattern);
+}
+
 const char* ScopedQitiTest::getQitiVersionString() noexcept
 {
     static constexpr const char* version = QITI_VERSION; // set in CMakeLists.txt or qiti_API.hpp
@@ -17,12 +17,16 @@
 
 #include "qiti_API.hpp"
 
+#include "qiti_FunctionCallData.hpp"
+
 #include <cstdint>
 #include <memory>
 
 //--------------------------------------------------------------------------
 namespace qiti
 {
+class FunctionData;
+
 //--------------------------------------------------------------------------
 /**
  Initializes Qiti profiling and other functionality.
@@ -80,6 +84,312 @@ public:
      */
     QITI_API void enableProfilingOnAllFunctions(bool enable) noexcept;
     
+    /**
+     Only profile functions whose demangled name matches the pattern while profiling all functions.
+     
+     Patterns are globs where '*' matches any sequence of characters, matched against the
+     full demangled name (e.g. "myproject::*", "*::parse*"). Can be called multiple times,
+     a function is then profiled if it matches any of the patterns.
+     
+     Rules are evaluated once per function (not once per call) and are cleared when the
+     ScopedQitiTest goes out of scope. Functions explicitly profiled (e.g. via
+     FunctionData::getFunctionData()) are always profiled.
+     
+     @see enableProfilingOnAllFunctions()
+     */
+    QITI_API void includeFunctions(const char* namePattern) noexcept;
+    
+    /**
+     Never profile functions whose demangled name matches the pattern while profiling all functions.
+     
+     Exclusions take precedence over inclusions. Example: excludeFunctions("std::*");
+     
+     @see includeFunctions()
+     */
+    QITI_API void excludeFunctions(const char* namePattern) noexcept;
+    
+    /**
+     Only profile functions from modules (executable/shared libraries) whose path matches
+     the pattern while profiling all functions.
+     
+     The pattern is matched against the full module path reported by dladdr(),
+     e.g. "*libmyproject*".
+     
+     @see includeFunctions()
+     */
+    QITI_API void includeModules(const char* modulePattern) noexcept;
+    
+    /**
+     Never profile functions from modules (executable/shared libraries) whose path matches
+     the pattern while profiling all functions.
+     
+     @see includeModules()
+     */
+    QITI_API void excludeModules(const char* modulePattern) noexcept;
+    
+    /**
+     Never count heap allocations made by functions whose demangled name matches the pattern,
+     including allocations of everything they call (e.g. "myproject::Logger::*").
+     
+     Patterns are '*' globs, as for includeFunctions(). Allocations of Catch2's
+     Catch::Section::Section are always ignored. Functions are found on the stack with
+     the unwind tables, so they may be built without frame pointers, but not inlined.
+     Cleared when the ScopedQitiTest goes out of scope.
+     */
+    QITI_API void ignoreHeapAllocationsIn(const char* functionNamePattern) noexcept;
+    
+    /** Clocks that can measure the wall clock time spent in profiled functions. */
+    enum class WallClockSource
+    {
+        steadyClock, ///< std::chrono::steady_clock, available everywhere
+        tsc          ///< CPU time stamp counter (x86_64 Linux with an invariant TSC only), much cheaper to read
+    };
+    
+    /**
+     Select the clock used to measure wall clock times of profiled functions.
+     
+     Defaults to WallClockSource::tsc where available, WallClockSource::steadyClock otherwise,
+     and is reset to the default for every ScopedQitiTest. Select the source before calling
+     any profiled function, as times measured with the previous source are not converted.
+     
+     @returns false if the source is not available on this machine, in which case
+              WallClockSource::steadyClock is used instead.
+     */
+    QITI_API bool setWallClockSource(WallClockSource source) noexcept;
+    
+    /** @returns the clock currently used to measure wall clock times of profiled functions. */
+    [[nodiscard]] QITI_API WallClockSource getWallClockSource() const noexcept;
+    
+    /** Clocks that can measure the CPU time spent in profiled functions. */
+    enum class CpuTimeSource
+    {
+        clockGettime, ///< clock_gettime(CLOCK_THREAD_CPUTIME_ID), a syscall on every function enter/exit
+        perfTaskClock ///< per-thread perf task-clock counter read without a syscall (x86_64 Linux only)
+    };
+    
+    /**
+     Select the clock used to measure CPU time of profiled functions.
+     
+     clock_gettime(CLOCK_THREAD_CPUTIME_ID) is a real syscall on Linux, which dominates the
+     measured CPU time of very small functions. CpuTimeSource::perfTaskClock avoids it, making
+     CPU times of sub-microsecond functions meaningful, but requires perf events to be permitted
+     (see /proc/sys/kernel/perf_event_paranoid) and the kernel to expose the time conversion
+     to userspace. The first selection of CpuTimeSource::perfTaskClock takes a few milliseconds
+     while Qiti verifies the counter against clock_gettime().
+     
+     Defaults to CpuTimeSource::clockGettime and is reset to the default for every ScopedQitiTest.
+     
+     @returns false if the source is not available on this machine, in which case
+              CpuTimeSource::clockGettime is used instead.
+     */
+    QITI_API bool setCpuTimeSource(CpuTimeSource source) noexcept;
+    
+    /** @returns the clock currently used to measure CPU time of profiled functions. */
+    [[nodiscard]] QITI_API CpuTimeSource getCpuTimeSource() const noexcept;
+    
+    /**
+     Defer aggregation of profiled function calls to when their data is read.
+     
+     When enabled, the instrumentation only appends a small record (function address,
+     timestamps, heap allocation counters) to a per-thread lock-free ring buffer on
+     function enter/exit, instead of updating averages, min/max, callers, etc. inline.
+     The records are folded into FunctionData lazily, whenever FunctionData is queried.
+     This keeps the overhead on latency-sensitive profiled threads to a few stores.
+     
+     FunctionData::Listener callbacks (e.g. ThreadSanitizer detectors) are called
+     when the records are folded in, on the querying thread, rather than when the
+     function is called. Leave this disabled when using them.
+     
+     Disabled by default and for every new ScopedQitiTest. Enable it before calling the
+     profiled functions.
+     
+     Recalibrates the instrumentation overhead, see calibrateInstrumentationOverhead().
+     */
+    QITI_API void enableDeferredAggregation(bool enable) noexcept;
+    
+    /**
+     Only measure one in every N calls of profiled functions (statistical sampling).
+     
+     Fully measuring a call (wall clock and CPU time, heap allocations, caller, FunctionCallData)
+     costs far more than counting it. For functions called millions of times, sampling keeps the
+     overhead down while still giving good estimates:
+     - FunctionData::getNumTimesCalled() stays exact
+     - averages, minimums and maximums are computed over the sampled calls only
+     - FunctionData::getLastFunctionCall() returns the last sampled call
+     - HotspotDetector scales the sampled times up to all calls
+     
+     Applies to all functions that don't have their own rate (see the overload below).
+     Defaults to every call (1) and is reset for every ScopedQitiTest.
+     
+     Recalibrates the instrumentation overhead, see calibrateInstrumentationOverhead().
+     
+     @param everyNthCall Measure the 1st, (N+1)th, (2N+1)th... call of each function on each thread. 0 and 1 measure every call.
+     */
+    QITI_API void setSamplingInterval(uint32_t everyNthCall) noexcept;
+    
+    /**
+     Measure calls of profiled functions at random, each with the given probability.
+     
+     Same as setSamplingInterval(), but avoids aliasing with code that calls a function in
+     a regular pattern (e.g. a cheap and an expensive call alternating).
+     
+     Recalibrates the instrumentation overhead, see calibrateInstrumentationOverhead().
+     
+     @param probability Between 0 and 1. Values of 1 or more measure every call.
+     */
+    QITI_API void setSamplingProbability(double probability) noexcept;
+    
+    /** Overrides the sampling interval of a single function. @see setSamplingInterval(uint32_t) */
+    QITI_API void setSamplingInterval(const FunctionData* function, uint32_t everyNthCall) noexcept;
+    
+    /** Overrides the sampling probability of a single function. @see setSamplingProbability(double) */
+    QITI_API void setSamplingProbability(const FunctionData* function, double probability) noexcept;
+    
+    /**
+     Retain the most recent calls of every profiled function, for FunctionData::getCallHistory()
+     and the percentile getters (e.g. FunctionData::getWallClockPercentiles_ns()).
+     
+     Off by default (only the most recent call is kept). Each function keeps its own ring of
+     numCallsPerThread calls for every thread calling it, allocated on its first call after this
+     is set, so set it before calling the functions to inspect. Reset when a new ScopedQitiTest starts.
+     
+     Recalibrates the instrumentation overhead, see calibrateInstrumentationOverhead().
+     
+     @param numCallsPerThread Number of calls to retain per function and thread, 0 disables the history.
+     */
+    QITI_API void setCallHistoryCapacity(uint32_t numCallsPerThread) noexcept;
+    
+    /**
+     Count the wall-clock and CPU time of every (sampled) call of profiled functions in log-linear
+     histograms, for FunctionData::getWallClockValueAtQuantile_ns() and getCpuValueAtQuantile_ns().
+     
+     Each function keeps ~30 KB of histograms for every thread calling it, allocated on its first
+     call after this is enabled. Disabled by default and for every new ScopedQitiTest.
+     
+     Recalibrates the instrumentation overhead, see calibrateInstrumentationOverhead().
+     */
+    QITI_API void enableLatencyHistograms(bool enable) noexcept;
+    
+    /**
+     Count hardware and software events (instructions, cycles, cache misses, page faults...)
+     during every (sampled) call of profiled functions, for FunctionCallData::getPerfCounter(),
+     FunctionData::getTotalPerfCounter() and FunctionData::getAveragePerfCounter().
+     
+     Every thread calling a profiled function opens its own perf_event_open() counters on first
+     use. Hardware counters are read without a syscall where the CPU and kernel allow it
+     (rdpmc), software counters (PerfCounter::pageFaults, contextSwitches) cost a read() syscall
+     on every function enter and exit. Counts include the instrumentation of the profiled
+     functions called, and calls recorded with deferred aggregation are not counted.
+     
+     Linux only. Disabled by default and for every new ScopedQitiTest.
+     Recalibrates the instrumentation overhead, see calibrateInstrumentationOverhead().
+     */
+    QITI_API void enablePerfCounters(bool enable) noexcept;
+    
+    /**
+     @returns true if the counter can be read on this machine. Hardware counters are usually
+              unavailable in virtual machines, and counters may not be permitted by
+              /proc/sys/kernel/perf_event_paranoid.
+     */
+    [[nodiscard]] QITI_API static bool isPerfCounterAvailable(PerfCounter counter) noexcept;
+    
+    /**
+     Capture how much the resource usage of the calling thread (page faults, context switches,
+     block I/O, see ResourceUsage) increased during every (sampled) call of profiled functions,
+     for FunctionCallData::getResourceUsage(), FunctionData::getTotalResourceUsage() and
+     FunctionData::getAverageResourceUsage().
+     
+     Costs a getrusage(RUSAGE_THREAD) syscall on every function enter and exit. Counts include
+     the instrumentation of the profiled functions called, and calls recorded with deferred
+     aggregation are not counted.
+     
+     Linux only. Disabled by default and for every new ScopedQitiTest.
+     Recalibrates the instrumentation overhead, see calibrateInstrumentationOverhead().
+     */
+    QITI_API void enableResourceUsage(bool enable) noexcept;
+    
+    /**
+     Build a calling-context tree of profiled calls, see CallingContextTree::getMergedTree().
+     
+     Every thread gets its own tree, with one node per distinct call path it made (merged when
+     queried). Memory stays bounded: nodes are pooled, up to 16384 per
+     thread, and call paths deeper than setCallingContextTreeMaxDepth() get no node of their own.
+     When sampling, only sampled calls (called by sampled calls) are added.
+     
+     Disabled by default and for every new ScopedQitiTest. Enable it before calling the
+     profiled functions.
+     
+     Recalibrates the instrumentation overhead, see calibrateInstrumentationOverhead().
+     */
+    QITI_API void enableCallingContextTree(bool enable) noexcept;
+    
+    /**
+     Limits the calling-context tree to call paths of at most maxDepth nested profiled calls (64 by default).
+     Time spent deeper is included in the self time of the deepest node on its path.
+     */
+    QITI_API void setCallingContextTreeMaxDepth(uint32_t maxDepth) noexcept;
+    
+    /** Estimated cost of Qiti's instrumentation, see calibrateInstrumentationOverhead(). */
+    struct InstrumentationOverhead
+    {
+        /** Time every (sampled) profiled call adds to the measured time of each profiled call it is nested in. */
+        uint64_t perNestedCallWallClock_ns = 0;
+        uint64_t perNestedCallCpu_ns = 0;
+        
+        /** Same for a call that was not sampled (see setSamplingInterval()), which only gets counted. */
+        uint64_t perUnsampledNestedCallWallClock_ns = 0;
+        uint64_t perUnsampledNestedCallCpu_ns = 0;
+        
+        /**
+         Time measured for a call of an empty function. Measurements that are not much
+         larger than this are dominated by Qiti itself.
+         */
+        uint64_t emptyCallWallClock_ns = 0;
+        uint64_t emptyCallCpu_ns = 0;
+    };
+    
+    /**
+     Measure the overhead of Qiti's instrumentation with the current configuration.
+     
+     A profiled call's measured time includes the time spent in the hooks of all the profiled
+     calls nested in it, which inflates the times of deep call trees. Qiti subtracts this
+     overhead (see enableOverheadCompensation()), using an estimate measured when the
+     ScopedQitiTest starts and again by every setter that changes the cost of the hooks
+     (clock sources, sampling, histograms, call history, calling-context tree, timeline...).
+     The time spent in FunctionData listeners is measured by the hooks instead.
+     Takes about a millisecond.
+     */
+    QITI_API void calibrateInstrumentationOverhead() noexcept;
+    
+    /** @returns the overhead estimate of the last calibration, see calibrateInstrumentationOverhead(). */
+    [[nodiscard]] QITI_API InstrumentationOverhead getInstrumentationOverhead() const noexcept;
+    
+    /**
+     Subtract the estimated overhead of nested profiled calls from the wall clock and CPU
+     time of profiled calls (and everything derived from them, such as self time).
+     
+     Enabled by default and for every new ScopedQitiTest.
+     */
+    QITI_API void enableOverheadCompensation(bool enable) noexcept;
+    
+    /**
+     Record a timeline of every (sampled) call of profiled functions, for Export::writeChromeTrace().
+     
+     Each thread appends its completed calls (start, end and bytes heap allocated so far) to its own
+     buffer, 32 bytes per call and up to 16M calls per thread. Enabling starts the timeline at time 0.
+     
+     Disabled by default and for every new ScopedQitiTest.
+     
+     Recalibrates the instrumentation overhead, see calibrateInstrumentationOverhead().
+     */
+    QITI_API void enableTimeline(bool enable) noexcept;
+    
+    /**
+     Writes the timeline as a Chrome trace (see Export::writeChromeTrace()) to path when this
+     ScopedQitiTest ends. Also enables the timeline. Pass nullptr to not write it.
+     */
+    QITI_API void setTimelineOutputPath(const char* path) noexcept;
+    
     /**
      Get the full version string of Qiti.
      
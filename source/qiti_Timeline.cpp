@@ -0,0 +1,120 @@
+
+/******************************************************************************
+ * Qiti — C++ Profiling Library
+ *
+ * @file     qiti_Timeline.cpp
+ *
+ * @author   Adam Shield
+ * @date     2026-10-16
+ *
+ * @copyright (c) 2025 Adam Shield
+ * SPDX-License-Identifier: MIT
+ *
+ * See LICENSE.txt for license terms.
+ ******************************************************************************/
+
+#include "qiti_Timeline.hpp"
+
+#include "qiti_Clock.hpp"
+#include "qiti_MallocHooks.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <thread>
+
+//--------------------------------------------------------------------------
+
+namespace qiti
+{
+
+std::atomic<bool> Timeline::enabled{false};
+std::atomic<Timeline::Buffer*> Timeline::buffers{nullptr};
+std::atomic<uint32_t> Timeline::numBuffers{0};
+std::atomic<uint64_t> Timeline::generation{0};
+std::atomic<uint64_t> Timeline::originTicks{0};
+
+void Timeline::Buffer::record(const Event& event) noexcept
+{
+    const auto index = numEvents.load(std::memory_order_relaxed);
+    const auto chunkIndex = index / eventsPerChunk;
+    if (chunkIndex >= maxChunksPerThread) [[unlikely]]
+    {
+        numEventsDropped.store(numEventsDropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        return;
+    }
+    
+    auto& chunk = chunks[chunkIndex];
+    if (chunk == nullptr) [[unlikely]]
+    {
+        MallocHooks::ScopedBypassMallocHooks bypassMallocHooks;
+        chunk = std::make_unique_for_overwrite<Event[]>(eventsPerChunk);
+    }
+    
+    chunk[index % eventsPerChunk] = event;
+    numEvents.store(index + 1, std::memory_order_release); // publish to readers
+}
+
+void Timeline::setEnabled(bool shouldEnable) noexcept
+{
+    if (shouldEnable && ! enabled.load(std::memory_order_relaxed))
+        originTicks.store(Clock::startTimestamp(), std::memory_order_relaxed);
+    
+    enabled.store(shouldEnable, std::memory_order_release);
+}
+
+uint64_t Timeline::getOriginTicks() noexcept
+{
+    return originTicks.load(std::memory_order_relaxed);
+}
+
+Timeline::Buffer& Timeline::getBuffer(Buffer*& cachedBuffer, uint64_t& cachedGeneration, std::thread::id threadId) noexcept
+{
+    const auto currentGeneration = generation.load(std::memory_order_acquire);
+    if (cachedBuffer != nullptr && cachedGeneration == currentGeneration) [[likely]]
+        return *cachedBuffer;
+    
+    // First call of this thread (since the last reset)
+    MallocHooks::ScopedBypassMallocHooks bypassMallocHooks;
+    
+    auto* buffer = new Buffer(threadId, numBuffers.fetch_add(1, std::memory_order_relaxed) + 1);
+    buffer->next = buffers.load(std::memory_order_relaxed);
+    while (! buffers.compare_exchange_weak(buffer->next, buffer,
+                                           std::memory_order_release,
+                                           std::memory_order_relaxed))
+    {
+    }
+    
+    cachedBuffer = buffer;
+    cachedGeneration = currentGeneration;
+    return *buffer;
+}
+
+std::unique_ptr<Timeline::Buffer> Timeline::createUnlistedBuffer(uint64_t& cachedGeneration, std::thread::id threadId) noexcept
+{
+    MallocHooks::ScopedBypassMallocHooks bypassMallocHooks;
+    
+    cachedGeneration = generation.load(std::memory_order_acquire);
+    return std::make_unique<Buffer>(threadId, 0);
+}
+
+void Timeline::reset() noexcept
+{
+    enabled.store(false, std::memory_order_relaxed);
+    
+    MallocHooks::ScopedBypassMallocHooks bypassMallocHooks;
+    
+    auto* buffer = buffers.exchange(nullptr, std::memory_order_acq_rel);
+    generation.fetch_add(1, std::memory_order_acq_rel);
+    numBuffers.store(0, std::memory_order_relaxed);
+    
+    while (buffer != nullptr)
+    {
+        auto* nextBuffer = buffer->next;
+        delete buffer;
+        buffer = nextBuffer;
+    }
+}
+
+} // namespace qiti
@@ -0,0 +1,149 @@
+/******************************************************************************
+ * Qiti — C++ Profiling Library
+ *
+ * @file     qiti_Timeline.hpp
+ *
+ * @author   Adam Shield
+ * @date     2026-10-16
+ *
+ * @copyright (c) 2025 Adam Shield
+ * SPDX-License-Identifier: MIT
+ *
+ * See LICENSE.txt for license terms.
+ ******************************************************************************/
+
+#pragma once
+
+#include "qiti_API.hpp"
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <thread>
+
+//--------------------------------------------------------------------------
+// Doxygen - Begin Internal Documentation
+/** \cond INTERNAL */
+//--------------------------------------------------------------------------
+
+namespace qiti
+{
+class FunctionData;
+
+//--------------------------------------------------------------------------
+/**
+ Timeline of every completed (sampled) profiled call, for Export::writeChromeTrace().
+ 
+ Each call stack (thread, or DeferredEvents ring being replayed) appends to its own Buffer,
+ so recording never contends. Buffers grow in fixed-size chunks that are never moved, so
+ other threads may read the events published so far at any time.
+ 
+ @note This class is designed for internal use by the Qiti profiling system.
+ */
+class Timeline
+{
+public:
+    /** One completed call. */
+    struct Event
+    {
+        const FunctionData* function;
+        uint64_t startTicksWallClock; // see Clock
+        uint64_t endTicksWallClock;
+        uint64_t amountHeapAllocated; // by the calling thread so far, at the end of the call
+    };
+    
+    static constexpr size_t eventsPerChunk = 4096;
+    static constexpr size_t maxChunksPerThread = 4096; // 16M events (512 MB) per thread at most
+    
+    class Buffer
+    {
+    public:
+        explicit Buffer(std::thread::id owningThread, uint32_t index) noexcept
+        : threadId(owningThread), threadIndex(index) {}
+        
+        /** Writer only: appends a call, or counts it as dropped once the buffer is full. */
+        QITI_API_INTERNAL void record(const Event& event) noexcept;
+        
+        /** Calls visitor for every event published so far, oldest first. */
+        template <typename Visitor>
+        void forEachEvent(Visitor&& visitor) const noexcept
+        {
+            const auto count = numEvents.load(std::memory_order_acquire);
+            for (size_t i = 0; i < count; ++i)
+                visitor(chunks[i / eventsPerChunk][i % eventsPerChunk]);
+        }
+        
+        [[nodiscard]] uint64_t getNumEventsDropped() const noexcept { return numEventsDropped.load(std::memory_order_relaxed); }
+        
+        const std::thread::id threadId;
+        const uint32_t threadIndex; // 1 for the first buffer created, 2 for the next...
+        
+    private:
+        std::atomic<size_t> numEvents{0};
+        std::atomic<uint64_t> numEventsDropped{0};
+        std::array<std::unique_ptr<Event[]>, maxChunksPerThread> chunks{};
+        
+        friend class Timeline;
+        Buffer* next = nullptr;
+    };
+    
+    /** Whether the hooks record the timeline, false by default. */
+    QITI_API_VAR static std::atomic<bool> enabled;
+    
+    /** Enables/disables recording. Enabling starts the timeline (time 0) now. */
+    QITI_API_INTERNAL static void setEnabled(bool shouldEnable) noexcept;
+    
+    /** Timestamp of time 0, ticks of Clock. */
+    [[nodiscard]] QITI_API_INTERNAL static uint64_t getOriginTicks() noexcept;
+    
+    /**
+     Writer only: the buffer cached by a call stack, created (and cached) on first use or
+     when the cached one was freed by reset().
+     */
+    [[nodiscard]] QITI_API_INTERNAL static Buffer& getBuffer(Buffer*& cachedBuffer,
+                                                             uint64_t& cachedGeneration,
+                                                             std::thread::id threadId) noexcept;
+    
+    /**
+     A buffer that forEachBuffer() never visits, e.g. for Profile::calibrateOverhead()'s calls.
+     Cache it like getBuffer() would, and delete it when done.
+     */
+    [[nodiscard]] QITI_API_INTERNAL static std::unique_ptr<Buffer> createUnlistedBuffer(uint64_t& cachedGeneration,
+                                                                                       std::thread::id threadId) noexcept;
+    
+    /** Calls visitor with every buffer (newest first). Safe to call while the buffers are being written. */
+    template <typename Visitor>
+    static void forEachBuffer(Visitor&& visitor) noexcept
+    {
+        for (const auto* buffer = buffers.load(std::memory_order_acquire); buffer != nullptr; buffer = buffer->next)
+            visitor(*buffer);
+    }
+    
+    /**
+     Frees all buffers and disables recording.
+     
+     Must not be called while other threads may still be inside an instrumentation hook.
+     */
+    QITI_API_INTERNAL static void reset() noexcept;
+    
+    // Deleted constructors/destructors
+    Timeline() = delete;
+    ~Timeline() = delete;
+    
+private:
+    QITI_API_VAR static std::atomic<Buffer*> buffers;
+    QITI_API_VAR static std::atomic<uint32_t> numBuffers;
+    
+    /** Incremented whenever the buffers are freed, so call stacks know their cached buffer is gone. */
+    QITI_API_VAR static std::atomic<uint64_t> generation;
+    
+    QITI_API_VAR static std::atomic<uint64_t> originTicks;
+}; // class Timeline
+} // namespace qiti
+
+//--------------------------------------------------------------------------
+/** \endcond */
+// Doxygen - End Internal Documentation
+//--------------------------------------------------------------------------
@@ -0,0 +1,175 @@
+
+/******************************************************************************
+ * Qiti — C++ Profiling Library
+ *
+ * @file     qiti_XRayHooks.cpp
+ *
+ * @author   Adam Shield
+ * @date     2026-10-16
+ *
+ * @copyright (c) 2025 Adam Shield
+ * SPDX-License-Identifier: MIT
+ *
+ * See LICENSE.txt for license terms.
+ ******************************************************************************/
+
+#include "qiti_XRayHooks.hpp"
+
+#if QITI_USE_XRAY
+
+#include "qiti_MallocHooks.hpp"
+
+#include <xray/xray_interface.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+//--------------------------------------------------------------------------
+
+// Weak, so Qiti still loads (with XRay unavailable) when the executable has no XRay runtime
+extern "C" int __xray_set_handler(void (*entry)(int32_t, XRayEntryType)) __attribute__((weak));
+extern "C" XRayPatchingStatus __xray_patch() __attribute__((weak));
+extern "C" XRayPatchingStatus __xray_unpatch() __attribute__((weak));
+extern "C" XRayPatchingStatus __xray_patch_function(int32_t FuncId) __attribute__((weak));
+extern "C" XRayPatchingStatus __xray_unpatch_function(int32_t FuncId) __attribute__((weak));
+extern "C" uintptr_t __xray_function_address(int32_t FuncId) __attribute__((weak));
+extern "C" size_t __xray_max_function_id() __attribute__((weak));
+
+// The -finstrument-functions hooks, see qiti_InstrumentHooks.cpp
+extern "C" void __cyg_profile_func_enter(void* this_fn, void* call_site) noexcept;
+extern "C" void __cyg_profile_func_exit(void* this_fn, void* call_site) noexcept;
+
+namespace
+{
+/** Addresses of the instrumented functions, indexed by XRay function id (ids start at 1). */
+std::vector<void*> g_functionAddresses;
+
+/** (address, id) of the instrumented functions, sorted by address. */
+std::vector<std::pair<uintptr_t, int32_t>> g_functionIds;
+
+std::once_flag g_initialized;
+} // namespace
+
+//--------------------------------------------------------------------------
+
+/** Called by the patched sleds, forwards to the same hooks as -finstrument-functions. */
+QITI_API_INTERNAL static void handleXRayEvent(int32_t functionId, XRayEntryType type) noexcept
+{
+    const auto id = static_cast<size_t>(functionId);
+    if (id >= g_functionAddresses.size())
+        return;
+
+    switch (type)
+    {
+        case XRayEntryType::ENTRY:
+            __cyg_profile_func_enter(g_functionAddresses[id], nullptr);
+            break;
+        case XRayEntryType::EXIT:
+        case XRayEntryType::TAIL:
+            __cyg_profile_func_exit(g_functionAddresses[id], nullptr);
+            break;
+        default:
+            break;
+    }
+}
+
+/**
+ Maps the function ids of the XRay runtime to addresses (once), then installs the handler.
+ @returns false if the XRay runtime is not linked in.
+ */
+[[nodiscard]] QITI_API_INTERNAL static bool initialize() noexcept
+{
+    if (__xray_set_handler == nullptr || __xray_max_function_id == nullptr)
+        return false;
+
+    std::call_once(g_initialized, []
+    {
+        qiti::MallocHooks::ScopedBypassMallocHooks bypassMallocHooks;
+
+        const auto maxFunctionId = __xray_max_function_id();
+        g_functionAddresses.resize(maxFunctionId + 1, nullptr);
+        g_functionIds.reserve(maxFunctionId);
+        for (size_t id = 1; id <= maxFunctionId; ++id)
+        {
+            const auto address = __xray_function_address(static_cast<int32_t>(id));
+            if (address == 0)
+                continue;
+
+            g_functionAddresses[id] = reinterpret_cast<void*>(address);
+            g_functionIds.emplace_back(address, static_cast<int32_t>(id));
+        }
+        std::ranges::sort(g_functionIds);
+
+        // Tables are complete before the first event can arrive, so the handler never locks
+        __xray_set_handler(&handleXRayEvent);
+    });
+    return true;
+}
+
+/** @returns 0 (no valid id) if the function has no sleds. */
+[[nodiscard]] QITI_API_INTERNAL static int32_t findFunctionId(const void* functionAddress) noexcept
+{
+    const auto address = reinterpret_cast<uintptr_t>(functionAddress);
+    const auto it = std::ranges::lower_bound(g_functionIds, address, {}, &std::pair<uintptr_t, int32_t>::first);
+    return (it != g_functionIds.end() && it->first == address) ? it->second : 0;
+}
+
+#endif // QITI_USE_XRAY
+
+//--------------------------------------------------------------------------
+
+namespace qiti
+{
+
+bool XRayHooks::isAvailable() noexcept
+{
+#if QITI_USE_XRAY
+    return initialize();
+#else
+    return false;
+#endif
+}
+
+void XRayHooks::patchFunction([[maybe_unused]] const void* functionAddress) noexcept
+{
+#if QITI_USE_XRAY
+    if (! initialize())
+        return;
+
+    if (const auto id = findFunctionId(functionAddress); id != 0)
+        __xray_patch_function(id);
+#endif
+}
+
+void XRayHooks::unpatchFunction([[maybe_unused]] const void* functionAddress) noexcept
+{
+#if QITI_USE_XRAY
+    if (! initialize())
+        return;
+
+    if (const auto id = findFunctionId(functionAddress); id != 0)
+        __xray_unpatch_function(id);
+#endif
+}
+
+void XRayHooks::patchAllFunctions() noexcept
+{
+#if QITI_USE_XRAY
+    if (initialize())
+        __xray_patch();
+#endif
+}
+
+void XRayHooks::unpatchAllFunctions() noexcept
+{
+#if QITI_USE_XRAY
+    if (initialize())
+        __xray_unpatch();
+#endif
+}
+
+} // namespace qiti
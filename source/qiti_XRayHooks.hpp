@@ -0,0 +1,74 @@
+/******************************************************************************
+ * Qiti — C++ Profiling Library
+ *
+ * @file     qiti_XRayHooks.hpp
+ *
+ * @author   Adam Shield
+ * @date     2026-10-16
+ *
+ * @copyright (c) 2025 Adam Shield
+ * SPDX-License-Identifier: MIT
+ *
+ * See LICENSE.txt for license terms.
+ ******************************************************************************/
+
+#pragma once
+
+#include "qiti_API.hpp"
+
+//--------------------------------------------------------------------------
+// Doxygen - Begin Internal Documentation
+/** \cond INTERNAL */
+//--------------------------------------------------------------------------
+
+namespace qiti
+{
+//--------------------------------------------------------------------------
+/**
+ Optional LLVM XRay instrumentation backend (CMake option QITI_USE_XRAY).
+
+ With -finstrument-functions every instrumented function always calls the hooks, even when
+ nothing is profiled. With -fxray-instrument every function instead starts and ends with a
+ few bytes of no-op "sleds", which the XRay runtime patches into calls of our handler at
+ runtime. Only the sleds of profiled functions (all of them while profiling all functions)
+ are patched in, so unprofiled code runs at near-native speed.
+
+ The handler forwards to the same hooks as -finstrument-functions, so everything downstream
+ is shared. Profile keeps the patched sleds in sync with what is profiled.
+
+ Every function here is a no-op when Qiti is built without QITI_USE_XRAY, or when the
+ executable was not linked with the XRay runtime (-fxray-instrument, exported via -rdynamic).
+
+ @note Only sleds of the executable are known to the XRay runtime, functions of shared
+ libraries are not profiled with this backend.
+
+ @note This class is designed for internal use by the Qiti profiling system.
+ */
+class XRayHooks
+{
+public:
+    /** @returns true if built with QITI_USE_XRAY and the XRay runtime is linked in. */
+    [[nodiscard]] QITI_API static bool isAvailable() noexcept;
+
+    /** Patches in the sleds of the function (if it has any), so its calls reach the hooks. */
+    QITI_API static void patchFunction(const void* functionAddress) noexcept;
+
+    /** Unpatches the sleds of the function (if it has any), its calls no longer reach the hooks. */
+    QITI_API static void unpatchFunction(const void* functionAddress) noexcept;
+
+    /** Patches in the sleds of every instrumented function. */
+    QITI_API_INTERNAL static void patchAllFunctions() noexcept;
+
+    /** Unpatches the sleds of every instrumented function. */
+    QITI_API_INTERNAL static void unpatchAllFunctions() noexcept;
+
+    // Deleted constructors/destructors
+    XRayHooks() = delete;
+    ~XRayHooks() = delete;
+}; // class XRayHooks
+} // namespace qiti
+
+//--------------------------------------------------------------------------
+/** \endcond */
+// Doxygen - End Internal Documentation
+//--------------------------------------------------------------------------
@@ -0,0 +1,145 @@
+// Example project
+#include "qiti_example_include.hpp"
+// Qiti Public API
+#include "qiti_include.hpp"
+// Special unit test include
+#include "qiti_test_macros.hpp"
+
+#include "qiti_CallingContextTree.hpp"
+
+#include <algorithm>
+#include <thread>
+
+//--------------------------------------------------------------------------
+
+/** Test function whose cost depends on who calls it */
+__attribute__((noinline))
+__attribute__((optnone))
+void contextTestParse(int relativeLength) noexcept
+{
+    volatile int sum = 0;
+    for (int i = 0; i < relativeLength * 10000; ++i)
+        sum = sum + i;
+}
+
+/** Cheap caller of contextTestParse() */
+__attribute__((noinline))
+__attribute__((optnone))
+void contextTestLoad() noexcept
+{
+    contextTestParse(1);
+}
+
+/** Expensive caller of contextTestParse() */
+__attribute__((noinline))
+__attribute__((optnone))
+void contextTestReload() noexcept
+{
+    contextTestParse(20);
+}
+
+//--------------------------------------------------------------------------
+
+QITI_TEST_CASE("qiti::CallingContextTree::getMergedTree()", CallingContextTreeGetMergedTree)
+{
+    qiti::ScopedQitiTest test;
+    
+    auto parse  = qiti::FunctionData::getFunctionData<&contextTestParse>();
+    auto load   = qiti::FunctionData::getFunctionData<&contextTestLoad>();
+    auto reload = qiti::FunctionData::getFunctionData<&contextTestReload>();
+    QITI_REQUIRE(parse != nullptr);
+    QITI_REQUIRE(load != nullptr);
+    QITI_REQUIRE(reload != nullptr);
+    
+    QITI_SECTION("Disabled by default")
+    {
+        contextTestLoad();
+        
+        const auto tree = qiti::CallingContextTree::getMergedTree();
+        QITI_CHECK(tree.function == nullptr);
+        QITI_CHECK(tree.children.empty());
+    }
+    
+    QITI_SECTION("Same function called from different paths gets separate nodes")
+    {
+        test.enableCallingContextTree(true);
+        
+        contextTestLoad();
+        contextTestLoad();
+        contextTestReload();
+        
+        const auto tree = qiti::CallingContextTree::getMergedTree();
+        QITI_CHECK(tree.children.size() == 2);
+        
+        const auto* parseFromLoad   = qiti::CallingContextTree::findPath(tree, { load, parse });
+        const auto* parseFromReload = qiti::CallingContextTree::findPath(tree, { reload, parse });
+        QITI_REQUIRE(parseFromLoad != nullptr);
+        QITI_REQUIRE(parseFromReload != nullptr);
+        
+        QITI_CHECK(parseFromLoad->numCalls == 2);
+        QITI_CHECK(parseFromReload->numCalls == 1);
+        QITI_CHECK(parseFromReload->inclusiveTimeWallClock_ns > parseFromLoad->inclusiveTimeWallClock_ns);
+        QITI_CHECK(parseFromReload->selfTimeWallClock_ns == parseFromReload->inclusiveTimeWallClock_ns);
+        
+        // The callers' own time excludes parsing
+        const auto* reloadNode = tree.findChild(reload);
+        QITI_REQUIRE(reloadNode != nullptr);
+        QITI_CHECK(reloadNode->selfTimeWallClock_ns < reloadNode->inclusiveTimeWallClock_ns);
+        QITI_CHECK(reloadNode->inclusiveTimeWallClock_ns >= parseFromReload->inclusiveTimeWallClock_ns);
+        
+        // Most expensive path first
+        QITI_CHECK(tree.children[0].function == reload);
+        
+        QITI_CHECK(qiti::CallingContextTree::findNodes(tree, parse).size() == 2);
+        QITI_CHECK(qiti::CallingContextTree::findPath(tree, { parse }) == nullptr);
+    }
+    
+    QITI_SECTION("Trees of every thread are merged")
+    {
+        test.enableCallingContextTree(true);
+        
+        std::thread thread([] { contextTestLoad(); });
+        thread.join();
+        contextTestLoad();
+        
+        const auto tree = qiti::CallingContextTree::getMergedTree();
+        const auto* parseFromLoad = qiti::CallingContextTree::findPath(tree, { load, parse });
+        QITI_REQUIRE(parseFromLoad != nullptr);
+        QITI_CHECK(parseFromLoad->numCalls == 2);
+        QITI_CHECK(tree.children.size() == 1);
+    }
+    
+    QITI_SECTION("Depth limit")
+    {
+        test.enableCallingContextTree(true);
+        test.setCallingContextTreeMaxDepth(1);
+        
+        contextTestReload();
+        
+        const auto tree = qiti::CallingContextTree::getMergedTree();
+        const auto* reloadNode = tree.findChild(reload);
+        QITI_REQUIRE(reloadNode != nullptr);
+        QITI_CHECK(reloadNode->children.empty());
+        QITI_CHECK(reloadNode->selfTimeWallClock_ns < reloadNode->inclusiveTimeWallClock_ns); // still excludes profiled callees
+    }
+    
+    QITI_SECTION("Walk visits every node with its depth")
+    {
+        test.enableCallingContextTree(true);
+        
+        contextTestLoad();
+        contextTestReload();
+        
+        const auto tree = qiti::CallingContextTree::getMergedTree();
+        
+        size_t numNodes = 0;
+        size_t maxDepth = 0;
+        qiti::CallingContextTree::walk(tree, [&numNodes, &maxDepth](const qiti::CallingContextTree::Node&, size_t depth)
+        {
+            ++numNodes;
+            maxDepth = std::max(maxDepth, depth);
+        });
+        QITI_CHECK(numNodes == 4);
+        QITI_CHECK(maxDepth == 2);
+    }
+}
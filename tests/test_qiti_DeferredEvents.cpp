@@ -0,0 +1,165 @@
+// Qiti Public API
+#include "qiti_include.hpp"
+// Special unit test include
+#include "qiti_test_macros.hpp"
+
+// Qiti Private API - not included in qiti_include.hpp
+#include "qiti_DeferredEvents.hpp"
+
+#include "qiti_example_include.hpp"
+
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+//--------------------------------------------------------------------------
+
+__attribute__((noinline))
+__attribute__((optnone))
+void deferredTestFuncA() noexcept
+{
+    volatile int a = 0;
+    a += 1;
+}
+
+__attribute__((noinline))
+__attribute__((optnone))
+void deferredTestFuncB() noexcept
+{
+    deferredTestFuncA();
+}
+
+__attribute__((noinline))
+__attribute__((optnone))
+void deferredTestFuncThrows()
+{
+    throw std::runtime_error("Test exception");
+}
+
+__attribute__((noinline))
+__attribute__((optnone))
+void deferredTestFuncCatches()
+{
+    try
+    {
+        deferredTestFuncThrows();
+    }
+    catch (const std::exception&)
+    {
+    }
+}
+
+//--------------------------------------------------------------------------
+
+QITI_TEST_CASE("qiti::ScopedQitiTest::enableDeferredAggregation()", DeferredEventsEnableDeferredAggregation)
+{
+    qiti::ScopedQitiTest test;
+    QITI_REQUIRE(! qiti::DeferredEvents::isEnabled());
+    
+    auto* funcDataA = qiti::FunctionData::getFunctionData<&deferredTestFuncA>();
+    auto* funcDataB = qiti::FunctionData::getFunctionData<&deferredTestFuncB>();
+    
+    test.enableDeferredAggregation(true);
+    QITI_REQUIRE(qiti::DeferredEvents::isEnabled());
+    
+    QITI_SECTION("Calls are counted and timed")
+    {
+        deferredTestFuncB();
+        deferredTestFuncB();
+        
+        QITI_CHECK(funcDataA->getNumTimesCalled() == 2);
+        QITI_CHECK(funcDataB->getNumTimesCalled() == 2);
+        QITI_CHECK(funcDataB->getMaxTimeSpentInFunctionWallClock_ns() > 0);
+        QITI_CHECK(funcDataB->getMaxTimeSpentInFunctionWallClock_ns() >= funcDataA->getMinTimeSpentInFunctionWallClock_ns());
+        
+        auto lastCall = funcDataA->getLastFunctionCall();
+        QITI_CHECK(lastCall.getThreadThatCalledFunction() == std::this_thread::get_id());
+        QITI_CHECK(lastCall.getTimeSpentInFunctionWallClock_ns() > 0);
+    }
+    
+    QITI_SECTION("Callers are tracked")
+    {
+        deferredTestFuncB();
+        
+        auto callers = funcDataA->getCallers();
+        QITI_REQUIRE(callers.size() == 1);
+        QITI_CHECK(callers[0] == funcDataB);
+    }
+    
+    QITI_SECTION("More calls than fit in a ring")
+    {
+        auto* funcData = qiti::FunctionData::getFunctionData<&qiti::example::profile::testFunc>();
+        for (int i = 0; i < 10'000; ++i)
+            qiti::example::profile::testFunc();
+        
+        QITI_CHECK(funcData->getNumTimesCalled() == 10'000);
+    }
+    
+    QITI_SECTION("Called on many threads")
+    {
+        constexpr int numThreads = 4;
+        constexpr int numCallsPerThread = 1'000;
+        
+        std::vector<std::thread> threads;
+        threads.reserve(numThreads);
+        for (int i = 0; i < numThreads; ++i)
+        {
+            threads.emplace_back([]
+            {
+                for (int j = 0; j < numCallsPerThread; ++j)
+                    deferredTestFuncB();
+            });
+        }
+        for (auto& thread : threads)
+            thread.join();
+        
+        QITI_CHECK(funcDataA->getNumTimesCalled() == numThreads * numCallsPerThread);
+        QITI_CHECK(funcDataB->getNumTimesCalled() == numThreads * numCallsPerThread);
+    }
+    
+#ifndef _WIN32 // TODO: Windows exception tracking needs investigation
+    QITI_SECTION("Exceptions are attributed to the throwing function")
+    {
+        auto* funcDataThrows = qiti::FunctionData::getFunctionData<&deferredTestFuncThrows>();
+        auto* funcDataCatches = qiti::FunctionData::getFunctionData<&deferredTestFuncCatches>();
+        
+        deferredTestFuncCatches();
+        
+        QITI_CHECK(funcDataThrows->getNumExceptionsThrown() == 1);
+        QITI_CHECK(funcDataCatches->getNumExceptionsThrown() == 0);
+    }
+#endif
+    
+    QITI_SECTION("Recalibrating keeps pending calls and records none of its own")
+    {
+        deferredTestFuncA();
+        test.calibrateInstrumentationOverhead();
+        
+        QITI_CHECK(funcDataA->getNumTimesCalled() == 1);
+        QITI_CHECK(qiti::FunctionData::getAllProfiledFunctionData().size() == 2);
+        
+        // Measured with the pushes of the hooks, which are not free
+        const auto overhead = test.getInstrumentationOverhead();
+        QITI_CHECK(overhead.perNestedCallWallClock_ns > 0);
+    }
+    
+    QITI_SECTION("Disabling keeps pending calls")
+    {
+        deferredTestFuncA();
+        test.enableDeferredAggregation(false);
+        deferredTestFuncA();
+        
+        QITI_CHECK(funcDataA->getNumTimesCalled() == 2);
+    }
+}
+
+QITI_TEST_CASE("qiti::ScopedQitiTest deferred aggregation is reset", DeferredEventsReset)
+{
+    {
+        qiti::ScopedQitiTest test;
+        test.enableDeferredAggregation(true);
+    }
+    
+    qiti::ScopedQitiTest test;
+    QITI_CHECK(! qiti::DeferredEvents::isEnabled());
+}
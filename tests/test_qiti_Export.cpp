@@ -0,0 +1,230 @@
+// Example project
+#include "qiti_example_include.hpp"
+// Qiti Public API
+#include "qiti_include.hpp"
+// Special unit test include
+#include "qiti_test_macros.hpp"
+
+#include "qiti_Export.hpp"
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+//--------------------------------------------------------------------------
+
+/** Leaf function doing the work */
+__attribute__((noinline))
+__attribute__((optnone))
+void exportTestLeaf() noexcept
+{
+    volatile int sum = 0;
+    for (int i = 0; i < 10000; ++i)
+        sum = sum + i;
+}
+
+/** Caller of exportTestLeaf() that allocates */
+__attribute__((noinline))
+__attribute__((optnone))
+void exportTestRoot() noexcept
+{
+    auto* bytes = new char[64];
+    exportTestLeaf();
+    exportTestLeaf();
+    delete[] bytes;
+}
+
+/** Splits folded stacks into lines */
+static std::vector<std::string> getLines(const std::string& text)
+{
+    std::vector<std::string> lines;
+    std::istringstream stream(text);
+    for (std::string line; std::getline(stream, line);)
+        lines.push_back(line);
+    return lines;
+}
+
+/** Number of (non-overlapping) occurrences of pattern in text */
+static size_t countOccurrences(const std::string& text, const std::string& pattern)
+{
+    size_t count = 0;
+    for (auto pos = text.find(pattern); pos != std::string::npos; pos = text.find(pattern, pos + pattern.size()))
+        ++count;
+    return count;
+}
+
+//--------------------------------------------------------------------------
+
+QITI_TEST_CASE("qiti::Export::writeFoldedStacks()", ExportWriteFoldedStacks)
+{
+    qiti::ScopedQitiTest test;
+    
+    auto root = qiti::FunctionData::getFunctionData<&exportTestRoot>();
+    auto leaf = qiti::FunctionData::getFunctionData<&exportTestLeaf>();
+    QITI_REQUIRE(root != nullptr);
+    QITI_REQUIRE(leaf != nullptr);
+    
+    const std::string rootName = root->getFunctionName();
+    const std::string leafName = leaf->getFunctionName();
+    
+    QITI_SECTION("Empty without a calling-context tree")
+    {
+        exportTestRoot();
+        
+        std::ostringstream stream;
+        qiti::Export::writeFoldedStacks(stream, qiti::Export::Metric::numCalls);
+        QITI_CHECK(stream.str().empty());
+    }
+    
+    QITI_SECTION("Call counts")
+    {
+        test.enableCallingContextTree(true);
+        exportTestRoot();
+        
+        std::ostringstream stream;
+        qiti::Export::writeFoldedStacks(stream, qiti::Export::Metric::numCalls);
+        
+        const auto lines = getLines(stream.str());
+        QITI_REQUIRE(lines.size() == 2);
+        QITI_CHECK(lines[0] == rootName + " 1");
+        QITI_CHECK(lines[1] == rootName + ";" + leafName + " 2");
+    }
+    
+    QITI_SECTION("Self wall-clock time")
+    {
+        test.enableCallingContextTree(true);
+        exportTestRoot();
+        
+        std::ostringstream stream;
+        qiti::Export::writeFoldedStacks(stream, qiti::Export::Metric::selfTimeWallClock_ns);
+        
+        const auto lines = getLines(stream.str());
+        QITI_REQUIRE(! lines.empty());
+        QITI_CHECK(lines.back().starts_with(rootName + ";" + leafName + " "));
+        QITI_CHECK(std::stoull(lines.back().substr(lines.back().rfind(' ') + 1)) > 0);
+    }
+    
+    QITI_SECTION("Heap bytes are only attributed to the function allocating them")
+    {
+        test.enableCallingContextTree(true);
+        exportTestRoot();
+        
+        std::ostringstream stream;
+        qiti::Export::writeFoldedStacks(stream, qiti::Export::Metric::amountHeapAllocated);
+        
+        const auto lines = getLines(stream.str());
+        QITI_REQUIRE(lines.size() == 1);
+        QITI_CHECK(lines[0] == rootName + " 64");
+    }
+    
+    QITI_SECTION("Write to file")
+    {
+        test.enableCallingContextTree(true);
+        exportTestRoot();
+        
+        const char* path = "qiti_test_export.folded";
+        QITI_REQUIRE(qiti::Export::writeFoldedStacks(path, qiti::Export::Metric::numCalls));
+        
+        std::ifstream file(path);
+        std::stringstream contents;
+        contents << file.rdbuf();
+        file.close();
+        std::remove(path);
+        
+        QITI_CHECK(getLines(contents.str()).size() == 2);
+        QITI_CHECK(! qiti::Export::writeFoldedStacks("/nonexistent_directory/qiti.folded", qiti::Export::Metric::numCalls));
+    }
+}
+
+QITI_TEST_CASE("qiti::Export::writeChromeTrace()", ExportWriteChromeTrace)
+{
+    qiti::ScopedQitiTest test;
+    
+    auto root = qiti::FunctionData::getFunctionData<&exportTestRoot>();
+    auto leaf = qiti::FunctionData::getFunctionData<&exportTestLeaf>();
+    QITI_REQUIRE(root != nullptr);
+    QITI_REQUIRE(leaf != nullptr);
+    
+    const std::string rootName = root->getFunctionName();
+    const std::string leafName = leaf->getFunctionName();
+    
+    QITI_SECTION("No events without a timeline")
+    {
+        exportTestRoot();
+        
+        std::ostringstream stream;
+        qiti::Export::writeChromeTrace(stream);
+        
+        const auto trace = stream.str();
+        QITI_CHECK(trace.starts_with("{\"displayTimeUnit\":\"ns\",\"traceEvents\":["));
+        QITI_CHECK(countOccurrences(trace, "\"ph\":\"X\"") == 0);
+    }
+    
+    QITI_SECTION("One complete event per call")
+    {
+        test.enableTimeline(true);
+        exportTestRoot();
+        
+        std::ostringstream stream;
+        qiti::Export::writeChromeTrace(stream);
+        
+        const auto trace = stream.str();
+        QITI_CHECK(countOccurrences(trace, "\"ph\":\"X\"") == 3);
+        QITI_CHECK(countOccurrences(trace, "{\"name\":\"" + rootName + "\",\"cat\":\"qiti\",\"ph\":\"X\",\"pid\":1,\"tid\":1,") == 1);
+        QITI_CHECK(countOccurrences(trace, "{\"name\":\"" + leafName + "\",\"cat\":\"qiti\",\"ph\":\"X\",\"pid\":1,\"tid\":1,") == 2);
+        QITI_CHECK(countOccurrences(trace, "\"ph\":\"M\"") == 1);
+        QITI_CHECK(trace.ends_with("],\"otherData\":{\"qitiEventsDropped\":\"0\"}}\n"));
+    }
+    
+    QITI_SECTION("One track per thread")
+    {
+        test.enableTimeline(true);
+        exportTestRoot();
+        std::thread t(exportTestRoot);
+        t.join();
+        
+        std::ostringstream stream;
+        qiti::Export::writeChromeTrace(stream);
+        
+        const auto trace = stream.str();
+        QITI_CHECK(countOccurrences(trace, "\"ph\":\"M\"") == 2);
+        QITI_CHECK(countOccurrences(trace, "\"ph\":\"X\",\"pid\":1,\"tid\":1,") == 3);
+        QITI_CHECK(countOccurrences(trace, "\"ph\":\"X\",\"pid\":1,\"tid\":2,") == 3);
+    }
+    
+    QITI_SECTION("Heap allocated counter")
+    {
+        test.enableTimeline(true);
+        exportTestRoot();
+        
+        std::ostringstream stream;
+        qiti::Export::writeChromeTrace(stream);
+        
+        // Only written when the amount changed since the previous call of the thread
+        const auto trace = stream.str();
+        const auto numCounterEvents = countOccurrences(trace, "{\"name\":\"Heap allocated (Thread 1)\",\"ph\":\"C\"");
+        QITI_CHECK(numCounterEvents >= 1);
+        QITI_CHECK(numCounterEvents <= 3);
+    }
+    
+    QITI_SECTION("Write to file")
+    {
+        const char* path = "qiti_test_export.json";
+        test.enableTimeline(true);
+        exportTestRoot();
+        
+        QITI_REQUIRE(qiti::Export::writeChromeTrace(path));
+        
+        std::ifstream file(path);
+        std::stringstream contents;
+        contents << file.rdbuf();
+        file.close();
+        std::remove(path);
+        
+        QITI_CHECK(countOccurrences(contents.str(), "\"ph\":\"X\"") == 3);
+        QITI_CHECK(! qiti::Export::writeChromeTrace("/nonexistent_directory/qiti.json"));
+    }
+}
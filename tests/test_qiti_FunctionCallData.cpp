@@ -145,6 +145,42 @@ QITI_TEST_CASE("qiti::FunctionCallData::getTimeSpentInFunction", FunctionCallDat
 }
 #endif // ! _WIN32
 
+QITI_TEST_CASE("qiti::FunctionCallData::getSelfTimeSpentInFunction", FunctionCallDataGetSelfTimeSpentInFunction)
+{
+    qiti::ScopedQitiTest test;
+    
+    auto slowWorkFuncData = qiti::FunctionData::getFunctionData<&slowWork>();
+    QITI_REQUIRE(slowWorkFuncData != nullptr);
+    
+    QITI_SECTION("Function without profiled callees - self time equals total time")
+    {
+        (void)slowWork();
+        
+        auto lastCall = slowWorkFuncData->getLastFunctionCall();
+        QITI_CHECK(lastCall.getSelfTimeSpentInFunctionWallClock_ns() == lastCall.getTimeSpentInFunctionWallClock_ns());
+        QITI_CHECK(lastCall.getSelfTimeSpentInFunctionCpu_ns() == lastCall.getTimeSpentInFunctionCpu_ns());
+    }
+    
+    QITI_SECTION("Time spent in profiled callees is excluded")
+    {
+        auto callerFuncData = qiti::FunctionData::getFunctionData<&callsSlowWork>();
+        QITI_REQUIRE(callerFuncData != nullptr);
+        
+        (void)callsSlowWork();
+        
+        auto callerCall = callerFuncData->getLastFunctionCall();
+        auto calleeCall = slowWorkFuncData->getLastFunctionCall();
+        
+        const auto callerTotal = callerCall.getTimeSpentInFunctionWallClock_ns();
+        const auto callerSelf  = callerCall.getSelfTimeSpentInFunctionWallClock_ns();
+        QITI_CHECK(callerSelf < callerTotal);
+        QITI_CHECK(callerSelf < calleeCall.getTimeSpentInFunctionWallClock_ns());
+        QITI_CHECK(callerSelf + calleeCall.getTimeSpentInFunctionWallClock_ns() <= callerTotal + 1); // +1 for rounding
+        
+        QITI_CHECK(callerFuncData->getAverageSelfTimeSpentInFunctionWallClock_ns() < callerFuncData->getAverageTimeSpentInFunctionWallClock_ns());
+    }
+}
+
 QITI_TEST_CASE("qiti::FunctionCallData move constructor", FunctionCallDataMoveConstructor)
 {
     qiti::ScopedQitiTest test;
@@ -6,7 +6,13 @@
 // Special unit test include
 #include "qiti_test_macros.hpp"
 
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
+
 #include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <random>
 #include <thread>
 #include <vector>
@@ -40,6 +46,15 @@ void testFuncWithVariableLength(int relativeLength) noexcept
         sum = sum + i;
 }
 
+/** Test function for very deep call stacks */
+__attribute__((noinline))
+__attribute__((optnone))
+void testFuncRecursive(int depth) noexcept
+{
+    if (depth > 1)
+        testFuncRecursive(depth - 1);
+}
+
 /** Test functions for caller tracking */
 __attribute__((noinline))
 __attribute__((optnone))
@@ -63,6 +78,44 @@ void callerTestFuncC() noexcept
     callerTestFuncB(); // C calls B (which calls A)
 }
 
+/** Test function allocating numBytes on the heap */
+__attribute__((noinline))
+__attribute__((optnone))
+void testFuncHeapAllocation(size_t numBytes) noexcept
+{
+    auto* bytes = new char[numBytes];
+    delete[] bytes;
+}
+
+/** Test function blocking the thread for a moment */
+__attribute__((noinline))
+__attribute__((optnone))
+void testFuncSleep() noexcept
+{
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+}
+
+/** Test function touching every page of numBytes of fresh memory (page faults) */
+__attribute__((noinline))
+__attribute__((optnone))
+void testFuncTouchMemory(size_t numBytes) noexcept
+{
+#ifdef _WIN32
+    auto* bytes = new char[numBytes];
+    for (size_t i = 0; i < numBytes; i += 4096)
+        static_cast<volatile char*>(bytes)[i] = 1;
+    delete[] bytes;
+#else
+    // Straight from the kernel, as malloc may reuse memory that was touched before
+    void* bytes = mmap(nullptr, numBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (bytes == MAP_FAILED)
+        return;
+    for (size_t i = 0; i < numBytes; i += 4096)
+        static_cast<volatile char*>(bytes)[i] = 1;
+    munmap(bytes, numBytes);
+#endif
+}
+
 __attribute__((noinline))
 __attribute__((optnone))
 void testFuncThrowsException()
@@ -190,6 +243,56 @@ QITI_TEST_CASE("qiti::FunctionData::getNumTimesCalled()", FunctionDataGetNumTime
         t.join();
         QITI_CHECK(funcData->getNumTimesCalled() == 2);
     }
+
+    QITI_SECTION("Called concurrently on many threads")
+    {
+        static constexpr int numThreads = 8;
+        static constexpr int numCallsPerThread = 1000;
+
+        std::vector<std::thread> threads;
+        threads.reserve(numThreads);
+        for (int i = 0; i < numThreads; ++i)
+        {
+            threads.emplace_back([]
+            {
+                for (int j = 0; j < numCallsPerThread; ++j)
+                    testFunc();
+            });
+        }
+        for (auto& thread : threads)
+            thread.join();
+
+        QITI_CHECK(funcData->getNumTimesCalled() == numThreads * numCallsPerThread);
+        QITI_CHECK(funcData->getMinTimeSpentInFunctionWallClock_ns() <= funcData->getAverageTimeSpentInFunctionWallClock_ns());
+        QITI_CHECK(funcData->getAverageTimeSpentInFunctionWallClock_ns() <= funcData->getMaxTimeSpentInFunctionWallClock_ns());
+    }
+}
+
+QITI_TEST_CASE("qiti::FunctionData::getNumTimesCalled(), deep recursion", FunctionDataGetNumTimesCalledDeepRecursion)
+{
+    qiti::ScopedQitiTest test;
+    
+    auto funcData = qiti::FunctionData::getFunctionData<&testFuncRecursive>();
+    QITI_REQUIRE(funcData != nullptr);
+    
+    QITI_SECTION("Calls nested too deeply are counted but not measured")
+    {
+        testFuncRecursive(1000);
+        QITI_CHECK(funcData->getNumTimesCalled() == 1000);
+        QITI_CHECK(funcData->getNumCallsSampled() > 0);
+        QITI_CHECK(funcData->getNumCallsSampled() < 1000);
+    }
+    
+    QITI_SECTION("Call stack is balanced afterwards")
+    {
+        testFuncRecursive(1000);
+        testFuncRecursive(1);
+        QITI_CHECK(funcData->getNumTimesCalled() == 1001);
+        
+        const auto lastCall = funcData->getLastFunctionCall();
+        QITI_CHECK(lastCall.getCaller() == nullptr); // outermost call, not linked to a stale frame
+        QITI_CHECK(lastCall.getTimeSpentInFunctionWallClock_ns() > 0);
+    }
 }
 
 QITI_TEST_CASE("qiti::FunctionData::getNumTimesCalled(), using static constructor", FunctionDataGetNumTimesCalledStaticConstructor)
@@ -211,6 +314,294 @@ QITI_TEST_CASE("qiti::FunctionData::getNumTimesCalled(), using static constructo
     }
 }
 
+QITI_TEST_CASE("qiti::FunctionData::getLastFunctionCall(std::thread::id)", FunctionDataGetLastFunctionCallOnThread)
+{
+    qiti::ScopedQitiTest test;
+    
+    auto funcData = qiti::FunctionData::getFunctionData<&testFuncWithVariableLength>();
+    QITI_REQUIRE(funcData != nullptr);
+    
+    QITI_SECTION("Not called on thread")
+    {
+        testFuncWithVariableLength(1);
+        
+        std::thread thread([]{});
+        const auto otherThreadId = thread.get_id();
+        thread.join();
+        
+        QITI_CHECK(funcData->getLastFunctionCall(otherThreadId).getTimeSpentInFunctionWallClock_ns() == 0);
+        QITI_CHECK(funcData->getLastFunctionCall(std::this_thread::get_id()).getTimeSpentInFunctionWallClock_ns() > 0);
+    }
+    
+    QITI_SECTION("Each thread keeps its own last call")
+    {
+        constexpr int numThreads = 4;
+        
+        std::vector<std::thread> threads;
+        std::vector<std::thread::id> threadIds(numThreads);
+        threads.reserve(numThreads);
+        for (int i = 0; i < numThreads; ++i)
+        {
+            threads.emplace_back([i, &threadIds]
+            {
+                threadIds[static_cast<size_t>(i)] = std::this_thread::get_id();
+                for (int j = 0; j < 100; ++j)
+                    testFuncWithVariableLength(1 + (j % 3));
+            });
+        }
+        for (auto& thread : threads)
+            thread.join();
+        
+        for (const auto& threadId : threadIds)
+        {
+            const auto lastCall = funcData->getLastFunctionCall(threadId);
+            QITI_CHECK(lastCall.getThreadThatCalledFunction() == threadId);
+            QITI_CHECK(lastCall.getTimeSpentInFunctionWallClock_ns() > 0);
+        }
+        QITI_CHECK(funcData->getNumTimesCalled() == numThreads * 100);
+    }
+}
+
+QITI_TEST_CASE("qiti::FunctionData::getCallHistory()", FunctionDataGetCallHistory)
+{
+    qiti::ScopedQitiTest test;
+    
+    auto funcData = qiti::FunctionData::getFunctionData<&testFuncWithVariableLength>();
+    QITI_REQUIRE(funcData != nullptr);
+    
+    QITI_SECTION("Disabled by default")
+    {
+        testFuncWithVariableLength(1);
+        
+        QITI_CHECK(funcData->getCallHistory().empty());
+        QITI_CHECK(funcData->getWallClockPercentiles_ns().max == 0);
+    }
+    
+    QITI_SECTION("Retains only the most recent calls, oldest first")
+    {
+        test.setCallHistoryCapacity(8);
+        
+        for (int i = 0; i < 20; ++i)
+            testFuncWithVariableLength(1);
+        
+        const auto history = funcData->getCallHistory();
+        QITI_REQUIRE(history.size() == 8);
+        QITI_CHECK(funcData->getNumTimesCalled() == 20);
+        
+        for (const auto& call : history)
+            QITI_CHECK(call.getTimeSpentInFunctionWallClock_ns() > 0);
+        QITI_CHECK(history.back().getThreadThatCalledFunction() == std::this_thread::get_id());
+        QITI_CHECK(history.back().getTimeSpentInFunctionWallClock_ns() == funcData->getLastFunctionCall().getTimeSpentInFunctionWallClock_ns());
+    }
+    
+    QITI_SECTION("Retains calls of every thread")
+    {
+        test.setCallHistoryCapacity(100);
+        
+        std::thread thread([]
+        {
+            for (int i = 0; i < 10; ++i)
+                testFuncWithVariableLength(1);
+        });
+        thread.join();
+        testFuncWithVariableLength(1);
+        
+        const auto history = funcData->getCallHistory();
+        QITI_REQUIRE(history.size() == 11);
+        QITI_CHECK(history.back().getThreadThatCalledFunction() == std::this_thread::get_id());
+    }
+    
+    QITI_SECTION("Wall clock and CPU percentiles")
+    {
+        test.setCallHistoryCapacity(100);
+        
+        for (int i = 0; i < 100; ++i)
+            testFuncWithVariableLength(1 + (i % 10));
+        
+        const auto wallClock = funcData->getWallClockPercentiles_ns();
+        QITI_CHECK(wallClock.p50 > 0);
+        QITI_CHECK(wallClock.p50 <= wallClock.p90);
+        QITI_CHECK(wallClock.p90 <= wallClock.p99);
+        QITI_CHECK(wallClock.p99 <= wallClock.max);
+        QITI_CHECK(wallClock.max == funcData->getMaxTimeSpentInFunctionWallClock_ns());
+        
+        const auto cpu = funcData->getCpuPercentiles_ns();
+        QITI_CHECK(cpu.p50 <= cpu.p90);
+        QITI_CHECK(cpu.p90 <= cpu.p99);
+        QITI_CHECK(cpu.p99 <= cpu.max);
+    }
+    
+    QITI_SECTION("Heap allocation percentiles")
+    {
+        auto heapFuncData = qiti::FunctionData::getFunctionData<&testFuncHeapAllocation>();
+        QITI_REQUIRE(heapFuncData != nullptr);
+        test.setCallHistoryCapacity(10);
+        
+        for (size_t i = 1; i <= 10; ++i)
+            testFuncHeapAllocation(i * 100);
+        
+        const auto heap = heapFuncData->getAmountHeapAllocatedPercentiles();
+        QITI_CHECK(heap.p50 == 500);
+        QITI_CHECK(heap.p90 == 900);
+        QITI_CHECK(heap.max == 1000);
+        
+        const auto history = heapFuncData->getCallHistory();
+        QITI_REQUIRE(history.size() == 10);
+        QITI_CHECK(history.front().getAmountHeapAllocated() == 100);
+        QITI_CHECK(history.front().getNumHeapAllocations() == 1);
+    }
+}
+
+QITI_TEST_CASE("qiti::FunctionData::getWallClockValueAtQuantile_ns()", FunctionDataGetValueAtQuantile)
+{
+    qiti::ScopedQitiTest test;
+    
+    auto funcData = qiti::FunctionData::getFunctionData<&testFuncWithVariableLength>();
+    QITI_REQUIRE(funcData != nullptr);
+    
+    QITI_SECTION("Disabled by default")
+    {
+        testFuncWithVariableLength(1);
+        
+        QITI_CHECK(funcData->getWallClockValueAtQuantile_ns(0.5) == 0);
+        QITI_CHECK(funcData->getCpuValueAtQuantile_ns(0.5) == 0);
+    }
+    
+    QITI_SECTION("Quantiles are ordered and bounded by min/max")
+    {
+        test.enableLatencyHistograms(true);
+        
+        for (int i = 0; i < 200; ++i)
+            testFuncWithVariableLength(1 + (i % 10));
+        
+        const auto p50 = funcData->getWallClockValueAtQuantile_ns(0.5);
+        const auto p99 = funcData->getWallClockValueAtQuantile_ns(0.99);
+        const auto max = funcData->getWallClockValueAtQuantile_ns(1.0);
+        QITI_CHECK(p50 > 0);
+        QITI_CHECK(p50 <= p99);
+        QITI_CHECK(p99 <= max);
+        QITI_CHECK(max == funcData->getMaxTimeSpentInFunctionWallClock_ns());
+        QITI_CHECK(funcData->getWallClockValueAtQuantile_ns(0.0) >= funcData->getMinTimeSpentInFunctionWallClock_ns());
+        
+        QITI_CHECK(funcData->getCpuValueAtQuantile_ns(0.5) <= funcData->getCpuValueAtQuantile_ns(0.99));
+        QITI_CHECK(funcData->getCpuValueAtQuantile_ns(1.0) == funcData->getMaxTimeSpentInFunctionCpu_ns());
+    }
+    
+    QITI_SECTION("Merges the calls of every thread")
+    {
+        test.enableLatencyHistograms(true);
+        
+        std::thread thread([]
+        {
+            for (int i = 0; i < 50; ++i)
+                testFuncWithVariableLength(10);
+        });
+        thread.join();
+        testFuncWithVariableLength(1);
+        
+        // The single short call on this thread is below the 2nd percentile
+        QITI_CHECK(funcData->getWallClockValueAtQuantile_ns(0.01) < funcData->getWallClockValueAtQuantile_ns(0.5));
+        QITI_CHECK(funcData->getWallClockValueAtQuantile_ns(1.0) == funcData->getMaxTimeSpentInFunctionWallClock_ns());
+    }
+}
+
+QITI_TEST_CASE("qiti::FunctionData::getTotalPerfCounter()", FunctionDataGetTotalPerfCounter)
+{
+    qiti::ScopedQitiTest test;
+    
+    auto funcData = qiti::FunctionData::getFunctionData<&testFuncTouchMemory>();
+    QITI_REQUIRE(funcData != nullptr);
+    
+    static constexpr size_t numBytes = 1024 * 1024;
+    
+    QITI_SECTION("Disabled by default")
+    {
+        testFuncTouchMemory(numBytes);
+        
+        QITI_CHECK(funcData->getTotalPerfCounter(qiti::PerfCounter::pageFaults) == 0);
+        QITI_CHECK(funcData->getLastFunctionCall().getPerfCounter(qiti::PerfCounter::pageFaults) == 0);
+    }
+    
+    QITI_SECTION("Counts software events of every call")
+    {
+        if (! qiti::ScopedQitiTest::isPerfCounterAvailable(qiti::PerfCounter::pageFaults))
+            return; // perf events not permitted on this machine
+        
+        test.enablePerfCounters(true);
+        
+        testFuncTouchMemory(numBytes);
+        const auto firstCallPageFaults = funcData->getLastFunctionCall().getPerfCounter(qiti::PerfCounter::pageFaults);
+        QITI_CHECK(firstCallPageFaults > 0);
+        
+        testFuncTouchMemory(numBytes);
+        const auto secondCallPageFaults = funcData->getLastFunctionCall().getPerfCounter(qiti::PerfCounter::pageFaults);
+        QITI_CHECK(funcData->getTotalPerfCounter(qiti::PerfCounter::pageFaults) == firstCallPageFaults + secondCallPageFaults);
+        QITI_CHECK(funcData->getAveragePerfCounter(qiti::PerfCounter::pageFaults) == (firstCallPageFaults + secondCallPageFaults) / 2);
+    }
+    
+    QITI_SECTION("Counts instructions retired")
+    {
+        if (! qiti::ScopedQitiTest::isPerfCounterAvailable(qiti::PerfCounter::instructions))
+            return; // no PMU, e.g. in a virtual machine
+        
+        test.enablePerfCounters(true);
+        
+        auto shortFuncData = qiti::FunctionData::getFunctionData<&testFuncWithVariableLength>();
+        testFuncWithVariableLength(1);
+        const auto shortCallInstructions = shortFuncData->getLastFunctionCall().getPerfCounter(qiti::PerfCounter::instructions);
+        testFuncWithVariableLength(10);
+        const auto longCallInstructions = shortFuncData->getLastFunctionCall().getPerfCounter(qiti::PerfCounter::instructions);
+        
+        QITI_CHECK(shortCallInstructions > 1000);
+        QITI_CHECK(longCallInstructions > 5 * shortCallInstructions);
+    }
+}
+
+QITI_TEST_CASE("qiti::FunctionData::getTotalResourceUsage()", FunctionDataGetTotalResourceUsage)
+{
+    qiti::ScopedQitiTest test;
+    
+    auto funcData = qiti::FunctionData::getFunctionData<&testFuncTouchMemory>();
+    QITI_REQUIRE(funcData != nullptr);
+    
+    static constexpr size_t numBytes = 1024 * 1024;
+    
+    QITI_SECTION("Disabled by default")
+    {
+        testFuncTouchMemory(numBytes);
+        
+        QITI_CHECK(funcData->getTotalResourceUsage(qiti::ResourceUsage::minorPageFaults) == 0);
+        QITI_CHECK(funcData->getLastFunctionCall().getResourceUsage(qiti::ResourceUsage::minorPageFaults) == 0);
+    }
+    
+#ifdef __linux__
+    QITI_SECTION("Counts the page faults of every call")
+    {
+        test.enableResourceUsage(true);
+        
+        testFuncTouchMemory(numBytes);
+        const auto firstCallPageFaults = funcData->getLastFunctionCall().getResourceUsage(qiti::ResourceUsage::minorPageFaults);
+        QITI_CHECK(firstCallPageFaults > 0);
+        
+        testFuncTouchMemory(numBytes);
+        const auto secondCallPageFaults = funcData->getLastFunctionCall().getResourceUsage(qiti::ResourceUsage::minorPageFaults);
+        QITI_CHECK(funcData->getTotalResourceUsage(qiti::ResourceUsage::minorPageFaults) == firstCallPageFaults + secondCallPageFaults);
+        QITI_CHECK(funcData->getAverageResourceUsage(qiti::ResourceUsage::minorPageFaults) == (firstCallPageFaults + secondCallPageFaults) / 2);
+    }
+    
+    QITI_SECTION("Counts sleeping as a voluntary context switch")
+    {
+        test.enableResourceUsage(true);
+        
+        auto sleepFuncData = qiti::FunctionData::getFunctionData<&testFuncSleep>();
+        testFuncSleep();
+        
+        QITI_CHECK(sleepFuncData->getLastFunctionCall().getResourceUsage(qiti::ResourceUsage::voluntaryContextSwitches) >= 1);
+        QITI_CHECK(sleepFuncData->getTotalResourceUsage(qiti::ResourceUsage::voluntaryContextSwitches) >= 1);
+    }
+#endif
+}
+
 QITI_TEST_CASE("qiti::FunctionData::wasCalledOnThread()", FunctionDataWasCalledOnThread)
 {
     qiti::ScopedQitiTest test;
@@ -244,6 +635,61 @@ QITI_TEST_CASE("qiti::FunctionData::wasCalledOnThread()", FunctionDataWasCalledO
         
         QITI_CHECK(funcData->wasCalledOnThread(id));
     }
+    
+    QITI_SECTION("Function called on more threads than ever ran at once")
+    {
+        qiti::Profile::beginProfilingFunction<&testFuncWithVariableLength>();
+        
+        // Short-lived threads, like a thread pool churning through workers.
+        // Once joined, their ids are reused by the next batches.
+        constexpr int numBatches = 30;
+        constexpr int numThreadsPerBatch = 10;
+        
+        bool wasCalledOnCallingThreads = true;
+        bool wasNotCalledOnOtherThreads = true;
+        for (int batch = 0; batch < numBatches; ++batch)
+        {
+            std::atomic<int> numThreadsStarted = 0;
+            std::vector<std::thread> threads;
+            std::vector<std::thread::id> ids;
+            for (int i = 0; i < numThreadsPerBatch; ++i)
+            {
+                // Every other thread only calls another profiled function
+                const bool callsTestFunc = (i + batch) % 2 == 0;
+                threads.emplace_back([callsTestFunc, &numThreadsStarted]
+                {
+                    // All threads of the batch run at once
+                    ++numThreadsStarted;
+                    while (numThreadsStarted.load() < numThreadsPerBatch)
+                        std::this_thread::yield();
+                    
+                    if (callsTestFunc)
+                        testFunc();
+                    else
+                        testFuncWithVariableLength(1);
+                });
+                ids.push_back(threads.back().get_id());
+            }
+            for (auto& thread : threads)
+                thread.join();
+            
+            // Ids reused from earlier batches only report the calls of the thread that has them now
+            for (int i = 0; i < numThreadsPerBatch; ++i)
+            {
+                const auto& id = ids[static_cast<size_t>(i)];
+                if ((i + batch) % 2 == 0)
+                    wasCalledOnCallingThreads = wasCalledOnCallingThreads && funcData->wasCalledOnThread(id);
+                else
+                    wasNotCalledOnOtherThreads = wasNotCalledOnOtherThreads
+                                                 && ! funcData->wasCalledOnThread(id)
+                                                 && funcData->getLastFunctionCall(id).getTimeSpentInFunctionWallClock_ns() == 0;
+            }
+        }
+        
+        QITI_CHECK(wasCalledOnCallingThreads);
+        QITI_CHECK(wasNotCalledOnOtherThreads);
+        QITI_CHECK(funcData->getNumTimesCalled() == numBatches * numThreadsPerBatch / 2);
+    }
 }
 
 QITI_TEST_CASE("qiti::FunctionData::getAllProfiledFunctionData()", FunctionDataGetAllProfiledFunctionData)
@@ -535,6 +981,73 @@ QITI_TEST_CASE("qiti::FunctionData::getCallers()", FunctionDataGetCallers)
     }
 }
 
+QITI_TEST_CASE("qiti::FunctionData::getCallerStats() and getCallees()", FunctionDataGetCallerStats)
+{
+    qiti::ScopedQitiTest test;
+    
+    qiti::Profile::beginProfilingAllFunctions();
+    
+    auto funcDataA = qiti::FunctionData::getFunctionData<&callerTestFuncA>();
+    auto funcDataB = qiti::FunctionData::getFunctionData<&callerTestFuncB>();
+    auto funcDataC = qiti::FunctionData::getFunctionData<&callerTestFuncC>();
+    
+    QITI_REQUIRE(funcDataA != nullptr);
+    QITI_REQUIRE(funcDataB != nullptr);
+    QITI_REQUIRE(funcDataC != nullptr);
+    
+    QITI_SECTION("No edges initially")
+    {
+        QITI_CHECK(funcDataA->getCallerStats().empty());
+        QITI_CHECK(funcDataC->getCallees().empty());
+    }
+    
+    QITI_SECTION("Edges are weighted by number of calls")
+    {
+        for (int i = 0; i < 3; ++i)
+            callerTestFuncC(); // C calls A, then C calls B (which also calls A)
+        callerTestFuncB();     // B calls A
+        
+        const auto callerStatsA = funcDataA->getCallerStats();
+        QITI_REQUIRE(callerStatsA.size() == 2);
+        for (const auto& edge : callerStatsA)
+        {
+            QITI_CHECK(edge.callee == funcDataA);
+            QITI_CHECK(edge.totalTimeWallClock_ns > 0);
+            if (edge.caller == funcDataB)
+                QITI_CHECK(edge.numCalls == 4);
+            else
+                QITI_CHECK((edge.caller == funcDataC && edge.numCalls == 3));
+        }
+        
+        const auto calleesC = funcDataC->getCallees();
+        QITI_REQUIRE(calleesC.size() == 2);
+        for (const auto& edge : calleesC)
+        {
+            QITI_CHECK(edge.caller == funcDataC);
+            QITI_CHECK((edge.callee == funcDataA || edge.callee == funcDataB));
+            QITI_CHECK(edge.numCalls == 3);
+        }
+        
+        // Sorted by time: B (which calls A) takes longer than A
+        QITI_CHECK(calleesC[0].totalTimeWallClock_ns >= calleesC[1].totalTimeWallClock_ns);
+        
+        QITI_CHECK(funcDataA->getCallees().empty());
+        QITI_CHECK(funcDataC->getCallerStats().empty());
+    }
+    
+    QITI_SECTION("Edges of every thread are merged")
+    {
+        std::thread thread([] { callerTestFuncB(); });
+        thread.join();
+        callerTestFuncB();
+        
+        const auto callerStatsA = funcDataA->getCallerStats();
+        QITI_REQUIRE(callerStatsA.size() == 1);
+        QITI_CHECK(callerStatsA[0].caller == funcDataB);
+        QITI_CHECK(callerStatsA[0].numCalls == 2);
+    }
+}
+
 #ifndef _WIN32 // TODO: Windows exception tracking and function type detection needs investigation
 QITI_TEST_CASE("Exception tracking", FunctionDataExceptionTracking)
 {
@@ -867,6 +1380,69 @@ QITI_TEST_CASE("qiti::FunctionData::getAverageTimeSpentInFunctionWallClock_ns()"
     }
 }
 
+QITI_TEST_CASE("qiti::FunctionData::getWallClockStatistics()", FunctionDataGetWallClockStatistics)
+{
+    qiti::ScopedQitiTest test;
+
+    auto funcData = qiti::FunctionData::getFunctionData<&testFuncWithVariableLength>();
+    QITI_REQUIRE(funcData != nullptr);
+
+    QITI_SECTION("No calls made - all statistics are 0")
+    {
+        const auto stats = funcData->getWallClockStatistics();
+        QITI_CHECK(stats.mean_ns == 0.0);
+        QITI_CHECK(stats.variance_ns2 == 0.0);
+        QITI_CHECK(stats.coefficientOfVariation == 0.0);
+    }
+
+    QITI_SECTION("Single call - no spread")
+    {
+        testFuncWithVariableLength(2);
+
+        const auto stats = funcData->getWallClockStatistics();
+        QITI_CHECK(stats.mean_ns > 0.0);
+        QITI_CHECK(stats.variance_ns2 == 0.0);
+        QITI_CHECK(stats.standardDeviation_ns == 0.0);
+    }
+
+    QITI_SECTION("Multiple calls - mean within min/max, spread reflects varying lengths")
+    {
+        for (int i = 0; i < 50; ++i)
+            testFuncWithVariableLength((i % 2 == 0) ? 1 : 20);
+
+        const auto stats = funcData->getWallClockStatistics();
+        const auto minTime = static_cast<double>(funcData->getMinTimeSpentInFunctionWallClock_ns());
+        const auto maxTime = static_cast<double>(funcData->getMaxTimeSpentInFunctionWallClock_ns());
+
+        QITI_CHECK(stats.mean_ns >= minTime * 0.99);
+        QITI_CHECK(stats.mean_ns <= maxTime * 1.01);
+        QITI_CHECK(stats.standardDeviation_ns > 0.0);
+        QITI_CHECK(stats.standardDeviation_ns <= maxTime - minTime);
+        QITI_CHECK(stats.coefficientOfVariation > 0.1);
+    }
+
+    QITI_SECTION("Merges the calls of every thread")
+    {
+        std::thread thread([]
+        {
+            for (int i = 0; i < 20; ++i)
+                testFuncWithVariableLength(1);
+        });
+        thread.join();
+        for (int i = 0; i < 20; ++i)
+            testFuncWithVariableLength(1);
+
+        const auto stats = funcData->getWallClockStatistics();
+        const auto average = static_cast<double>(funcData->getAverageTimeSpentInFunctionWallClock_ns());
+        QITI_CHECK(stats.mean_ns >= average * 0.99);
+        QITI_CHECK(stats.mean_ns <= average * 1.01 + 1.0);
+
+        const auto cpuStats = funcData->getCpuStatistics();
+        QITI_CHECK(cpuStats.mean_ns > 0.0);
+        QITI_CHECK(cpuStats.standardDeviation_ns >= 0.0);
+    }
+}
+
 QITI_TEST_CASE("qiti::FunctionData::wasCalledOnThread() with unregistered thread ID", FunctionDataWasCalledOnThreadNotFound)
 {
     qiti::ScopedQitiTest test;
@@ -892,7 +1468,6 @@ QITI_TEST_CASE("qiti::FunctionData::wasCalledOnThread() with unregistered thread
     }
 
     // Query whether testFunc was called on the unregistered thread.
-    // This exercises the THREAD_ID_NOT_FOUND return path (line 55 in qiti_FunctionData.cpp)
-    // where threadIdToIndex() returns THREAD_ID_NOT_FOUND because the thread was never seen.
+    // No shard of testFunc belongs to that thread, so it must not be found.
     QITI_CHECK(! funcData->wasCalledOnThread(unregisteredThreadId));
 }
@@ -0,0 +1,118 @@
+
+// Qiti Public API
+#include "qiti_include.hpp"
+// Special unit test include
+#include "qiti_test_macros.hpp"
+
+// Qiti Private API - not included in qiti_include.hpp
+#include "qiti_FunctionFilter.hpp"
+#include "qiti_FunctionRegistry.hpp"
+
+#include "qiti_example_include.hpp"
+
+//--------------------------------------------------------------------------
+
+/** True if the function was profiled (had FunctionData created) since the start of the test. */
+static bool wasProfiled(const void* functionAddress) noexcept
+{
+    auto* entry = qiti::FunctionRegistry::find(functionAddress);
+    return entry != nullptr && entry->functionData.load() != nullptr;
+}
+
+//--------------------------------------------------------------------------
+
+QITI_TEST_CASE("qiti::FunctionFilter::GlobPattern::matches()", FunctionFilterGlobPatternMatches)
+{
+    using GlobPattern = qiti::FunctionFilter::GlobPattern;
+
+    QITI_SECTION("Literal")
+    {
+        QITI_CHECK(GlobPattern("foo").matches("foo"));
+        QITI_CHECK(! GlobPattern("foo").matches("foobar"));
+        QITI_CHECK(! GlobPattern("foo").matches("barfoo"));
+        QITI_CHECK(GlobPattern("").matches(""));
+        QITI_CHECK(! GlobPattern("").matches("foo"));
+    }
+
+    QITI_SECTION("Wildcards")
+    {
+        QITI_CHECK(GlobPattern("*").matches(""));
+        QITI_CHECK(GlobPattern("*").matches("anything"));
+        QITI_CHECK(GlobPattern("std::*").matches("std::vector<int>::push_back(int const&)"));
+        QITI_CHECK(! GlobPattern("std::*").matches("mystd::foo()"));
+        QITI_CHECK(GlobPattern("*parse*").matches("json::parseValue()"));
+        QITI_CHECK(GlobPattern("*()").matches("foo()"));
+        QITI_CHECK(! GlobPattern("*()").matches("foo(int)"));
+        QITI_CHECK(GlobPattern("a*b*c").matches("abc"));
+        QITI_CHECK(GlobPattern("a*b*c").matches("a_b_b_c"));
+        QITI_CHECK(! GlobPattern("a*b*c").matches("a_c_b"));
+        QITI_CHECK(! GlobPattern("ab*ba").matches("aba")); // prefix and suffix must not overlap
+    }
+}
+
+QITI_TEST_CASE("qiti::ScopedQitiTest::excludeFunctions()", FunctionFilterExcludeFunctions)
+{
+    qiti::ScopedQitiTest test;
+    test.enableProfilingOnAllFunctions(true);
+    test.excludeFunctions("qiti::example::utils::*");
+
+    qiti::example::utils::testFunc0();
+    qiti::example::profile::testFunc();
+
+    test.enableProfilingOnAllFunctions(false);
+
+    QITI_CHECK(! wasProfiled(reinterpret_cast<const void*>(&qiti::example::utils::testFunc0)));
+    QITI_CHECK(wasProfiled(reinterpret_cast<const void*>(&qiti::example::profile::testFunc)));
+}
+
+QITI_TEST_CASE("qiti::ScopedQitiTest::includeFunctions()", FunctionFilterIncludeFunctions)
+{
+    qiti::ScopedQitiTest test;
+    test.enableProfilingOnAllFunctions(true);
+    test.includeFunctions("qiti::example::utils::*");
+
+    qiti::example::utils::testFunc0();
+    qiti::example::profile::testFunc();
+
+    test.enableProfilingOnAllFunctions(false);
+
+    QITI_CHECK(wasProfiled(reinterpret_cast<const void*>(&qiti::example::utils::testFunc0)));
+    QITI_CHECK(! wasProfiled(reinterpret_cast<const void*>(&qiti::example::profile::testFunc)));
+}
+
+QITI_TEST_CASE("qiti::ScopedQitiTest::excludeModules()", FunctionFilterExcludeModules)
+{
+    qiti::ScopedQitiTest test;
+    test.enableProfilingOnAllFunctions(true);
+    test.excludeModules("*"); // every module
+
+    qiti::example::utils::testFunc0();
+
+    test.enableProfilingOnAllFunctions(false);
+
+    QITI_CHECK(! wasProfiled(reinterpret_cast<const void*>(&qiti::example::utils::testFunc0)));
+
+    QITI_SECTION("Explicitly profiled functions ignore rules")
+    {
+        auto* funcData = qiti::FunctionData::getFunctionData<&qiti::example::utils::testFunc0>();
+        qiti::example::utils::testFunc0();
+        QITI_CHECK(funcData->getNumTimesCalled() == 1);
+    }
+}
+
+QITI_TEST_CASE("qiti::ScopedQitiTest rules are cleared", FunctionFilterRulesCleared)
+{
+    {
+        qiti::ScopedQitiTest test;
+        test.excludeFunctions("*");
+    }
+
+    qiti::ScopedQitiTest test;
+    test.enableProfilingOnAllFunctions(true);
+
+    qiti::example::utils::testFunc0();
+
+    test.enableProfilingOnAllFunctions(false);
+
+    QITI_CHECK(wasProfiled(reinterpret_cast<const void*>(&qiti::example::utils::testFunc0)));
+}
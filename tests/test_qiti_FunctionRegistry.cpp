@@ -0,0 +1,110 @@
+
+// Qiti Public API
+#include "qiti_include.hpp"
+// Special unit test include
+#include "qiti_test_macros.hpp"
+
+// Qiti Private API - not included in qiti_include.hpp
+#include "qiti_FunctionRegistry.hpp"
+
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+//--------------------------------------------------------------------------
+
+/** Fake function addresses, never called, only used as keys. */
+static const void* fakeAddress(uintptr_t i) noexcept
+{
+    return reinterpret_cast<const void*>(0x1000 + i * 16);
+}
+
+//--------------------------------------------------------------------------
+
+QITI_TEST_CASE("qiti::FunctionRegistry::find()", FunctionRegistryFind)
+{
+    qiti::ScopedQitiTest test;
+
+    QITI_SECTION("Unregistered address")
+    {
+        QITI_CHECK(qiti::FunctionRegistry::find(fakeAddress(0)) == nullptr);
+    }
+
+    QITI_SECTION("Registered address")
+    {
+        auto& entry = qiti::FunctionRegistry::findOrInsert(fakeAddress(0));
+        QITI_CHECK(qiti::FunctionRegistry::find(fakeAddress(0)) == &entry);
+        QITI_CHECK(entry.address == fakeAddress(0));
+        QITI_CHECK(! entry.isProfiled.load());
+        QITI_CHECK(entry.functionData.load() == nullptr);
+
+        // Inserting again returns the same entry
+        QITI_CHECK(&qiti::FunctionRegistry::findOrInsert(fakeAddress(0)) == &entry);
+    }
+}
+
+QITI_TEST_CASE("qiti::FunctionRegistry growth", FunctionRegistryGrowth)
+{
+    qiti::ScopedQitiTest test;
+
+    static constexpr uintptr_t numFunctions = 10'000; // well past the initial capacity
+
+    std::vector<qiti::FunctionRegistry::Entry*> entries;
+    for (uintptr_t i = 0; i < numFunctions; ++i)
+        entries.push_back(&qiti::FunctionRegistry::findOrInsert(fakeAddress(i)));
+
+    QITI_CHECK(qiti::FunctionRegistry::size() >= numFunctions);
+
+    bool allFound = true;
+    for (uintptr_t i = 0; i < numFunctions; ++i)
+        allFound = allFound && (qiti::FunctionRegistry::find(fakeAddress(i)) == entries[i]);
+    QITI_CHECK(allFound);
+
+    // Indices are dense and in registration order
+    QITI_CHECK(entries.back()->index == entries.front()->index + numFunctions - 1);
+}
+
+QITI_TEST_CASE("qiti::FunctionRegistry concurrent insertion", FunctionRegistryConcurrentInsertion)
+{
+    qiti::ScopedQitiTest test;
+
+    static constexpr uintptr_t numThreads = 4;
+    static constexpr uintptr_t numFunctionsPerThread = 2'000;
+
+    // Every thread inserts an overlapping range while the others look it up
+    std::vector<std::thread> threads;
+    for (uintptr_t t = 0; t < numThreads; ++t)
+    {
+        threads.emplace_back([t]
+        {
+            for (uintptr_t i = 0; i < numFunctionsPerThread; ++i)
+            {
+                (void)qiti::FunctionRegistry::findOrInsert(fakeAddress(t * numFunctionsPerThread / 2 + i));
+                (void)qiti::FunctionRegistry::find(fakeAddress(i));
+            }
+        });
+    }
+    for (auto& thread : threads)
+        thread.join();
+
+    const uintptr_t numDistinctAddresses = (numThreads + 1) * numFunctionsPerThread / 2;
+
+    bool allFound = true;
+    for (uintptr_t i = 0; i < numDistinctAddresses; ++i)
+        allFound = allFound && (qiti::FunctionRegistry::find(fakeAddress(i)) != nullptr);
+    QITI_CHECK(allFound);
+}
+
+QITI_TEST_CASE("qiti::FunctionRegistry::clear()", FunctionRegistryClear)
+{
+    qiti::ScopedQitiTest test;
+
+    (void)qiti::FunctionRegistry::findOrInsert(fakeAddress(0));
+    const auto generation = qiti::FunctionRegistry::getGeneration();
+
+    qiti::FunctionRegistry::clear();
+
+    QITI_CHECK(qiti::FunctionRegistry::find(fakeAddress(0)) == nullptr);
+    QITI_CHECK(qiti::FunctionRegistry::size() == 0);
+    QITI_CHECK(qiti::FunctionRegistry::getGeneration() != generation);
+}
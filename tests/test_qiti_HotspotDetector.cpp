@@ -56,6 +56,15 @@ void hotspotTestFuncVerySlow() noexcept
     }
 }
 
+/** Test function that only delegates its work (high total time, low self time) */
+__attribute__((noinline))
+__attribute__((optnone))
+void hotspotTestFuncDriver() noexcept
+{
+    hotspotTestFuncVerySlow();
+    hotspotTestFuncMedium();
+}
+
 /** Test function that throws exceptions */
 __attribute__((noinline))
 __attribute__((optnone))
@@ -275,6 +284,47 @@ QITI_TEST_CASE("qiti::HotspotDetector hotspot scoring", HotspotDetectorScoring)
     QITI_CHECK(fastHotspot->reason.find("10 calls") != std::string::npos);
 }
 
+QITI_TEST_CASE("qiti::HotspotDetector ranking by self time", HotspotDetectorRankingBySelfTime)
+{
+    qiti::ScopedQitiTest test;
+    test.enableProfilingOnAllFunctions(true);
+    
+    hotspotTestFuncDriver();
+    
+    const auto findScore = [](const std::vector<qiti::HotspotDetector::Hotspot>& hotspots, const char* functionName)
+    {
+        for (const auto& hotspot : hotspots)
+        {
+            if (strstr(hotspot.function->getFunctionName(), functionName) != nullptr)
+                return hotspot.score;
+        }
+        return -1.0;
+    };
+    
+    QITI_SECTION("Total time ranks the driver above the functions it calls")
+    {
+        auto hotspots = qiti::HotspotDetector::detectHotspots(0.0, qiti::HotspotDetector::Ranking::totalTime);
+        
+        const auto driverScore = findScore(hotspots, "hotspotTestFuncDriver");
+        const auto leafScore   = findScore(hotspots, "hotspotTestFuncVerySlow");
+        QITI_REQUIRE(driverScore >= 0.0);
+        QITI_REQUIRE(leafScore >= 0.0);
+        QITI_CHECK(driverScore >= leafScore);
+    }
+    
+    QITI_SECTION("Self time ranks the leaf doing the work above the driver")
+    {
+        auto hotspots = qiti::HotspotDetector::detectHotspots(0.0, qiti::HotspotDetector::Ranking::selfTime);
+        
+        const auto driverScore = findScore(hotspots, "hotspotTestFuncDriver");
+        const auto leafScore   = findScore(hotspots, "hotspotTestFuncVerySlow");
+        QITI_REQUIRE(driverScore >= 0.0);
+        QITI_REQUIRE(leafScore >= 0.0);
+        QITI_CHECK(leafScore > driverScore);
+        QITI_CHECK(leafScore > findScore(hotspots, "hotspotTestFuncMedium"));
+    }
+}
+
 QITI_TEST_CASE("qiti::HotspotDetector exception tracking in hotspots", HotspotDetectorExceptionTracking)
 {
     qiti::ScopedQitiTest test;
@@ -121,6 +121,30 @@ QITI_TEST_CASE("qiti::Instrument::resetInstrumentation() clears function call ho
     QITI_CHECK(callbackCount == 0);
 }
 
+QITI_TEST_CASE("qiti::Instrument::onNextFunctionCall() callbacks only run on their own thread",
+               OnNextFunctionCallPerThread)
+{
+    qiti::ScopedQitiTest test;
+
+    int otherThreadCallbackCount = 0;
+    int callbackCount = 0;
+
+    // Left pending when the thread exits
+    std::thread thread([&otherThreadCallbackCount]
+    {
+        qiti::Instrument::onNextFunctionCall<&testTargetFunction>([&otherThreadCallbackCount]() { ++otherThreadCallbackCount; });
+    });
+    thread.join();
+
+    testTargetFunction();
+    QITI_CHECK(otherThreadCallbackCount == 0);
+
+    qiti::Instrument::onNextFunctionCall<&testTargetFunction>([&callbackCount]() { ++callbackCount; });
+    testTargetFunction();
+    QITI_CHECK(callbackCount == 1);
+    QITI_CHECK(otherThreadCallbackCount == 0);
+}
+
 //--------------------------------------------------------------------------
 // Thread creation instrumentation tests
 //--------------------------------------------------------------------------
@@ -8,6 +8,10 @@
 
 #include "qiti_LeakSanitizer.hpp"
 
+// Qiti Private API - not included in qiti_include.hpp
+#include "qiti_MallocHooks.hpp"
+
+#include <thread>
 #include <utility> // std::move
 
 // Disable optimizations to prevent compiler from eliminating intentional memory leaks in tests
@@ -343,4 +347,145 @@ QITI_TEST_CASE("qiti::LeakSanitizer::rerun", LeakSanitizerRerun)
     QITI_REQUIRE(failRunCount == 2);
 }
 
+QITI_TEST_CASE("qiti::LeakSanitizer::crossThreadFree", LeakSanitizerCrossThreadFree)
+{
+    qiti::ScopedQitiTest test;
+    
+    QITI_SECTION("Freed by another thread")
+    {
+        qiti::LeakSanitizer lsan;
+        lsan.run([]()
+        {
+            int* ptr = new int(42);
+            std::thread consumer([ptr]() { delete ptr; });
+            consumer.join();
+        });
+        QITI_REQUIRE(lsan.passed());
+    }
+    
+    QITI_SECTION("Leaked, not freed by another thread")
+    {
+        qiti::LeakSanitizer lsan;
+        lsan.run([]()
+        {
+            int* ptr = new int(42);
+            std::thread consumer([ptr]() { (void)ptr; }); // Intentional leak
+            consumer.join();
+        });
+        QITI_REQUIRE(lsan.failed());
+    }
+    
+    QITI_SECTION("Allocation made before running is freed by another thread")
+    {
+        int* ptr = new int(42);
+        
+        qiti::LeakSanitizer lsan;
+        lsan.run([ptr]()
+        {
+            std::thread consumer([ptr]() { delete ptr; });
+            consumer.join();
+        });
+        QITI_REQUIRE(lsan.passed());
+        
+        // Less is allocated than before, not ~2^64 bytes more
+        std::string report = lsan.getReport();
+        QITI_REQUIRE(report.find("Net leak: -") != std::string::npos);
+        QITI_REQUIRE(report.find("Status: PASSED") != std::string::npos);
+    }
+}
+
+QITI_TEST_CASE("qiti::LeakSanitizer::allThreads", LeakSanitizerAllThreads)
+{
+    qiti::ScopedQitiTest test;
+    
+    QITI_SECTION("Worker thread frees what it allocates")
+    {
+        qiti::LeakSanitizer lsan(qiti::LeakSanitizer::Scope::allThreads);
+        lsan.run([]()
+        {
+            std::thread worker([]()
+            {
+                int* ptr = new int[16];
+                delete[] ptr;
+            });
+            worker.join();
+        });
+        QITI_REQUIRE(lsan.passed());
+    }
+    
+    QITI_SECTION("Worker thread leaks")
+    {
+        qiti::LeakSanitizer lsan(qiti::LeakSanitizer::Scope::allThreads);
+        lsan.run([]()
+        {
+            std::thread worker([]()
+            {
+                int* ptr = new int[16]; // Intentional leak
+                (void)ptr;
+            });
+            worker.join();
+        });
+        QITI_REQUIRE(lsan.failed());
+        
+        // Only the calling thread's allocations are checked by default
+        qiti::LeakSanitizer lsanCurrentThread;
+        lsanCurrentThread.run([]()
+        {
+            std::thread worker([]()
+            {
+                int* ptr = new int[16]; // Intentional leak
+                (void)ptr;
+            });
+            worker.join();
+        });
+        QITI_REQUIRE(lsanCurrentThread.passed());
+    }
+}
+
+QITI_TEST_CASE("qiti::LeakSanitizer::freedBetweenTests", LeakSanitizerFreedBetweenTests)
+{
+    constexpr size_t numBytes = 1 << 20;
+    
+    char* ptr = nullptr;
+    uint64_t currentAmountWithAllocation = 0;
+    {
+        qiti::ScopedQitiTest test;
+        ptr = new char[numBytes];
+        currentAmountWithAllocation = qiti::MallocHooks::getCurrentAmountHeapAllocatedInProcess();
+    }
+    
+    // Freed while no test runs, it must not stay live
+    delete[] ptr;
+    
+    qiti::ScopedQitiTest test;
+    QITI_CHECK(qiti::MallocHooks::getCurrentAmountHeapAllocatedInProcess() + numBytes <= currentAmountWithAllocation);
+}
+
+QITI_TEST_CASE("qiti::LeakSanitizer::threadChurn", LeakSanitizerThreadChurn)
+{
+    qiti::ScopedQitiTest test;
+    
+    constexpr int numThreads = 300;
+    constexpr size_t numBytesPerThread = 16 * sizeof(int);
+    
+    const auto totalAmountBefore = qiti::MallocHooks::getTotalAmountHeapAllocatedInProcess();
+    
+    // The counters of exited threads are reused, their amounts must not get lost
+    qiti::LeakSanitizer lsan(qiti::LeakSanitizer::Scope::allThreads);
+    lsan.run([]()
+    {
+        for (int i = 0; i < numThreads; ++i)
+        {
+            std::thread worker([]()
+            {
+                int* ptr = new int[16];
+                delete[] ptr;
+            });
+            worker.join();
+        }
+    });
+    QITI_CHECK(lsan.passed());
+    QITI_CHECK(qiti::MallocHooks::getTotalAmountHeapAllocatedInProcess() >= totalAmountBefore + numThreads * numBytesPerThread);
+}
+
 #pragma clang optimize on
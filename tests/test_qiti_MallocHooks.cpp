@@ -0,0 +1,51 @@
+// Qiti Public API
+#include "qiti_include.hpp"
+// Special unit test include
+#include "qiti_test_macros.hpp"
+
+// Qiti Private API - not included in qiti_include.hpp
+#include "qiti_MallocHooks.hpp"
+
+// This file is built with -fomit-frame-pointer (see CMakeLists.txt), like optimized user code
+
+//--------------------------------------------------------------------------
+
+__attribute__((noinline))
+int* qitiTestAllocateInts()
+{
+    return new int[16];
+}
+
+/** Not the function calling new, so only a full unwind finds it on the stack. Not static, so dladdr() can name it. */
+__attribute__((noinline))
+int* qitiTestIgnoredAllocator()
+{
+    auto* ints = qitiTestAllocateInts();
+    asm volatile("" ::: "memory"); // not a tail call
+    return ints;
+}
+
+//--------------------------------------------------------------------------
+
+QITI_TEST_CASE("qiti::ScopedQitiTest::ignoreHeapAllocationsIn() without frame pointers", MallocHooksIgnoreHeapAllocationsWithoutFramePointers)
+{
+    qiti::ScopedQitiTest test;
+    
+    QITI_SECTION("Counted by default")
+    {
+        const auto numHeapAllocationsBefore = qiti::MallocHooks::getNumHeapAllocationsOnCurrentThread();
+        auto* ints = qitiTestIgnoredAllocator();
+        QITI_CHECK(qiti::MallocHooks::getNumHeapAllocationsOnCurrentThread() == numHeapAllocationsBefore + 1);
+        delete[] ints;
+    }
+    
+    QITI_SECTION("Ignored when an ignored function is anywhere on the stack")
+    {
+        test.ignoreHeapAllocationsIn("qitiTestIgnoredAllocator*");
+        
+        const auto numHeapAllocationsBefore = qiti::MallocHooks::getNumHeapAllocationsOnCurrentThread();
+        auto* ints = qitiTestIgnoredAllocator();
+        QITI_CHECK(qiti::MallocHooks::getNumHeapAllocationsOnCurrentThread() == numHeapAllocationsBefore);
+        delete[] ints;
+    }
+}
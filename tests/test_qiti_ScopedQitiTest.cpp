@@ -6,10 +6,53 @@
 // Special unit test include
 #include "qiti_test_macros.hpp"
 
+#include "qiti_CallingContextTree.hpp"
+#include "qiti_Export.hpp"
+#include "qiti_HotspotDetector.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <limits>
+#include <sstream>
 #include <string>
 
 //--------------------------------------------------------------------------
 
+__attribute__((noinline))
+__attribute__((optnone))
+void overheadTestEmptyFunc() noexcept
+{
+}
+
+__attribute__((noinline))
+__attribute__((optnone))
+void overheadTestCallsEmptyFunc() noexcept
+{
+    for (int i = 0; i < 1000; ++i)
+        overheadTestEmptyFunc();
+}
+
+__attribute__((noinline))
+__attribute__((optnone))
+void heapTestAllocatesInt() noexcept
+{
+    int* value = new int(1);
+    delete value;
+}
+
+/** 2 heap allocations: 1 of its own, 1 in heapTestAllocatesInt() */
+__attribute__((noinline))
+__attribute__((optnone))
+void heapTestCallsAllocatesInt() noexcept
+{
+    int* value = new int(2);
+    delete value;
+    heapTestAllocatesInt();
+}
+
+//--------------------------------------------------------------------------
+
 QITI_TEST_CASE("qiti::ScopedQitiTest::getQitiVersionString()", ScopedQitiTestGetQitiVersionString)
 {
     qiti::ScopedQitiTest test;
@@ -60,6 +103,275 @@ QITI_TEST_CASE("qiti::ScopedQitiTest::reset(true)", ScopedQitiTestResetWithStart
     QITI_CHECK(elapsed_ns >= 0);
 }
 
+QITI_TEST_CASE("qiti::ScopedQitiTest::setWallClockSource()", ScopedQitiTestSetWallClockSource)
+{
+    using WallClockSource = qiti::ScopedQitiTest::WallClockSource;
+    
+    auto checkMeasuredTime = []
+    {
+        auto funcData = qiti::FunctionData::getFunctionData<&qiti::example::FunctionCallData::slowWork>();
+        
+        const auto begin = std::chrono::steady_clock::now();
+        qiti::example::FunctionCallData::slowWork();
+        const auto end = std::chrono::steady_clock::now();
+        const auto outer_ns = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count());
+        
+        const auto lastCall = funcData->getLastFunctionCall();
+        const auto wall_ns = lastCall.getTimeSpentInFunctionWallClock_ns();
+        QITI_CHECK(wall_ns > 0);
+        QITI_CHECK(wall_ns <= outer_ns + outer_ns / 10); // 10% tolerance for TSC calibration error
+        QITI_CHECK(funcData->getMaxTimeSpentInFunctionWallClock_ns() == wall_ns);
+    };
+    
+    QITI_SECTION("steady_clock is always available")
+    {
+        qiti::ScopedQitiTest test;
+        QITI_CHECK(test.setWallClockSource(WallClockSource::steadyClock));
+        QITI_CHECK(test.getWallClockSource() == WallClockSource::steadyClock);
+        checkMeasuredTime();
+    }
+    
+    QITI_SECTION("TSC, or falls back to steady_clock")
+    {
+        qiti::ScopedQitiTest test;
+        if (test.setWallClockSource(WallClockSource::tsc))
+            QITI_CHECK(test.getWallClockSource() == WallClockSource::tsc);
+        else
+            QITI_CHECK(test.getWallClockSource() == WallClockSource::steadyClock);
+        checkMeasuredTime();
+    }
+}
+
+QITI_TEST_CASE("qiti::ScopedQitiTest::setCpuTimeSource()", ScopedQitiTestSetCpuTimeSource)
+{
+    using CpuTimeSource = qiti::ScopedQitiTest::CpuTimeSource;
+    
+    auto checkMeasuredTime = []
+    {
+        auto funcData = qiti::FunctionData::getFunctionData<&qiti::example::FunctionCallData::slowWork>();
+        qiti::example::FunctionCallData::slowWork();
+        
+        const auto lastCall = funcData->getLastFunctionCall();
+#ifndef _WIN32 // CPU Time feature not supported on Windows
+        QITI_CHECK(lastCall.getTimeSpentInFunctionCpu_ns() > 0);
+#endif
+        // 10% tolerance for the two clocks being read at slightly different times
+        QITI_CHECK(lastCall.getTimeSpentInFunctionCpu_ns() <= lastCall.getTimeSpentInFunctionWallClock_ns() * 11 / 10);
+    };
+    
+    QITI_SECTION("clock_gettime is the default")
+    {
+        qiti::ScopedQitiTest test;
+        QITI_CHECK(test.getCpuTimeSource() == CpuTimeSource::clockGettime);
+        checkMeasuredTime();
+    }
+    
+    QITI_SECTION("perf task-clock, or falls back to clock_gettime")
+    {
+        qiti::ScopedQitiTest test;
+        if (test.setCpuTimeSource(CpuTimeSource::perfTaskClock))
+            QITI_CHECK(test.getCpuTimeSource() == CpuTimeSource::perfTaskClock);
+        else
+            QITI_CHECK(test.getCpuTimeSource() == CpuTimeSource::clockGettime);
+        checkMeasuredTime();
+    }
+}
+
+QITI_TEST_CASE("qiti::ScopedQitiTest::setSamplingInterval()", ScopedQitiTestSetSamplingInterval)
+{
+    using qiti::example::profile::testFunc;
+    
+    qiti::ScopedQitiTest test;
+    auto* funcData = qiti::FunctionData::getFunctionData<&testFunc>();
+    
+    QITI_SECTION("Every call by default")
+    {
+        for (int i = 0; i < 10; ++i)
+            testFunc();
+        
+        QITI_CHECK(funcData->getNumTimesCalled() == 10);
+        QITI_CHECK(funcData->getNumCallsSampled() == 10);
+    }
+    
+    QITI_SECTION("Every Nth call")
+    {
+        test.setSamplingInterval(4);
+        for (int i = 0; i < 10; ++i)
+            testFunc();
+        
+        QITI_CHECK(funcData->getNumTimesCalled() == 10); // still exact
+        QITI_CHECK(funcData->getNumCallsSampled() == 3); // 1st, 5th and 9th
+        QITI_CHECK(funcData->getMaxTimeSpentInFunctionWallClock_ns() > 0);
+        QITI_CHECK(funcData->getAverageTimeSpentInFunctionWallClock_ns() > 0);
+    }
+    
+    QITI_SECTION("Per function")
+    {
+        auto* otherFuncData = qiti::FunctionData::getFunctionData<&qiti::example::utils::testFunc0>();
+        test.setSamplingInterval(2);
+        test.setSamplingInterval(funcData, 5);
+        for (int i = 0; i < 10; ++i)
+        {
+            testFunc();
+            qiti::example::utils::testFunc0();
+        }
+        
+        QITI_CHECK(funcData->getNumCallsSampled() == 2);
+        QITI_CHECK(otherFuncData->getNumCallsSampled() == 5);
+    }
+    
+    QITI_SECTION("Reset for every test")
+    {
+        test.setSamplingInterval(1000);
+        test.reset(false);
+        
+        funcData = qiti::FunctionData::getFunctionData<&testFunc>();
+        testFunc();
+        testFunc();
+        QITI_CHECK(funcData->getNumCallsSampled() == 2);
+    }
+}
+
+QITI_TEST_CASE("qiti::ScopedQitiTest::setSamplingProbability()", ScopedQitiTestSetSamplingProbability)
+{
+    using qiti::example::profile::testFunc;
+    
+    qiti::ScopedQitiTest test;
+    auto* funcData = qiti::FunctionData::getFunctionData<&testFunc>();
+    
+    QITI_SECTION("Samples roughly the given fraction of calls")
+    {
+        test.setSamplingProbability(0.25);
+        for (int i = 0; i < 4000; ++i)
+            testFunc();
+        
+        QITI_CHECK(funcData->getNumTimesCalled() == 4000);
+        QITI_CHECK(funcData->getNumCallsSampled() > 700);  // expected 1000, standard deviation ~27
+        QITI_CHECK(funcData->getNumCallsSampled() < 1300);
+    }
+    
+    QITI_SECTION("1 samples every call")
+    {
+        test.setSamplingProbability(1.0);
+        for (int i = 0; i < 10; ++i)
+            testFunc();
+        
+        QITI_CHECK(funcData->getNumCallsSampled() == 10);
+    }
+    
+    QITI_SECTION("Hotspots are scaled up to all calls")
+    {
+        test.setSamplingInterval(funcData, 10);
+        for (int i = 0; i < 100; ++i)
+            testFunc();
+        
+        const auto hotspots = qiti::HotspotDetector::detectHotspots();
+        QITI_REQUIRE(hotspots.size() == 1);
+        QITI_CHECK(hotspots[0].reason.find("[sampled 10 of 100 calls]") != std::string::npos);
+    }
+}
+
+QITI_TEST_CASE("qiti::ScopedQitiTest::enableOverheadCompensation()", ScopedQitiTestEnableOverheadCompensation)
+{
+    qiti::ScopedQitiTest test;
+    
+    QITI_SECTION("Overhead is calibrated on construction")
+    {
+        const auto overhead = test.getInstrumentationOverhead();
+        QITI_CHECK(overhead.perNestedCallWallClock_ns > 0);
+        QITI_CHECK(overhead.emptyCallWallClock_ns > 0);
+        
+        test.calibrateInstrumentationOverhead();
+        QITI_CHECK(test.getInstrumentationOverhead().perNestedCallWallClock_ns > 0);
+    }
+    
+    QITI_SECTION("Calibration runs with the active configuration without recording anything")
+    {
+        // Both setters recalibrate, with the context tree and timeline enabled
+        test.enableCallingContextTree(true);
+        test.enableTimeline(true);
+        test.setSamplingInterval(2);
+        
+        const auto overhead = test.getInstrumentationOverhead();
+        QITI_CHECK(overhead.perNestedCallWallClock_ns > 0);
+        QITI_CHECK(overhead.perUnsampledNestedCallWallClock_ns > 0);
+        
+        const auto tree = qiti::CallingContextTree::getMergedTree();
+        QITI_CHECK(tree.children.empty());
+        
+        std::ostringstream stream;
+        qiti::Export::writeChromeTrace(stream);
+        QITI_CHECK(stream.str().find("\"ph\":\"X\"") == std::string::npos);
+    }
+    
+    QITI_SECTION("Overhead of nested calls is subtracted from the caller")
+    {
+        const auto perNestedCall_ns = test.getInstrumentationOverhead().perNestedCallWallClock_ns;
+        
+        // Fastest of a few calls, so a preempted call doesn't decide the comparison
+        const auto getMinSelfTime_ns = [&test]
+        {
+            test.setCallHistoryCapacity(10);
+            auto* funcData = qiti::FunctionData::getFunctionData<&overheadTestCallsEmptyFunc>();
+            (void)qiti::FunctionData::getFunctionData<&overheadTestEmptyFunc>();
+            for (int i = 0; i < 10; ++i)
+                overheadTestCallsEmptyFunc();
+            
+            auto minSelfTime_ns = std::numeric_limits<uint64_t>::max();
+            for (const auto& call : funcData->getCallHistory())
+                minSelfTime_ns = std::min(minSelfTime_ns, call.getSelfTimeSpentInFunctionWallClock_ns());
+            return minSelfTime_ns;
+        };
+        
+        const auto compensatedSelfTime_ns = getMinSelfTime_ns();
+        
+        test.reset(false);
+        test.enableOverheadCompensation(false);
+        const auto uncompensatedSelfTime_ns = getMinSelfTime_ns();
+        
+        // The calibration keeps the fastest round, so 1000 nested calls cost at least this much
+        QITI_CHECK(uncompensatedSelfTime_ns >= 1000 * perNestedCall_ns);
+        QITI_CHECK(compensatedSelfTime_ns < uncompensatedSelfTime_ns);
+    }
+}
+
+QITI_TEST_CASE("qiti::ScopedQitiTest::ignoreHeapAllocationsIn()", ScopedQitiTestIgnoreHeapAllocationsIn)
+{
+    qiti::ScopedQitiTest test;
+    
+    auto* funcData = qiti::FunctionData::getFunctionData<&heapTestCallsAllocatesInt>();
+    
+    QITI_SECTION("Allocations are counted by default")
+    {
+        heapTestCallsAllocatesInt();
+        QITI_CHECK(funcData->getLastFunctionCall().getNumHeapAllocations() == 2);
+    }
+    
+    QITI_SECTION("Allocations of an ignored callee are not counted")
+    {
+        test.ignoreHeapAllocationsIn("heapTestAllocatesInt*");
+        heapTestCallsAllocatesInt();
+        QITI_CHECK(funcData->getLastFunctionCall().getNumHeapAllocations() == 1);
+    }
+    
+    QITI_SECTION("Allocations of everything an ignored function calls are not counted")
+    {
+        test.ignoreHeapAllocationsIn("heapTestCallsAllocatesInt*");
+        heapTestCallsAllocatesInt();
+        QITI_CHECK(funcData->getLastFunctionCall().getNumHeapAllocations() == 0);
+    }
+    
+    QITI_SECTION("Ignored functions are cleared on reset")
+    {
+        test.ignoreHeapAllocationsIn("heapTestCallsAllocatesInt*");
+        test.reset(false);
+        
+        funcData = qiti::FunctionData::getFunctionData<&heapTestCallsAllocatesInt>();
+        heapTestCallsAllocatesInt();
+        QITI_CHECK(funcData->getLastFunctionCall().getNumHeapAllocations() == 2);
+    }
+}
+
 QITI_TEST_CASE("qiti::isThreadSanitizerEnabled()", IsThreadSanitizerEnabled)
 {
     qiti::ScopedQitiTest test;
@@ -0,0 +1,73 @@
+
+// Qiti Public API
+#include "qiti_include.hpp"
+// Special unit test include
+#include "qiti_test_macros.hpp"
+
+// Qiti Private API - not included in qiti_include.hpp
+#include "qiti_FunctionRegistry.hpp"
+#include "qiti_XRayHooks.hpp"
+
+//--------------------------------------------------------------------------
+
+QITI_TEST_CASE("qiti::XRayHooks::isAvailable()", XRayHooksIsAvailable)
+{
+    qiti::ScopedQitiTest test;
+
+#if QITI_USE_XRAY
+    QITI_CHECK(qiti::XRayHooks::isAvailable());
+#else
+    QITI_CHECK(! qiti::XRayHooks::isAvailable());
+#endif
+}
+
+#if QITI_USE_XRAY
+/** Defined in the test executable: the XRay runtime only patches the sleds of the executable. */
+__attribute__((noinline))
+__attribute__((optnone))
+static void xrayTestFunc() noexcept
+{
+    volatile int x = 0;
+    x = x + 1;
+}
+
+QITI_TEST_CASE("qiti::XRayHooks patches profiled functions only", XRayHooksPatchProfileUnpatch)
+{
+    qiti::ScopedQitiTest test;
+
+    const auto* functionAddress = reinterpret_cast<const void*>(&xrayTestFunc);
+
+    // Patched in by profiling the function
+    qiti::Profile::beginProfilingFunction<&xrayTestFunc>();
+
+    auto funcData = qiti::FunctionData::getFunctionData<&xrayTestFunc>();
+    QITI_REQUIRE(funcData != nullptr);
+
+    xrayTestFunc();
+    xrayTestFunc();
+    QITI_CHECK(funcData->getNumTimesCalled() == 2);
+
+    QITI_SECTION("Unpatched calls never reach the hooks, even while profiled")
+    {
+        qiti::XRayHooks::unpatchFunction(functionAddress);
+        xrayTestFunc();
+        QITI_CHECK(funcData->getNumTimesCalled() == 2);
+
+        qiti::XRayHooks::patchFunction(functionAddress);
+        xrayTestFunc();
+        QITI_CHECK(funcData->getNumTimesCalled() == 3);
+    }
+
+    QITI_SECTION("Unpatched by no longer profiling the function")
+    {
+        qiti::Profile::endProfilingFunction<&xrayTestFunc>();
+
+        // Profiled again without patching it in, so only the unpatched sleds keep the call from being counted
+        auto* entry = qiti::FunctionRegistry::find(functionAddress);
+        QITI_REQUIRE(entry != nullptr);
+        entry->isProfiled.store(true);
+        xrayTestFunc();
+        QITI_CHECK(funcData->getNumTimesCalled() == 2);
+    }
+}
+#endif // QITI_USE_XRAY